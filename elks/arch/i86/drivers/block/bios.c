@@ -418,6 +418,17 @@ dev_t INITPROC bios_conv_bios_drive(unsigned int biosdrive)
     if (biosdrive & 0x80) {             /* hard drive*/
         minor = biosdrive & 0x03;
         partition = boot_partition;     /* saved from add_partition()*/
+#ifdef CONFIG_BLK_DEV_HD
+        if (directhd_drives) {          /* nth BIOS hard drive is nth ATA drive found*/
+            int n = minor;
+            for (minor = 0; minor < MAX_DRIVES/2; minor++) {
+                if ((directhd_drives & (1 << minor)) && n-- == 0)
+                    break;
+            }
+            if (minor >= MAX_DRIVES/2) minor = 0;
+            return MKDEV(ATHD_MAJOR, (minor << MINOR_SHIFT) + partition);
+        }
+#endif
     } else
         minor = (biosdrive & 0x03) + DRIVE_FD0;
 #endif
@@ -30,6 +30,7 @@
  * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
  *
  * Enhanced by Greg Haerr Oct 2020: add track cache, XT fixes, custom DDPT
+ * Multi-entry LRU track cache for floppy and hard disks, optionally in XMS
  */
 
 #include <linuxmt/config.h>
@@ -43,6 +44,7 @@
 #include <linuxmt/string.h>
 #include <linuxmt/mm.h>
 #include <linuxmt/memory.h>
+#include <linuxmt/ioctl.h>
 #include <linuxmt/debug.h>
 #include <linuxmt/timer.h>
 
@@ -79,7 +81,6 @@ static int hd_count = 0;                /* number of hard disks */
 
 static int access_count[NUM_DRIVES];    /* device open count */
 static struct drive_infot drive_info[NUM_DRIVES];   /* operating drive info */
-static struct drive_infot *cache_drive;
 struct drive_infot *last_drive;         /* set to last drivep-> used in read/write */
 extern struct drive_infot fd_types[];   /* BIOS floppy formats */
 
@@ -103,11 +104,52 @@ static struct gendisk bioshd_gendisk = {
     NULL                        /* next */
 };
 
+#ifdef CONFIG_TRACK_CACHE
+#define MAX_TRACK_CACHE 16              /* max cache entries */
+
+struct track_cache {
+    struct drive_infot *drive;          /* NULL if entry invalid */
+    sector_t start;                     /* first sector cached */
+    sector_t end;                       /* last sector cached */
+    ramdesc_t seg;                      /* DMASEG, main memory or XMS buffer */
+    unsigned int lru;                   /* last use stamp */
+};
+
+static struct track_cache track_cache[MAX_TRACK_CACHE];
+static int cache_entries;               /* number of entries allocated */
+static unsigned int cache_clock;        /* LRU stamp */
+static struct blk_cache_stats cache_stats;
+int nr_track_cache = -1;               /* override with /bootopts trkcache= */
+
+static void INITPROC track_cache_init(void);
+
+/* DMASEG contents changed, invalidate any entry using it */
 static void BFPROC set_cache_invalid(void)
 {
-    cache_drive = NULL;
+    struct track_cache *tc;
+
+    for (tc = track_cache; tc < &track_cache[cache_entries]; tc++) {
+        if (tc->seg == DMASEG)
+            tc->drive = NULL;
+    }
 }
 
+/* invalidate drive entries overlapping sectors start through end */
+static void BFPROC cache_invalidate(struct drive_infot *drivep, sector_t start, sector_t end)
+{
+    struct track_cache *tc;
+
+    for (tc = track_cache; tc < &track_cache[cache_entries]; tc++) {
+        if (tc->drive == drivep && start <= tc->end && end >= tc->start) {
+            tc->drive = NULL;
+            cache_stats.invalidates++;
+        }
+    }
+}
+#else
+#define set_cache_invalid()
+#endif
+
 #ifdef CONFIG_BLK_DEV_BFD
 static int BFPROC read_sector(int drive, int cylinder, int sector)
 {
@@ -341,6 +383,9 @@ static void bioshd_release(struct inode *inode, struct file *filp)
         fsync_dev(dev);
         invalidate_inodes(dev);
         invalidate_buffers(dev);
+#ifdef CONFIG_TRACK_CACHE
+        cache_invalidate(&drive_info[target], 0, (sector_t)-1);  /* media may change */
+#endif
     }
 }
 
@@ -367,6 +412,9 @@ void INITPROC bioshd_init(void)
     fd_count = bios_getfdinfo(&drive_info[DRIVE_FD0]);
 #endif
 #ifdef CONFIG_BLK_DEV_BHD
+#ifdef CONFIG_BLK_DEV_HD
+    if (!directhd_drives)       /* hard disks are owned by directhd if found */
+#endif
     hd_count = bios_gethdinfo(&drive_info[DRIVE_HD0]);
     bioshd_gendisk.nr_hd = hd_count;
 #endif
@@ -421,6 +469,9 @@ void INITPROC bioshd_init(void)
     if (!(fd_count + hd_count)) return;
 
     bios_copy_ddpt();       /* make a RAM copy of the disk drive parameter table*/
+#ifdef CONFIG_TRACK_CACHE
+    track_cache_init();
+#endif
 
     if (!register_blkdev(MAJOR_NR, DEVICE_NAME, &bioshd_fops)) {
         blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;
@@ -495,6 +546,19 @@ static int bioshd_ioctl(struct inode *inode, struct file *file, unsigned int cmd
             put_user(drivep->cylinders, &loc->cylinders);
             put_user_long(hd[MINOR(inode->i_rdev)].start_sect, &loc->start);
         }
+        break;
+#ifdef CONFIG_TRACK_CACHE
+    case IOCTL_BLK_CACHE_STATS:
+        cache_stats.entries = cache_entries;
+        cache_stats.entry_size = DMASEGSZ;
+        err = verified_memcpy_tofs((void *)arg, &cache_stats, sizeof(cache_stats));
+        break;
+    case IOCTL_BLK_CACHE_RESET:         /* clear statistics and all entries */
+        cache_invalidate(drivep, 0, (sector_t)-1);
+        memset(&cache_stats, 0, sizeof(cache_stats));
+        err = 0;
+        break;
+#endif
     }
     return err;
 }
@@ -595,22 +659,71 @@ static int BFPROC do_readwrite(struct drive_infot *drivep, sector_t start, char
 }
 
 #ifdef CONFIG_TRACK_CACHE               /* use track-sized sector cache*/
-static sector_t cache_startsector;
-static sector_t cache_endsector;
+/*
+ * Allocate cache entries in XMS if available, then DMASEG. Without XMS the
+ * default is the single DMASEG track, main memory is only taken for entries
+ * explicitly requested with trkcache=.
+ */
+static void INITPROC track_cache_init(void)
+{
+    ramdesc_t seg;
+    int i, n, dmaseg_used = 0;
+
+    n = (nr_track_cache < 0)? CONFIG_TRACK_CACHE_ENTRIES: nr_track_cache;
+    if (n > MAX_TRACK_CACHE)
+        n = MAX_TRACK_CACHE;
+    for (i = 0; i < n; i++) {
+        seg = 0;
+#ifdef CONFIG_FS_XMS_BUFFER
+        seg = xms_alloc((long_t)DMASEGSZ);
+#endif
+        if (!seg) {
+            if (!dmaseg_used++)
+                seg = DMASEG;
+            else if (nr_track_cache < 0)
+                break;
+            else {
+                segment_s *s = seg_alloc(DMASEGSZ >> 4, SEG_FLAG_EXTBUF);
+                if (!s)
+                    break;
+                seg = s->base;
+            }
+        }
+        track_cache[i].seg = seg;
+    }
+    cache_entries = i;
+    printk("bioshd: %d track cache entries (%dK)\n", i, (i * DMASEGSZ) >> 10);
+}
+
+/* find cache entry to replace, invalid or least recently used */
+static struct track_cache * BFPROC cache_victim(void)
+{
+    struct track_cache *tc, *victim = track_cache;
 
-/* read from start sector to end of track into DMASEG track buffer, no retries*/
-static void BFPROC do_readtrack(struct drive_infot *drivep, sector_t start)
+    for (tc = track_cache; tc < &track_cache[cache_entries]; tc++) {
+        if (!tc->drive)
+            return tc;
+        if ((unsigned int)(cache_clock - tc->lru) > (unsigned int)(cache_clock - victim->lru))
+            victim = tc;
+    }
+    return victim;
+}
+
+/* read from start sector to end of track into a cache entry, no retries*/
+static struct track_cache * BFPROC do_readtrack(struct drive_infot *drivep, sector_t start)
 {
     unsigned int cylinder, head, sector, num_sectors;
     int drive = drivep - drive_info;
     int error, errs = 0;
+    struct track_cache *tc;
 
     drive = bios_drive_map[drive];
-    get_chst(drivep, &start, &cylinder, &head, &sector, &num_sectors, 1);
+    get_chst(drivep, &start, &cylinder, &head, &sector, &num_sectors, drivep->fdtype != -1);
 
     if (num_sectors > (DMASEGSZ / drivep->sector_size))
         num_sectors = DMASEGSZ / drivep->sector_size;
 
+    set_cache_invalid();                /* DMASEG overwritten below */
     do {
         debug_bios("bioshd(%x): track read CHS %d/%d/%d count %d\n",
                 drive, cylinder, head, sector, num_sectors);
@@ -626,52 +739,67 @@ static void BFPROC do_readtrack(struct drive_infot *drivep, sector_t start)
     } while (error && ++errs < 1); /* no track retries, for testing only*/
     last_drive = drivep;
 
-    if (error) {
-        set_cache_invalid();
-        return;
-    }
+    if (error)
+        return NULL;
 
-    cache_drive = drivep;
-    cache_startsector = start;
-    cache_endsector = start + num_sectors - 1;
+    tc = cache_victim();
+    if (tc->seg != DMASEG)
+        xms_fmemcpyw(0, tc->seg, 0, DMASEG, num_sectors * (drivep->sector_size >> 1));
+    tc->drive = drivep;
+    tc->start = start;
+    tc->end = start + num_sectors - 1;
+    cache_stats.fills++;
     debug_bios("bioshd(%x): track read lba %ld to %ld count %d\n",
-        drive, cache_startsector, cache_endsector, num_sectors);
+        drive, tc->start, tc->end, num_sectors);
+    return tc;
 }
 
-/* check whether cache is valid for one sector*/
-static int BFPROC cache_valid(struct drive_infot *drivep, sector_t start, char *buf,
-        ramdesc_t seg)
+/* find entry holding a sector */
+static struct track_cache * BFPROC cache_lookup(struct drive_infot *drivep, sector_t start)
 {
-    unsigned int offset;
+    struct track_cache *tc;
 
-    if (drivep != cache_drive || start < cache_startsector || start > cache_endsector)
-        return 0;
-
-    offset = (int)(start - cache_startsector) * drivep->sector_size;
-    debug_bios("bioshd(%x): cache hit lba %ld\n",
-        bios_drive_map[drivep-drive_info], start);
-    xms_fmemcpyw(buf, seg, (void *)offset, DMASEG, drivep->sector_size >> 1);
-    return 1;
+    for (tc = track_cache; tc < &track_cache[cache_entries]; tc++) {
+        if (tc->drive == drivep && start >= tc->start && start <= tc->end)
+            return tc;
+    }
+    return NULL;
 }
 
-static int cache_tries;
-static int cache_hits;
+/* copy up to count sectors from cache entry, return # sectors copied*/
+static int BFPROC cache_copy(struct track_cache *tc, sector_t start, char *buf,
+        ramdesc_t seg, unsigned int count)
+{
+    struct drive_infot *drivep = tc->drive;
+    unsigned int offset;
+
+    if (count > tc->end - start + 1)
+        count = (unsigned int)(tc->end - start + 1);
+    offset = (unsigned int)(start - tc->start) * drivep->sector_size;
+    debug_bios("bioshd(%x): cache hit lba %ld count %d\n",
+        bios_drive_map[drivep-drive_info], start, count);
+    xms_fmemcpyw(buf, seg, (void *)offset, tc->seg, count * (drivep->sector_size >> 1));
+    tc->lru = ++cache_clock;
+    return count;
+}
 
 /* read from cache, return # sectors read*/
 static int BFPROC do_cache_read(struct drive_infot *drivep, sector_t start, char *buf,
-        ramdesc_t seg, int cmd)
+        ramdesc_t seg, int cmd, unsigned int count)
 {
-    if (cmd == READ) {
-        cache_tries++;
-        if (cache_valid(drivep, start, buf, seg)) { /* try cache first*/
-            cache_hits++;
-            return 1;
+    struct track_cache *tc;
+
+    if (cmd == READ && cache_entries) {
+        cache_stats.tries++;
+        if ((tc = cache_lookup(drivep, start)) != NULL) {   /* try cache first*/
+            cache_stats.hits++;
+            return cache_copy(tc, start, buf, seg, count);
         }
-        do_readtrack(drivep, start);                /* read whole track*/
-        if (cache_valid(drivep, start, buf, seg))   /* try cache again*/
-            return 1;
+        if ((tc = do_readtrack(drivep, start)) != NULL)     /* read rest of track*/
+            return cache_copy(tc, start, buf, seg, count);
+        return 0;
     }
-    set_cache_invalid();
+    cache_invalidate(drivep, start, start + count - 1);     /* write through*/
     return 0;
 }
 #endif
@@ -725,10 +853,8 @@ next_block:
         while (count > 0) {
             int num_sectors = 0;
 #ifdef CONFIG_TRACK_CACHE
-            if (drivep - drive_info >= DRIVE_FD0) {
-                /* first try reading track cache*/
-                num_sectors = do_cache_read(drivep, start, buf, req->rq_seg, req->rq_cmd);
-            }
+            /* first try reading track cache*/
+            num_sectors = do_cache_read(drivep, start, buf, req->rq_seg, req->rq_cmd, count);
             if (!num_sectors)
 #endif
                 /* then fallback with retries if required*/
@@ -744,8 +870,9 @@ next_block:
             start += num_sectors;
             buf += num_sectors * drivep->sector_size;
         }
-        debug_bios("cache: hits %u total %u %lu%%\n", cache_hits, cache_tries,
-            (long)cache_hits * 100L / cache_tries);
+#ifdef CONFIG_TRACK_CACHE
+        debug_bios("cache: hits %lu total %lu\n", cache_stats.hits, cache_stats.tries);
+#endif
 
         /* satisfied that request */
         end_request(1);
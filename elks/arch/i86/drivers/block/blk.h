@@ -80,7 +80,7 @@ static void floppy_off(int nr);
 
 #define DEVICE_NAME "hd"
 #define DEVICE_REQUEST do_directhd_request
-#define DEVICE_NR(device) (MINOR(device)>>6)
+#define DEVICE_NR(device) (MINOR(device)>>3)
 #define DEVICE_OFF(device)
 
 #elif (MAJOR_NR == BIOSHD_MAJOR)
@@ -1,9 +1,20 @@
 /*
- * NOTE: experimental direct hd driver - NOT WORKING
+ * Direct ATA/IDE hard disk driver for ELKS kernel
  *
- * directhd driver for ELKS kernel
  * Copyright (C) 1998 Blaz Antonic
  * 14.04.1998 Bugfixes by Alastair Bridgewater nyef@sudval.org
+ *
+ * Reworked for 28-bit LBA, SET MULTIPLE MODE with READ/WRITE MULTIPLE,
+ * and interrupt-driven completion when CONFIG_ASYNCIO is configured.
+ * Requests are always run in process context by the request function,
+ * which sleeps until the drive interrupts instead of polling the status
+ * register. The interrupt handler only records the status, so PIO and
+ * XMS bounce copies are never done at interrupt time. Without
+ * CONFIG_ASYNCIO, or when the channel IRQ can't be obtained, the status
+ * register is polled.
+ *
+ * When drives are found, the BIOS hard disk driver leaves the hard disks
+ * alone and a BIOS boot drive number is converted to /dev/dhdX.
  */
 
 #include <linuxmt/config.h>
@@ -11,397 +22,534 @@
 #include <linuxmt/genhd.h>
 #include <linuxmt/fs.h>
 #include <linuxmt/string.h>
+#include <linuxmt/sched.h>
+#include <linuxmt/timer.h>
 #include <linuxmt/mm.h>
+#include <linuxmt/heap.h>
+#include <linuxmt/memory.h>
+#include <linuxmt/errno.h>
 #include <linuxmt/directhd.h>
 #include <linuxmt/debug.h>
 
 #include <arch/hdreg.h>
 #include <arch/io.h>
+#include <arch/irq.h>
+#include <arch/ports.h>
 #include <arch/segment.h>
-
-/* maybe we should have word-wide input here instead of byte-wide ? */
-#define STATUS(port) inb_p(port + DIRECTHD_STATUS)
-#define ERROR(port) inb_p(port + DIRECTHD_ERROR)
-
-#define WAITING(port) (STATUS(port) & 0x80) == 0x80
-
-/* use asm insw/outsw instead of C version */
-/* asm versions should work on 8088/86, but only with CONFIG_PC_XT */
-/* #define USE_ASM */
-
-/* uncomment this to include debugging code .. this increases size of driver */
-#define USE_DEBUG_CODE
+#include <arch/system.h>
 
 #define MAJOR_NR ATHD_MAJOR
 #define ATDISK
 #include "blk.h"
 
-static int directhd_ioctl();
-static int directhd_open();
-static void directhd_release();
+#define STATUS(port)    inb_p((port) + DIRECTHD_STATUS)
+#define ERROR(port)     inb_p((port) + DIRECTHD_ERROR)
+
+#define ATA_SECTOR_SIZE 512
+#define MINOR_SHIFT     3       /* same partition layout as bioshd */
+#define WAIT_PROBE      (3*HZ/100)  /* IDENTIFY timeout, 30 msecs */
+#define WAIT_READY      (2*HZ)      /* command and lost interrupt timeout */
+
+#define MAX_ERRS        3       /* retries before failing a request */
+
+static int directhd_ioctl(struct inode *, struct file *, unsigned int, unsigned int);
+static int directhd_open(struct inode *, struct file *);
+static void directhd_release(struct inode *, struct file *);
 
 static struct file_operations directhd_fops = {
-    NULL,			/* lseek */
-    block_read,			/* read */
-    block_write,		/* write */
-    NULL,			/* readdir */
-    NULL,			/* select */
-    directhd_ioctl,		/* ioctl */
-    directhd_open,		/* open */
-    directhd_release		/* release */
+    NULL,                       /* lseek */
+    block_read,                 /* read */
+    block_write,                /* write */
+    NULL,                       /* readdir */
+    NULL,                       /* select */
+    directhd_ioctl,             /* ioctl */
+    directhd_open,              /* open */
+    directhd_release            /* release */
 };
 
-/* what is this good for ? */
-static int access_count[4] = { 0, };
+static int access_count[MAX_DRIVES];
 
 static int io_ports[2] = { HD1_PORT, HD2_PORT };
+static int io_irqs[2] = { HD1_AT_IRQ, HD2_AT_IRQ };
 
 static int directhd_initialized = 0;
+int directhd_drives;            /* bitmask of drives found, checked by bioshd */
 
-static struct drive_infot {
-    int cylinders;
-    int sectors;
-    int heads;
-} drive_info[4] = { 0, };	/* preset to 0 */
+static struct drive_infot drive_info[MAX_DRIVES];
+static sector_t drive_sects[MAX_DRIVES];    /* total addressable sectors */
+static unsigned char drive_lba[MAX_DRIVES]; /* LBA addressing supported */
+static unsigned char drive_multi[MAX_DRIVES];   /* sectors per block, 1 = no multiple */
+static unsigned char chan_irq[2];           /* channel completes by interrupt */
 
-static struct hd_struct hd[4 << 6];
-static void directhd_geninit();
+static struct hd_struct hd[MAX_DRIVES << MINOR_SHIFT];
+static void directhd_geninit(void);
 
 static struct gendisk directhd_gendisk = {
-    MAJOR_NR,			/* major number */
-    "dhd",			/* device name */
-    6,
-    1 << 6,
-    4,
-    directhd_geninit,		/* init */
-    hd,				/* hd struct */
-    0,
+    MAJOR_NR,                   /* major number */
+    "dhd",                      /* device name */
+    MINOR_SHIFT,                /* bits to shift to get real from partition */
+    1 << MINOR_SHIFT,           /* number of partitions per real */
+    MAX_DRIVES,                 /* maximum number of drives */
+    directhd_geninit,           /* init */
+    hd,                         /* hd struct */
+    0,                          /* hd drives found */
     drive_info,
-    NULL
+    NULL                        /* next */
 };
 
-void directhd_geninit(void)
-{
-    int i;
-
-    for (i = 0; i < 4 << 6; i++) {
-	if ((i & ((1 << 6) - 1)) == 0) {
-	    hd[i].start_sect = 0;
-	    hd[i].nr_sects = (sector_t)drive_info[i >> 6].sectors *
-		drive_info[i >> 6].heads * drive_info[i >> 6].cylinders;
-	} else {
-	    hd[i].start_sect = -1;
-	    hd[i].nr_sects = 0;
-	}
-    }
-    return;
-}
+/* state of the request in progress */
+static int dhd_busy;            /* request started on the drive */
+static int dhd_drive;           /* drive of current request */
+static sector_t dhd_sector;     /* next sector to transfer */
+static unsigned int dhd_count;  /* sectors remaining */
+static unsigned int dhd_pass;   /* sectors in block being transferred */
+static char *dhd_buf;           /* buffer offset of next sector */
+static int dhd_errs;            /* retries remaining */
+
+#ifdef CONFIG_ASYNCIO
+static struct wait_queue dhd_waitq; /* request function waiting for interrupt */
+static int dhd_intr;            /* 0 waiting, 1 interrupted, -1 timed out */
+static int dhd_status;          /* status register read by interrupt */
+#endif
 
-#ifndef USE_ASM
+#ifdef CONFIG_FS_XMS_BUFFER
+static word_t *dhd_bounce;      /* sector buffer for PIO to XMS */
+#endif
 
-void insw(unsigned int port,unsigned int *buffer,int count)
+static void directhd_geninit(void)
 {
     int i;
 
-    for (i = 0; i < count / 2; i++)
-	buffer[i] = inw(port);
-    return;
+    for (i = 0; i < MAX_DRIVES << MINOR_SHIFT; i++) {
+        if ((i & ((1 << MINOR_SHIFT) - 1)) == 0 && drive_sects[i >> MINOR_SHIFT]) {
+            hd[i].start_sect = 0;
+            hd[i].nr_sects = drive_sects[i >> MINOR_SHIFT];
+        } else {
+            hd[i].start_sect = -1;
+            hd[i].nr_sects = 0;
+        }
+    }
 }
 
-#else
-
-/* this _should_ work on an 8088/86 now, but I haven't tested it yet */
-
-void insw(unsigned int port,unsigned int *buffer,int count)
+/* PIO transfer of count sectors between the drive and buf:seg */
+static void dhd_insw(word_t port, char *buf, ramdesc_t seg, unsigned int count)
 {
-#asm
-	push	bp
-	mov	bp, sp
-	push	cx
-	push	di
-	push	dx
-	mov	dx, [bp + 04]
-	mov	di, [bp + 06]
-	mov	cx, [bp + 08]
-	shr	cx, 1
-	cld
-#ifndef CONFIG_PC_XT
-	repz
-	insw
-#else
-			/* this should work on an 8088 */
-dhd_insw_loop:
-	in	ax, dx
-	stosw
-	loop	dhd_insw_loop
+    word_t __far *p;
+    int n;
+
+    do {
+#ifdef CONFIG_FS_XMS_BUFFER
+        if (seg >> 16) {
+            word_t *b = dhd_bounce;
+            n = ATA_SECTOR_SIZE / 2;
+            do {
+                *b++ = inw(port);
+            } while (--n);
+            xms_fmemcpyw(buf, seg, dhd_bounce, kernel_ds, ATA_SECTOR_SIZE / 2);
+            buf += ATA_SECTOR_SIZE;
+            continue;
+        }
 #endif
-	pop	dx
-	pop	di
-	pop	cx
-	pop	bp
-#endasm
+        p = _MK_FP((seg_t)seg, (unsigned)buf);
+        n = ATA_SECTOR_SIZE / 2;
+        do {
+            *p++ = inw(port);
+        } while (--n);
+        buf += ATA_SECTOR_SIZE;
+    } while (--count);
 }
 
+static void dhd_outsw(word_t port, char *buf, ramdesc_t seg, unsigned int count)
+{
+    word_t __far *p;
+    int n;
+
+    do {
+#ifdef CONFIG_FS_XMS_BUFFER
+        if (seg >> 16) {
+            word_t *b = dhd_bounce;
+            xms_fmemcpyw(dhd_bounce, kernel_ds, buf, seg, ATA_SECTOR_SIZE / 2);
+            n = ATA_SECTOR_SIZE / 2;
+            do {
+                outw(*b++, port);
+            } while (--n);
+            buf += ATA_SECTOR_SIZE;
+            continue;
+        }
 #endif
+        p = _MK_FP((seg_t)seg, (unsigned)buf);
+        n = ATA_SECTOR_SIZE / 2;
+        do {
+            outw(*p++, port);
+        } while (--n);
+        buf += ATA_SECTOR_SIZE;
+    } while (--count);
+}
 
-#ifndef USE_ASM
-
-void outsw(unsigned int port,unsigned int *buffer,int count)
+/* wait for BSY to clear, return status or -1 on timeout */
+static int dhd_wait(word_t port, jiff_t timeout)
 {
-    int i;
+    int status;
 
-    for (i = 0; i < count / 2; i++)
-	outw(port, buffer[i]);
-    return;
+    timeout += jiffies;
+    while ((status = STATUS(port)) & DIRECTHD_ST_BSY) {
+        if (time_after(jiffies, timeout))
+            return -1;
+    }
+    return status;
 }
 
-#else
+/* select drive and issue command, using LBA or CHS addressing */
+static void out_hd(int drive, unsigned int nsect, sector_t start, int cmd)
+{
+    word_t port = io_ports[drive >> 1];
+    unsigned int sect, cyl, head;
 
-/* the assembler version. Again, this should work,
- * but I haven't had a chance to test it yet.
- */
+    if (drive_lba[drive]) {
+        sect = (unsigned int)start & 0xff;
+        cyl = (unsigned int)(start >> 8);
+        head = DIRECTHD_LBA | ((unsigned int)(start >> 24) & 0x0f);
+    } else {
+        struct drive_infot *drivep = &drive_info[drive];
+        sector_t tmp = start / drivep->sectors;
 
-void outsw(unsigned int port,unsigned int *buffer,int count)
+        sect = (unsigned int)(start % drivep->sectors) + 1;
+        head = (unsigned int)(tmp % drivep->heads);
+        cyl = (unsigned int)(tmp / drivep->heads);
+    }
+    outb_p(DIRECTHD_DRIVE0 | ((drive & 1) << 4) | head, port + DIRECTHD_DH);
+    outb_p(0, port + DIRECTHD_FEATURE);
+    outb_p(nsect, port + DIRECTHD_SEC_COUNT);
+    outb_p(sect, port + DIRECTHD_SECTOR);
+    outb_p(cyl, port + DIRECTHD_CYLINDER_LO);
+    outb_p(cyl >> 8, port + DIRECTHD_CYLINDER_HI);
+    outb_p(cmd, port + DIRECTHD_COMMAND);
+}
+
+/* start the CURRENT request on the drive, return 0 if queue empty */
+static int dhd_start(void)
 {
-#asm
-	push	bp
-	mov	bp, sp
-	push	cx
-	push	si
-	push	dx
-	mov	dx, [bp + 04]
-	mov	si, [bp + 06]
-	mov	cx, [bp + 08]
-	shr	cx, 1
-	cld
-#ifndef CONFIG_PC_XT
-	repz
-	outsw
-#else
-dhd_outsw_loop:		/* this should work on an 8088 */
-	lodsw
-	out	dx, ax
-	loop	dhd_outsw_loop
+    struct request *req;
+    word_t port;
+    int minor, cmd, status;
+
+    while ((req = CURRENT) != NULL) {
+        CHECK_REQUEST(req);
+
+        if (directhd_initialized != 1) {
+            end_request(0);
+            continue;
+        }
+
+        minor = MINOR(req->rq_dev);
+        dhd_drive = minor >> MINOR_SHIFT;
+        if (dhd_drive >= MAX_DRIVES || !drive_sects[dhd_drive]) {
+            printk("dhd: non-existent drive\n");
+            end_request(0);
+            continue;
+        }
+
+        if (hd[minor].start_sect == (sector_t)-1 ||
+            req->rq_sector + req->rq_nr_sectors > hd[minor].nr_sects) {
+            printk("dhd: sector %ld access beyond partition (%ld,%ld)\n",
+                req->rq_sector, hd[minor].start_sect, hd[minor].nr_sects);
+            end_request(0);
+            continue;
+        }
+
+        if (dhd_errs == 0) {        /* new request, not a retry */
+            dhd_errs = MAX_ERRS;
+            dhd_sector = req->rq_sector + hd[minor].start_sect;
+            dhd_count = req->rq_nr_sectors;
+            dhd_buf = req->rq_buffer;
+        }
+
+        port = io_ports[dhd_drive >> 1];
+        if (dhd_wait(port, WAIT_READY) < 0) {
+            printk("dhd: drive %d busy\n", dhd_drive);
+            dhd_errs = 0;
+            end_request(0);
+            continue;
+        }
+
+        dhd_pass = drive_multi[dhd_drive];
+        if (req->rq_cmd == WRITE)
+            cmd = (dhd_pass > 1)? DIRECTHD_WRITE_MULTI: DIRECTHD_WRITE;
+        else cmd = (dhd_pass > 1)? DIRECTHD_READ_MULTI: DIRECTHD_READ;
+        if (dhd_pass > dhd_count)
+            dhd_pass = dhd_count;
+
+        debug_blk("dhd%c: cmd %x lba %ld count %d\n", 'a'+dhd_drive, cmd,
+            dhd_sector, dhd_count);
+        dhd_busy = 1;
+#ifdef CONFIG_ASYNCIO
+        dhd_intr = 0;
 #endif
-	pop	dx
-	pop	si
-	pop	cx
-	pop	bp
-#endasm
+        out_hd(dhd_drive, dhd_count, dhd_sector, cmd);
+
+        if (req->rq_cmd == WRITE) {
+            /* first block is written without waiting for an interrupt */
+            status = dhd_wait(port, WAIT_READY);
+            if (status < 0 || !(status & DIRECTHD_ST_DRQ)) {
+                dhd_busy = 0;
+                dhd_errs = 0;
+                end_request(0);
+                continue;
+            }
+            dhd_outsw(port, dhd_buf, req->rq_seg, dhd_pass);
+        }
+        return 1;
+    }
+    return 0;
 }
 
-#endif
+/* handle block completion for the request in progress */
+static void dhd_block(int status)
+{
+    struct request *req = CURRENT;
+    word_t port = io_ports[dhd_drive >> 1];
+
+    if (status < 0 || (status & (DIRECTHD_ST_ERR|DIRECTHD_ST_DF)) ||
+        (req->rq_cmd == READ && !(status & DIRECTHD_ST_DRQ))) {
+        printk("dhd%c: status 0x%x error 0x%x lba %ld\n", 'a'+dhd_drive,
+            status, ERROR(port), dhd_sector);
+        dhd_busy = 0;
+        if (--dhd_errs == 0)
+            end_request(0);
+        return;                     /* dhd_start retries remaining sectors */
+    }
 
-#if 0				/* not used */
+    if (req->rq_cmd == READ)
+        dhd_insw(port, dhd_buf, req->rq_seg, dhd_pass);
+    dhd_sector += dhd_pass;
+    dhd_count -= dhd_pass;
+    dhd_buf += dhd_pass * ATA_SECTOR_SIZE;
+    if (dhd_pass > dhd_count)
+        dhd_pass = dhd_count;
+
+    if (dhd_count == 0) {
+        dhd_busy = 0;
+        dhd_errs = 0;
+        end_request(1);
+        return;
+    }
+    if (req->rq_cmd == WRITE) {
+#ifdef CONFIG_ASYNCIO
+        dhd_intr = 0;
+#endif
+        dhd_outsw(port, dhd_buf, req->rq_seg, dhd_pass);
+    }
+}
 
-void swap_order(unsigned char *buffer,int count)
+#ifdef CONFIG_ASYNCIO
+/* record completion status, the request function does the transfer */
+static void directhd_interrupt(int irq, struct pt_regs *regs)
 {
-    int i;
-    char tmp;
-
-    for (i = 0; i < count; i++)
-	if ((i % 2) == 0) {
-	    tmp = *(buffer + i + 1);
-	    *(buffer + i + 1) = *(buffer + i);
-	    *(buffer + i) = tmp;
-	}
-    return;
+    int status = STATUS(io_ports[irq == io_irqs[1]]);   /* also acks drive IRQ */
+
+    if (!dhd_busy || dhd_intr || io_irqs[dhd_drive >> 1] != irq)
+        return;                     /* spurious */
+    dhd_status = status;
+    dhd_intr = 1;
+    wake_up(&dhd_waitq);
 }
 
+/* completion timer, the drive didn't interrupt in time */
+static void dhd_timeout(int data)
+{
+    if (!dhd_intr) {
+        dhd_intr = -1;
+        wake_up(&dhd_waitq);
+    }
+}
 #endif
 
-void out_hd(unsigned int drive,unsigned int nsect,unsigned int sect,
-	    unsigned int head,unsigned int cyl,unsigned int cmd)
+/*
+ * Wait for the block in progress to complete and return the drive status,
+ * or -1 on timeout. Sleeps until the drive interrupts if the channel has an
+ * IRQ, else polls. The idle task polls too, for partition reads at boot.
+ */
+static int dhd_complete(void)
 {
-    unsigned int port;
-
-    port = io_ports[drive / 2];
-    /* setting WPCOM to 0 is not good. this change uses the last value input to
-     * the drive. (my BIOS sets this correctly, so it works for now but we should
-     * fix this to work properly)  -- Alastair Bridgewater */
-    /* this doesn't matter on newer (IDE) drives, but is important for MFM/RLLs
-     * I'll add support for those later and we'll need it then - Blaz Antonic */
-    /* meanwhile, I found some documentation that says that for IDE drives
-     * the correct WPCOM value is 0xff. so I changed it.
-     * -- Alastair Bridewater */
-#if 0
-    outb_p(0, ++port);	/* wr_precompensation .. */
-    port++;
+    word_t port = io_ports[dhd_drive >> 1];
+#ifdef CONFIG_ASYNCIO
+    struct timer_list timer;
+    int status;
+
+    if (chan_irq[dhd_drive >> 1] && current->pid) {
+        timer.tl_expires = jiffies + WAIT_READY;
+        timer.tl_data = 0;
+        timer.tl_function = dhd_timeout;
+        add_timer(&timer);
+        do {
+            prepare_to_wait(&dhd_waitq);
+            if (!dhd_intr)
+                do_wait();
+            finish_wait(&dhd_waitq);
+        } while (!dhd_intr);
+        del_timer(&timer);
+        if (dhd_intr > 0)
+            return dhd_status;
+
+        /* lost interrupt, carry on if the drive has finished anyway */
+        status = STATUS(port);
+        printk("dhd%c: lost interrupt, status 0x%x\n", 'a'+dhd_drive, status);
+        return (status & DIRECTHD_ST_BSY)? -1: status;
+    }
 #endif
-    outb(0xff, ++port);		/* the supposedly correct value for WPCOM on IDE */
-    outb_p(nsect, ++port);
-    outb_p(sect, ++port);
-    outb_p(cyl, ++port);
-    outb_p(cyl >> 8, ++port);
-    outb_p(0xA0 | ((drive % 2) << 4) | head, ++port);
-    outb_p(cmd, ++port);
-
-    return;
+    return dhd_wait(port, WAIT_READY);
 }
 
-int directhd_init(void)
+static int dhd_identify(int drive, word_t *buffer)
 {
-    unsigned int buffer[256];
-    struct gendisk *ptr;
-    int i, j, hdcount = 0, drive;
-    unsigned int port;
-
-    /* .. once for each drive */
-    /* note, however, that this breaks if you don't have two IDE interfaces
-     * in your computer. If you only have one, change the 4 to a 2.
-     * (this explains why your computer was locking up after mentioning the
-     * serial port, doesn't it? :-) -- Alastair Bridgewater */
-    /* this should work now, IMO - Blaz Antonic */
-    for (drive = 0; drive < 2; drive++) {
-	/* send drive_ID command to drive */
-	out_hd(drive, 0, 0, 0, 0, DIRECTHD_DRIVE_ID);
-
-	port = io_ports[drive / 2];
-
-	/* wait */
-	while (WAITING(port));
+    word_t port = io_ports[drive >> 1];
+    int status;
+
+    outb_p(DIRECTHD_DRIVE0 | ((drive & 1) << 4), port + DIRECTHD_DH);
+    if (STATUS(port) == 0xff)       /* floating bus, no drive */
+        return -1;
+    outb_p(DIRECTHD_DRIVE_ID, port + DIRECTHD_COMMAND);
+    status = dhd_wait(port, WAIT_PROBE);
+    if (status <= 0 || (status & DIRECTHD_ST_ERR) || !(status & DIRECTHD_ST_DRQ))
+        return -1;
+    dhd_insw(port + DIRECTHD_DATA, (char *)buffer, kernel_ds, 1);
+    return 0;
+}
 
-	if ((STATUS(port) & 1) == 1) {
-	    /* error - drive not found or non-ide */
-#ifdef USE_DEBUG_CODE
-	    printk("athd: drive %d (%d on port 0x%x) not found\n", drive,
-		   drive / 2, port);
-#endif
-	    continue;		/* this jumps to the start of for loop and
-				 * proceeds with checking for other drives
-				 */
-	    /* this could use some optimisation as it is unlikely for
-	     * computer to have slave drive on channel where master is
-	     * missing
-	     *
-	     * Actually, that does occur, so any such optimisation is most
-	     * probably just plain broken - Riley Williams, April 2002.
-	     */
-	}
-
-	/* get drive info */
-
-	insw(port, buffer, 512);
-#if 0
-	swap_order(buffer, 512);
-#endif
+/* find largest power of 2 multiple count supported and set it */
+static void dhd_set_multiple(int drive, unsigned int max)
+{
+    word_t port = io_ports[drive >> 1];
+    unsigned int n = DIRECTHD_MAX_MULTI;
+    int status;
+
+    drive_multi[drive] = 1;
+    while (n > max)
+        n >>= 1;
+    if (n < 2)
+        return;
+    out_hd(drive, n, 0, DIRECTHD_SET_MULTI);
+    status = dhd_wait(port, WAIT_PROBE);
+    if (status >= 0 && !(status & (DIRECTHD_ST_ERR|DIRECTHD_ST_DF)))
+        drive_multi[drive] = n;
+}
 
-#if 0			/* this is a bug - read CD info few lines lower */
-	if (!*buffer) {
-	    /* unexpected 0; drive doesn't exist ? */
-	    /* something went wrong */
-	    debug("athd: drive not found\n");
-	    break;
+int INITPROC directhd_init(void)
+{
+    struct gendisk *ptr;
+    word_t *buffer;
+    int drive, hdcount = 0;
+
+    buffer = (word_t *)heap_alloc(ATA_SECTOR_SIZE, HEAP_TAG_DRVR);
+    if (!buffer)
+        return -ENOMEM;
+
+    for (drive = 0; drive < MAX_DRIVES; drive++) {
+        struct drive_infot *drivep = &drive_info[drive];
+        word_t port = io_ports[drive >> 1];
+
+        /* interrupts off while probing */
+        outb_p(DIRECTHD_CTL_NIEN, port + DIRECTHD_CONTROL);
+        if (dhd_identify(drive, buffer))
+            continue;
+
+        /* skip ATAPI and devices without a usable geometry */
+        if ((buffer[DIRECTHD_ID_CONFIG] & 0x8000) || buffer[DIRECTHD_ID_CUR_CYLS] == 0
+            || buffer[DIRECTHD_ID_CUR_HEADS] == 0 || buffer[DIRECTHD_ID_CUR_SECTORS] == 0)
+            continue;
+
+        drivep->cylinders = buffer[DIRECTHD_ID_CUR_CYLS];
+        drivep->heads = buffer[DIRECTHD_ID_CUR_HEADS];
+        drivep->sectors = buffer[DIRECTHD_ID_CUR_SECTORS];
+        drivep->sector_size = ATA_SECTOR_SIZE;
+        drivep->fdtype = -1;
+        drive_sects[drive] = (sector_t)drivep->cylinders * drivep->heads * drivep->sectors;
+
+        if (buffer[DIRECTHD_ID_CAPS] & 0x0200) {
+            drive_lba[drive] = 1;
+            drive_sects[drive] = buffer[DIRECTHD_ID_LBA_SECTS] |
+                ((sector_t)buffer[DIRECTHD_ID_LBA_SECTS+1] << 16);
+        }
+        dhd_set_multiple(drive, buffer[DIRECTHD_ID_MAX_MULTI] & 0xff);
+
+        printk("dhd%c: %luK %s CHS %u,%d,%d multiple %d\n", 'a'+drive,
+            drive_sects[drive] >> 1, drive_lba[drive]? "LBA": "CHS",
+            drivep->cylinders, drivep->heads, drivep->sectors, drive_multi[drive]);
+        directhd_drives |= 1 << drive;
+        hdcount++;
+    }
 
-	}
+#ifdef CONFIG_FS_XMS_BUFFER
+    dhd_bounce = buffer;            /* keep for PIO to XMS buffers */
+#else
+    heap_free(buffer);
 #endif
-	/* Gather useful info
-	 * FIXME: LBA support will be added here, later .. maybe ..
-	 * MFM/RLL support will be added after that .. maybe
-	 *
-	 * Safety check - check for heads returned and assume CD
-	 * if we get typical CD response .. this is a good place for
-	 * ATAPI ID, but it'd only enlarge the kernel and no HD can
-	 * have 60416 heads :-))) .. 4096 heads should cover it,
-	 * IDE will be dead by that time
-	 *
-	 * Maybe we can assume some specific number here ? i always
-	 * get 60416 with ATAPI (Mitsumi) CD - Blaz Antonic
-	 *
-	 * Safety check - head, cyl and sector values must be other than
-	 * 0 and buffer has to contain valid data (first entry in buffer
-	 * must be other than 0)
-	 *
-	 * FIXME: This will cause problems on many new drives .. some
-	 * of them even have more than 16.384 cylinders
-	 *
-	 * This is some sort of bugfix, we will use same method as real Linux -
-	 * work with disk geometry set in current translation mode rather than
-	 * using physical drive info. Physical info might correspond to logical
-	 * info for some drives (those which don't support/use LBA mode
-	 */
-
-	if ((buffer[0x6c / 2] < 34096) && (*buffer != 0)
-	    && (buffer[0x6c / 2] != 0) && (buffer[0x6e / 2] != 0)
-	    && (buffer[0x70 / 2] != 0)) {
-	    /* Physical value offsets: cyl 0x2, heads 0x6, sectors 0C */
-	    drive_info[drive].cylinders = buffer[0x6c / 2];
-	    drive_info[drive].heads = buffer[0x6e / 2];
-	    drive_info[drive].sectors = buffer[0x70 / 2];
-
-	    hdcount++;
-	}
-    }
 
     if (!hdcount) {
-	printk("athd: no drives found\n");
-	return 0;
+        printk("dhd: no drives found\n");
+        return 0;
     }
 
-    directhd_gendisk.nr_hd = hdcount;
-
     if (register_blkdev(MAJOR_NR, DEVICE_NAME, &directhd_fops)) {
-	printk("athd: unable to register\n");
-	return -1;
+        printk("dhd: unable to register\n");
+        directhd_drives = 0;
+        return -1;
+    }
+
+    for (drive = 0; drive < 2; drive++) {
+        if (!(directhd_drives & (3 << (drive << 1))))
+            continue;
+#ifdef CONFIG_ASYNCIO
+        if ((sys_caps & CAP_IRQ8TO15) &&
+            !request_irq(io_irqs[drive], directhd_interrupt, INT_GENERIC)) {
+            chan_irq[drive] = 1;
+            outb_p(0, io_ports[drive] + DIRECTHD_CONTROL);
+        } else
+            printk("dhd: IRQ %d unavailable, polling\n", io_irqs[drive]);
+#endif
     }
 
     blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;
+    for (drive = MAX_DRIVES; !(directhd_drives & (1 << (drive - 1))); drive--)
+        ;
+    directhd_gendisk.nr_hd = drive;     /* partition check skips missing drives */
     if (gendisk_head == NULL) {
-	directhd_gendisk.next = gendisk_head;
-	gendisk_head = &directhd_gendisk;
+        directhd_gendisk.next = gendisk_head;
+        gendisk_head = &directhd_gendisk;
     } else {
-	for (ptr = gendisk_head; ptr->next != NULL; ptr = ptr->next);
-	ptr->next = &directhd_gendisk;
-	directhd_gendisk.next = NULL;
+        for (ptr = gendisk_head; ptr->next != NULL; ptr = ptr->next)
+            ;
+        ptr->next = &directhd_gendisk;
+        directhd_gendisk.next = NULL;
     }
 
-    printk("athd: found %d hard drive%c\n", hdcount, hdcount == 1 ? ' ' : 's');
-
-    /* print drive info */
-    for (i = 0; i < 4; i++)
-	/* sanity check */
-	if (drive_info[i].heads != 0) {
-	    printk("athd: /dev/dhd%c: %d heads, %d cylinders, %d sectors\n",
-		   (i + 'a'),
-		   drive_info[i].heads,
-		   drive_info[i].cylinders, drive_info[i].sectors);
-	}
-
     directhd_initialized = 1;
-
     return 0;
 }
 
-/* why is arg unsigned int here if it's used as hd_geometry later ?
- * one of joys of K&R ? Someone please answer ...
- */
 static int directhd_ioctl(struct inode *inode, struct file *filp,
-		unsigned int cmd, unsigned int arg)
+        unsigned int cmd, unsigned int arg)
 {
     struct hd_geometry *loc = (struct hd_geometry *) arg;
     int dev, err;
 
     if ((!inode) || !(inode->i_rdev))
-	return -EINVAL;
+        return -EINVAL;
 
     dev = DEVICE_NR(inode->i_rdev);
     if (dev >= MAX_DRIVES)
-	return -ENODEV;
+        return -ENODEV;
 
     switch (cmd) {
     case HDIO_GETGEO:
-	/* safety check .. i presume :) */
-	err = verify_area(VERIFY_WRITE, arg, sizeof(*loc));
-	if (err)
-	    return err;
-
-	put_user(drive_info[dev].heads, &loc->heads);
-	put_user(drive_info[dev].sectors, &loc->sectors);
-	put_user(drive_info[dev].cylinders, &loc->cylinders);
-	put_user(hd[MINOR(inode->i_rdev)].start_sect, &loc->start);
-
-	return 0;
-	break;
+        err = verify_area(VERIFY_WRITE, (void *)loc, sizeof(struct hd_geometry));
+        if (!err) {
+            put_user_char(drive_info[dev].heads, &loc->heads);
+            put_user_char(drive_info[dev].sectors, &loc->sectors);
+            put_user(drive_info[dev].cylinders, &loc->cylinders);
+            put_user_long(hd[MINOR(inode->i_rdev)].start_sect, &loc->start);
+        }
+        return err;
     }
 
     return -EINVAL;
@@ -412,209 +560,43 @@ static int directhd_open(struct inode *inode, struct file *filp)
     unsigned int minor;
     int target = DEVICE_NR(inode->i_rdev);
 
-    if (target >= 4 || !directhd_initialized)
-	return -ENXIO;
+    if (target >= MAX_DRIVES || !directhd_initialized)
+        return -ENXIO;
     minor = MINOR(inode->i_rdev);
-    if (((int) hd[minor].start_sect) == -1)
-	return -ENXIO;
+    if (hd[minor].start_sect == (sector_t)-1 || !drive_sects[target])
+        return -ENXIO;
 
     access_count[target]++;
-
-    /* something should be here, but can't remember what :)
-     * it really isn't important until probe code works
-     *
-     * probe code works now but i still can't remember what is missing.
-     * any clues ?
-     */
-
-    inode->i_size = (hd[minor].nr_sects) << 9;
+    inode->i_size = hd[minor].nr_sects * ATA_SECTOR_SIZE;
+    /* limit inode size to max filesize for >= 4MB (2^22) */
+    if (hd[minor].nr_sects >= 0x00400000L)
+        inode->i_size = 0x7ffffffL;
     return 0;
 }
 
 static void directhd_release(struct inode *inode, struct file *filp)
 {
-    int target = DEVICE_NR(inode->i_rdev);
-
-    access_count[target]--;
-
-    /* nothing really to do */
+    kdev_t dev = inode->i_rdev;
+    int target = DEVICE_NR(dev);
 
-    return;
+    if (--access_count[target] == 0) {
+        fsync_dev(dev);
+        invalidate_inodes(dev);
+        invalidate_buffers(dev);
+    }
 }
 
-void do_directhd_request(void)
+/*
+ * Called by add_request when the queue goes non-empty. Runs every queued
+ * request in the caller's context, including those added while it sleeps.
+ */
+static void do_directhd_request(void)
 {
-    sector_t count;		/* # of sectors to read/write */
-    int this_pass;		/* # of sectors read/written */
-    sector_t start;		/* first sector */
-    char *buff;			/* max_sect * sector_size, 63 * 512 bytes; it seems that all requests are only 1024 bytes */
-    short sector;		/* 1 .. 63 ? */
-    short cylinder;		/* 0 .. 1024 and maybe more */
-    short head;			/* 0 .. 16 */
-    unsigned int tmp;
-    int minor;
-    int drive;			/* 0 .. 3 */
-    unsigned char i;		/* 0 .. (sectors per track - 1) .. 62 or less */
-    unsigned char j;		/* 0 .. 255 */
-    int port;
-
-    while (1) {			/* process HD requests */
-	struct request *req = CURRENT;
-	if (!req)
-	    return;
-	CHECK_REQUEST(req);
-
-	if (directhd_initialized != 1) {
-	    end_request(0);
-	    continue;
-	}
-
-	minor = MINOR(req->rq_dev);
-	drive = minor >> 6;
-
-	/* check if drive exists */
-	if (drive > 3 || drive < 0 || drive_info[drive].heads == 0) {
-	    printk("Non-existent drive\n");
-	    end_request(0);
-	    continue;
-	}
-
-	count = req->rq_nr_sectors;
-	start = req->rq_sector;
-	buff = req->rq_buffer;
-
-	/* safety check should be here */
-
-	if (hd[minor].start_sect == -1 || hd[minor].nr_sects < start) {
-	    printk("Bad partition start\n");
-	    end_request(0);
-	    continue;
-	}
-
-	start += hd[minor].start_sect;
-
-	while (count > 0) {
-	    sector = (start % drive_info[drive].sectors) + 1;
-	    tmp = start / drive_info[drive].sectors;
-	    head = tmp % drive_info[drive].heads;
-	    cylinder = tmp / drive_info[drive].heads;
-
-#if 0
-	    this_pass = count;	/* this is redundant */
-#endif
-	    if (count <= (drive_info[drive].sectors - sector + 1))
-		this_pass = count;
-	    else
-		this_pass = drive_info[drive].sectors - sector + 1;
-
-#ifdef USE_DEBUG_CODE
-	    printk
-		("athd: drive: %d cylinder: %d head: %d sector: %d start: %d\n",
-		 drive, cylinder, head, sector, start);
-#endif
-
-	    port = io_ports[drive / 2];
-
-	    if (req->rq_cmd == READ) {
-#ifdef USE_DEBUG_CODE
-		printk("athd: drive: %d this_pass: %d sector: %d head: %d\n", drive, this_pass, sector, head);
-		printk("athd: cyl: %d start: %ld tmp: %d count: %ld di[d].s: %d di[0].s: %d\n", cylinder, start, tmp, count, drive_info[drive].sectors, drive_info[0].sectors);
-#endif
-		/* read to buffer */
-		while (WAITING(port));
-		/* send drive parameters */
-		out_hd(drive, this_pass, sector, head, cylinder,
-		       DIRECTHD_READ);
-
-		/* wait */
-		while (WAITING(port)) {
-#ifdef USE_DEBUG_CODE
-		    //printk("athd: statusa: 0x%x\n", STATUS(port));
-#endif
-		}
-		if ((STATUS(port) & 1) == 1) {
-
-		    /* something went wrong */
-		    printk("athd: status: 0x%x error: 0x%x\n", STATUS(port),
-			   ERROR(port));
-
-		    break;
-#if 0
- 		    end_request(0);
-#endif
-		}
-
-		tmp = 0x00;
-		while ((tmp & 0x08) != 0x08) {
-		    if ((tmp & 1) == 1) {
-
-			printk("athd: status: 0x%x error: 0x%x\n",
-			       STATUS(port), ERROR(port));
-
-			break;
-			end_request(0);
-		    } else {
-			tmp = STATUS(port);
-#ifdef USE_DEBUG_CODE
-			//printk("athd: statusb: 0x%x\n", tmp);
-#endif
-		    }
-		}
-
-
-		/* read this_pass * 512 bytes, which is 63 * 512 b max. */
-		insw(port, buff, this_pass * 512);
-	    }
-	    if (req->rq_cmd == WRITE) {
-		/* write from buffer */
-		while (WAITING(port));
-		/* send drive parameters */
-		out_hd(drive, this_pass, sector, head, cylinder,
-		       DIRECTHD_WRITE);
-
-		/* wait */
-		while (WAITING(port)) {
-#ifdef USE_DEBUG_CODE
-		    //printk("athd: statusa: 0x%x\n", STATUS(port));
-#endif
-		}
-		if ((STATUS(port) & 1) == 1) {
-
-		    /* something went wrong */
-		    printk("athd: status: 0x%x error: 0x%x\n", STATUS(port),
-			   ERROR(port));
-
-		    break;
-#if 0
-		    end_request(0);
-#endif
-		}
-
-		tmp = 0x00;
-		while ((tmp & 0x08) != 0x08) {
-		    if ((tmp & 1) == 1) {
-
-			printk("athd: status: 0x%x error: 0x%x\n",
-			       STATUS(port), ERROR(port));
-
-			break;
-			end_request(0);
-		    } else {
-			tmp = STATUS(port);
-#ifdef USE_DEBUG_CODE
-			//printk("athd: statusb: 0x%x\n", tmp);
-#endif
-		    }
-		}
-
-		outsw(port, buff, this_pass * 512);
-	    }
-
-	    count -= this_pass;
-	    start += this_pass;
-	    buff += this_pass * 512;
-	}
-	end_request(1);
+    if (dhd_busy)
+        return;
+    while (dhd_start()) {
+        do {
+            dhd_block(dhd_complete());
+        } while (dhd_busy);
     }
-    return;
 }
@@ -326,6 +326,8 @@ void INITPROC setup_dev(register struct gendisk *dev)
 #ifdef CONFIG_BLK_DEV_BHD
     for (int i = 0; i < dev->nr_hd; i++) {
         unsigned int first_minor = i << dev->minor_shift;
+        if (!dev->part[first_minor].nr_sects)
+            continue;
         current_minor = first_minor + 1;
         check_partition(dev, MKDEV(dev->major, first_minor));
     }
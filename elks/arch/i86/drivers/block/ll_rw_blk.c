@@ -167,13 +167,14 @@ static void add_request(struct blk_dev_struct *dev, struct request *req)
     }
 }
 
-static void make_request(unsigned short major, int rw, struct buffer_head *bh)
+static void make_request(unsigned short major, int rw, struct buffer_head *bh,
+    char *buf, ramdesc_t seg)
 {
     struct request *req;
     int max_req;
 
     debug("BLK %lu %s %lx:%x\n", buffer_blocknr(bh), rw==READ? "read": "write",
-        (unsigned long)buffer_seg(bh), buffer_data(bh));
+        (unsigned long)seg, buf);
 
     /* Uhhuh.. Nasty dead-lock possible here.. */
     if (EBH(bh)->b_locked)
@@ -217,27 +218,40 @@ static void make_request(unsigned short major, int rw, struct buffer_head *bh)
     req->rq_cmd = rw;
     req->rq_nr_sectors = BLOCK_SIZE / get_sector_size(req->rq_dev);
     req->rq_sector = buffer_blocknr(bh) * req->rq_nr_sectors;
-    req->rq_seg = buffer_seg(bh);
-    req->rq_buffer = buffer_data(bh);
+    req->rq_seg = seg;
+    req->rq_buffer = buf;
     req->rq_bh = bh;
     req->rq_errors = 0;
     req->rq_next = NULL;
     add_request(&blk_dev[major], req);
 }
 
-/* Read/write a single buffer from a block device */
-void ll_rw_blk(int rw, struct buffer_head *bh)
+static unsigned int blk_major(struct buffer_head *bh)
 {
-    struct blk_dev_struct *dev;
     unsigned int major;
 
-    dev = NULL;
-    if ((major = MAJOR(buffer_dev(bh))) < MAX_BLKDEV)
-        dev = blk_dev + major;
-    if (!dev || !dev->request_fn)
+    if ((major = MAJOR(buffer_dev(bh))) >= MAX_BLKDEV || !blk_dev[major].request_fn)
         panic("ll_rw_blk: unknown dev %D", buffer_dev(bh));
-    make_request(major, rw, bh);
+    return major;
+}
+
+/* Read/write a single buffer from a block device */
+void ll_rw_blk(int rw, struct buffer_head *bh)
+{
+    make_request(blk_major(bh), rw, bh, buffer_data(bh), buffer_seg(bh));
+}
+
+#ifdef CONFIG_BLK_DEV_CHAR
+/*
+ * Read/write the block described by bh directly to/from buf:seg instead
+ * of the buffer's own data area. Used for O_DIRECT raw device I/O,
+ * where bh only supplies the device, block number and completion status.
+ */
+void ll_rw_raw(int rw, struct buffer_head *bh, char *buf, ramdesc_t seg)
+{
+    make_request(blk_major(bh), rw, bh, buf, seg);
 }
+#endif
 
 #ifdef MULTI_BH
 /*
@@ -311,7 +325,7 @@ void ll_rw_block(int rw, int nr, register struct buffer_head **bh)
         plug_device(dev, &plug);
     for (i = 0; i < nr; i++)
         if (bh[i])
-            make_request(major, rw, bh[i]);
+            make_request(major, rw, bh[i], buffer_data(bh[i]), buffer_seg(bh[i]));
     unplug_device(dev);
     return;
 
@@ -28,44 +28,53 @@
 #include "blk.h"
 
 #define MAX_DRIVES	2	/* # ram drives*/
+#ifdef CONFIG_FS_XMS_BUFFER
+#define MAX_SEGMENTS	64	/* max # allocation segments, 4M total when in XMS*/
+#else
 #define MAX_SEGMENTS	8	/* max # seperate allocation segments*/
+#endif
 #define ALLOC_SIZE	4096	/* allocation size in paragaphs*/
 #define PARA		16	/* size of paragraph*/
 
 /* if sector size not 512, must implement IOCTL_BLK_GET_SECTOR_SIZE */
 #define RD_SECTOR_SIZE	512
+#define SEG_SECTORS	(ALLOC_SIZE / (RD_SECTOR_SIZE / PARA))	/* 128 sectors per segment*/
 typedef __u16 rd_sector_t;	/* sector number*/
 
 static struct {			/* ramdrive information*/
     int start;			/* starting memory segment*/
     int valid;			/* ramdisk data valid flag*/
     rd_sector_t size;		/* ramdisk size in 512 byte sectors*/
+    int xms;			/* segments allocated from XMS*/
 } drive_info[MAX_DRIVES] = {
 #if CONFIG_RAMDISK_SEGMENT
-    {0, 1, CONFIG_RAMDISK_SECTORS}
+    {0, 1, CONFIG_RAMDISK_SECTORS, 0}
 #endif
 };
 
-static struct {			/* memory segments, max size ALLOC_SIZE paras (64k)*/
-    seg_t seg;			/* actual segment address*/
+/*
+ * Memory segments, max size ALLOC_SIZE paras (64k), allocated and cleared
+ * when the ramdisk is created or grown, so running out of memory is reported
+ * by RDCREATE/RDRESIZE rather than as a later I/O error. XMS segments are
+ * always a full 64k.
+ */
+static struct {
+    ramdesc_t seg;		/* actual segment address or XMS linear address*/
     segment_s *seg_desc;	/* segment descriptor for heap mgr*/
     int next;			/* next segment*/
     rd_sector_t sectors;	/* segment size in sectors*/
 } rd_segment[MAX_SEGMENTS] = {
 #if CONFIG_RAMDISK_SEGMENT	/* preloaded ramdisk*/
     {CONFIG_RAMDISK_SEGMENT, 0,  -1, CONFIG_RAMDISK_SECTORS},
-#else
-    {0,      0, -1, 0,},
 #endif
-    {0,      0, -1, 0,},
-    {0,      0, -1, 0,},
-    {0,      0, -1, 0,},
-    {0,      0, -1, 0,},
-    {0,      0, -1, 0,},
-    {0,      0, -1, 0,},
-    {0,      0, -1, 0,}
 };
 
+#ifdef CONFIG_FS_XMS_BUFFER
+/* xms_alloc can't free, so XMS segments from destroyed ramdisks are kept for reuse*/
+static ramdesc_t xms_free[MAX_SEGMENTS];
+static int nr_xms_free;
+#endif
+
 static int rd_initialised = 0;
 static int access_count[MAX_DRIVES];
 
@@ -111,98 +120,199 @@ static int find_free_seg(void)
     return -1;
 }
 
-static int dealloc(int target)
+/* free segment chain starting at index i*/
+static void free_segs(int i)
 {
-    int i, j;
+    int j;
 
-    i = drive_info[target].start;
-    debug("RD: dealloc target %d, index %d, size %d sectors\n",
-	   target, i, drive_info[target].size);
     while (i != -1 && rd_segment[i].sectors != 0) {
 	j = i;
-	debug("RD: dealloc purging rd_segment[%d].seg = 0x%x, next index %d, size = %d\n",
-	     j, rd_segment[j].seg, rd_segment[j].next, rd_segment[j].sectors);
+	debug("RD: dealloc purging rd_segment[%d].seg = 0x%lx, next index %d, size = %d\n",
+	     j, (unsigned long)rd_segment[j].seg, rd_segment[j].next, rd_segment[j].sectors);
 	if (rd_segment[j].seg_desc)
 		seg_put(rd_segment[j].seg_desc);
+#ifdef CONFIG_FS_XMS_BUFFER
+	else if (rd_segment[j].seg >> 16)
+		xms_free[nr_xms_free++] = rd_segment[j].seg;
+#endif
 	rd_segment[j].seg_desc = 0;
 	rd_segment[j].seg = 0;
 	rd_segment[j].sectors = 0;
 	i = rd_segment[j].next;
 	rd_segment[j].next = -1;
-	debug("RD: dealloc status rd_segment[%d].seg = 0x%x, next index %d, size = %d\n",
-	     j, rd_segment[j].seg, rd_segment[j].next, rd_segment[j].sectors);
     }
+}
+
+static int dealloc(int target)
+{
+    debug("RD: dealloc target %d, index %d, size %d sectors\n",
+	   target, drive_info[target].start, drive_info[target].size);
+    if (drive_info[target].size)
+	free_segs(drive_info[target].start);
     drive_info[target].valid = 0;
     drive_info[target].size = 0;
     return 0;
 }
 
+/* clear sectors of a segment, works for both main memory and XMS*/
+static int clear_seg(ramdesc_t seg, rd_sector_t sectors)
+{
+#ifdef CONFIG_FS_XMS_BUFFER
+    segment_s *zero;
+    rd_sector_t i;
+
+    if (seg >> 16) {
+	zero = seg_alloc(RD_SECTOR_SIZE / PARA, SEG_FLAG_RAMDSK);
+	if (!zero)
+	    return -ENOMEM;
+	fmemsetw(0, zero->base, 0, RD_SECTOR_SIZE/2);
+	for (i = 0; i < sectors; i++)
+	    xms_fmemcpyw((char *)(i * RD_SECTOR_SIZE), seg, 0, zero->base, RD_SECTOR_SIZE/2);
+	seg_put(zero);
+	return 0;
+    }
+#endif
+    fmemsetw(0, (seg_t)seg, 0, sectors * (RD_SECTOR_SIZE/2));
+    return 0;
+}
+
+#ifdef CONFIG_FS_XMS_BUFFER
+/* get a cleared 64k XMS segment, returns 0 if XMS not available*/
+static ramdesc_t xms_seg(void)
+{
+    ramdesc_t seg;
+
+    if (nr_xms_free)
+	seg = xms_free[--nr_xms_free];
+    else seg = xms_alloc((long_t)ALLOC_SIZE * PARA);
+    if (seg && clear_seg(seg, SEG_SECTORS) < 0) {
+	xms_free[nr_xms_free++] = seg;
+	return 0;
+    }
+    return seg;
+}
+#endif
+
+/* grow ramdisk to size K, allocating main memory or XMS segments*/
+static int rd_grow(int target, unsigned int size)
+{
+    unsigned long want = (unsigned long)size << 1;	/* sectors*/
+    rd_sector_t n;
+    int j, k = -1, last = -1;
+    segment_s *sp;
+
+    if (want <= drive_info[target].size || want > 0xFFFFL)
+	return -EINVAL;
+
+    if (drive_info[target].size) {	/* find end of chain*/
+	for (k = drive_info[target].start; rd_segment[k].next != -1; k = rd_segment[k].next)
+	    ;
+	last = k;
+	/* XMS segments are always full size, so the last one can be extended in place*/
+	if (drive_info[target].xms && rd_segment[k].sectors < SEG_SECTORS) {
+	    n = SEG_SECTORS - rd_segment[k].sectors;
+	    if (n > want - drive_info[target].size)
+		n = want - drive_info[target].size;
+	    rd_segment[k].sectors += n;
+	    drive_info[target].size += n;
+	}
+    }
+#ifdef CONFIG_FS_XMS_BUFFER
+    else {
+	/* first segment determines if XMS available*/
+	j = find_free_seg();
+	if (j == -1)
+	    return -ENOMEM;
+	rd_segment[j].seg = xms_seg();
+	drive_info[target].xms = (rd_segment[j].seg != 0);
+	if (drive_info[target].xms) {
+	    n = want < SEG_SECTORS? want: SEG_SECTORS;
+	    rd_segment[j].sectors = n;
+	    rd_segment[j].next = -1;
+	    drive_info[target].start = j;
+	    drive_info[target].size = n;
+	    k = j;
+	}
+    }
+#endif
+
+    while (drive_info[target].size < want) {
+	j = find_free_seg();	/* find free place in queue */
+	debug("RD: find_free_seg = %d\n", j);
+	if (j == -1)
+	    goto nomem;
+
+	n = (want - drive_info[target].size) < SEG_SECTORS?
+		want - drive_info[target].size: SEG_SECTORS;
+#ifdef CONFIG_FS_XMS_BUFFER
+	if (drive_info[target].xms) {
+	    if (!(rd_segment[j].seg = xms_seg()))
+		goto nomem;
+	} else
+#endif
+	{
+	    sp = seg_alloc((segext_t)n * (RD_SECTOR_SIZE / PARA), SEG_FLAG_RAMDSK);
+	    if (!sp)
+		goto nomem;
+	    rd_segment[j].seg_desc = sp;
+	    rd_segment[j].seg = sp->base;
+	    clear_seg(rd_segment[j].seg, n);
+	}
+	rd_segment[j].sectors = n;
+	rd_segment[j].next = -1;
+	debug("RD: index %d set to %d sectors, seg 0x%lx\n",
+	       j, n, (unsigned long)rd_segment[j].seg);
+
+	if (k == -1)
+	    drive_info[target].start = j;
+	else rd_segment[k].next = j;		/* set link to next index */
+	k = j;
+	drive_info[target].size += n;
+    }
+    drive_info[target].valid = 1;
+    debug("RD: ramdisk %d sectors %d index %d bytes %ld\n",
+	target, drive_info[target].size, drive_info[target].start,
+	(long)drive_info[target].size * RD_SECTOR_SIZE);
+    return 0;
+
+nomem:
+    if (last == -1)
+	dealloc(target);
+    else {
+	/* keep existing data, drop newly added segments*/
+	free_segs(rd_segment[last].next);
+	rd_segment[last].next = -1;
+	drive_info[target].size = 0;
+	for (k = drive_info[target].start; k != -1; k = rd_segment[k].next)
+	    drive_info[target].size += rd_segment[k].sectors;
+    }
+    return -ENOMEM;
+}
+
 static int rd_ioctl(register struct inode *inode, struct file *file,
 		    unsigned int cmd, unsigned int arg)
 {
-    unsigned int i;
-    int j, k, target = DEVICE_NR(inode->i_rdev);
-    unsigned long size;
+    int target = DEVICE_NR(inode->i_rdev);
+    int err;
 
     if (!suser())
 	return -EPERM;
 
-    debug("RD: ioctl %d %s\n", target, (cmd ? "kill" : "make"));
+    debug("RD: ioctl %d %x\n", target, cmd);
     switch (cmd) {
     case RDCREATE:
 	if (drive_info[target].valid)
 	    return -EBUSY;
-
 	drive_info[target].size = 0;
-	k = -1;
-	for (i = 0; i <= (arg - 1) / ((ALLOC_SIZE / 1024) * PARA); i++) {
-		j = find_free_seg();	/* find free place in queue */
-		debug("RD: find_free_seg = %d\n", j);
-		if (j == -1) {
-		    dealloc(target);
-		    return -ENOMEM;
-		}
-		if (i == 0)
-		    drive_info[target].start = j;
-
-		if (i == (arg / ((ALLOC_SIZE / 1024) * PARA)))
-		    /* size in 16 byte pages = (arg % 64) * 64 */
-		    size = (arg % ((ALLOC_SIZE / 1024) * PARA)) *
-				  ((ALLOC_SIZE / 1024) * PARA);
-		else
-		    size = ALLOC_SIZE;
-
-		/* allocate memory */
-		rd_segment[j].seg_desc = seg_alloc ((segext_t)size, SEG_FLAG_RAMDSK);
-		if (rd_segment[j].seg_desc == 0) {
-		    dealloc(target);
-		    return -ENOMEM;
-		}
-		rd_segment[j].seg = rd_segment[j].seg_desc->base;
-		debug("RD: pass: %d, allocated %d pages, rd_segment[%d].seg = 0x%x\n",
-		       i, (int) size, j, rd_segment[j].seg);
-
-		/* recalculate size to reflect size in sectors, not pages */
-		size = size / (RD_SECTOR_SIZE / PARA);
-		rd_segment[j].sectors = size;
-		drive_info[target].size += rd_segment[j].sectors;
-		size = (long) rd_segment[j].sectors * RD_SECTOR_SIZE;
-		debug("RD: index %d set to %d sectors, %ld bytes\n",
-		       j, rd_segment[j].sectors, size);
-
-		debug("RD: fmemsetw(0, 0x%x, 0, 0x%x)\n",
-			rd_segment[j].seg, (size_t) (size >> 1));
-		fmemsetw(0, rd_segment[j].seg, 0, (size_t) (size >> 1));
-
-		if (k != -1)
-		    rd_segment[k].next = j;	/* set link to next index */
-		k = j;
-	}
-	drive_info[target].valid = 1;
-	debug("RD: ramdisk %d created sectors %d index %d bytes %ld\n",
-		target, drive_info[target].size, drive_info[target].start,
-		(long)drive_info[target].size * RD_SECTOR_SIZE);
-	return 0;
+	return rd_grow(target, arg);
+
+    case RDRESIZE:		/* grow only, filesystem must be resized separately*/
+	if (!drive_info[target].valid)
+	    return -ENXIO;
+	err = rd_grow(target, arg);
+	if (!err)
+	    inode->i_size = (long)drive_info[target].size << 9;
+	return err;
 
     case RDDESTROY:
 	if (drive_info[target].valid) {
@@ -222,7 +332,7 @@ static void do_rd_request(void)
     rd_sector_t offset;		/* sector offset in memory segment*/
     int index;
     int target;
-    int count;
+    int count, n;
     byte_t *buf;
 
     while (1) {
@@ -249,28 +359,33 @@ static void do_rd_request(void)
 	    continue;
 	}
 
-        for (count = 0; count < req->rq_nr_sectors; count++) {
+        for (count = 0; count < req->rq_nr_sectors; count += n) {
             /* find appropriate memory segment and sector offset*/
             offset = start;
             index = drive_info[target].start;
             debug("index %d, ", index);
-            while (offset > rd_segment[index].sectors) {
+            while (offset >= rd_segment[index].sectors) {
                 offset -= rd_segment[index].sectors;
                 index = rd_segment[index].next;
             }
-            debug("entry %d, seg %x, offset %d\n", index, rd_segment[index].seg, offset);
+            debug("entry %d, seg %lx, offset %d\n", index,
+                (unsigned long)rd_segment[index].seg, offset);
 
+            /* copy all sectors within this segment at once*/
+            n = req->rq_nr_sectors - count;
+            if (n > rd_segment[index].sectors - offset)
+                n = rd_segment[index].sectors - offset;
             if (req->rq_cmd == WRITE) {
                 xms_fmemcpyw((char *) (offset * RD_SECTOR_SIZE), rd_segment[index].seg,
-                    buf, req->rq_seg, RD_SECTOR_SIZE/2);
+                    buf, req->rq_seg, n * (RD_SECTOR_SIZE/2));
             } else {
                 xms_fmemcpyw(buf, req->rq_seg, (byte_t *) (offset * RD_SECTOR_SIZE),
-                    rd_segment[index].seg, RD_SECTOR_SIZE/2);
+                    rd_segment[index].seg, n * (RD_SECTOR_SIZE/2));
             }
-            start++;
-            buf += RD_SECTOR_SIZE;;
+            start += n;
+            buf += n * RD_SECTOR_SIZE;
         }
-        end_request(1);
+        end_request(count == req->rq_nr_sectors);
     }
 }
 
@@ -293,12 +408,12 @@ void INITPROC rd_init(void)
 
 #if CONFIG_RAMDISK_SEGMENT
 	printk("rd: %dK ramdisk at %x:0000\n",
-	    drive_info[0].size >> 1, rd_segment[0].seg);
+	    drive_info[0].size >> 1, (seg_t)rd_segment[0].seg);
 
 #if (CONFIG_RAMDISK_SECTORS > 128)
 	/* build segment array for preloaded ramdisks > 64k*/
 	int i = 0;
-	seg_t seg = rd_segment[0].seg;
+	seg_t seg = (seg_t)rd_segment[0].seg;
 	rd_sector_t sectors = rd_segment[0].sectors;
 	while (sectors > 128 && i < MAX_SEGMENTS-1) {
 	    rd_segment[i].sectors = 128;	/* 64k*/
@@ -311,8 +426,8 @@ void INITPROC rd_init(void)
 #endif
 #if DEBUG
 	for (int i=0; i < MAX_SEGMENTS; i++)
-		printk("%d: seg %x next %d sectors %d\n",
-			i, rd_segment[i].seg, rd_segment[i].next, rd_segment[i].sectors);
+		printk("%d: seg %lx next %d sectors %d\n",
+			i, (unsigned long)rd_segment[i].seg, rd_segment[i].next, rd_segment[i].sectors);
 #endif
 #endif /* CONFIG_RAMDISK_SEGMENT*/
     } else
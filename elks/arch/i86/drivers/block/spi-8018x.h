@@ -40,3 +40,19 @@ uint8_t spi_receive(void);
  * bytes: count of bytes to send.
  */
 void spi_send_ffs(uint16_t bytes);
+
+/**
+ * Receive a block of bytes while sending all ones.
+ *
+ * buf, seg: far destination buffer.
+ * count: count of bytes to receive.
+ */
+void spi_receive_block(char *buf, seg_t seg, uint16_t count);
+
+/**
+ * Transmit a block of bytes. Discards the slave's output data.
+ *
+ * buf, seg: far source buffer.
+ * count: count of bytes to send.
+ */
+void spi_transmit_block(char *buf, seg_t seg, uint16_t count);
@@ -42,14 +42,22 @@ enum SdCommandIndices {
     CMD_GO_IDLE = 0,            /* GO_IDLE_STATE */
     CMD_SEND_IF_COND = 8,       /* SEND_IF_COND */
     CMD_SEND_CSD = 9,           /* SEND_CSD */
+    CMD_STOP_TRANSMISSION = 12, /* STOP_TRANSMISSION */
     CMD_SET_BLOCKLEN = 16,      /* SET_BLOCKLEN */
     CMD_READ_SINGLE_BLOCK = 17, /* READ_SINGLE_BLOCK */
+    CMD_READ_MULTIPLE_BLOCK = 18, /* READ_MULTIPLE_BLOCK */
     CMD_WRITE_BLOCK = 24,       /* WRITE_BLOCK */
+    CMD_WRITE_MULTIPLE_BLOCK = 25, /* WRITE_MULTIPLE_BLOCK */
     CMD_APP_CMD = 55,           /* APP_CMD */
     CMD_READ_OCR = 58,          /* READ_OCR */
     ACMD_SEND_OP_COND = 41,     /* SEND_OP_COND */
 };
 
+/* data tokens */
+#define TOKEN_START_BLOCK       0xfe    /* single and multiple block read, single write */
+#define TOKEN_START_MULTI_WRITE 0xfc    /* each block of WRITE_MULTIPLE_BLOCK */
+#define TOKEN_STOP_TRAN         0xfd    /* end of WRITE_MULTIPLE_BLOCK */
+
 enum SdTypes {
     Unknown = 0,
     SDv1 = 1,
@@ -456,101 +464,154 @@ fail:
 }
 
 /**
- * Reads an entire sector off the SD card.
- * 
- * *buffer: __far pointer of the buffer to be written with the
- * SD card's contents. Must be 512 bytes long.
- * sector: sector number.
- * 
+ * Sends STOP_TRANSMISSION to end a READ_MULTIPLE_BLOCK, leaving the card selected.
+ * The byte following the command is a stuff byte and must be skipped
+ * before the response.
+ *
  * returns: 0 on success, negative value on failure.
  */
-static int sd_read(char *buf, ramdesc_t seg, sector_t sector) {
-    /* init far pointer to segment:offset. FIXME won't work with XMS buffers*/
-    unsigned char __far *buffer = _MK_FP((seg_t)seg, (unsigned)buf);
+static int sd_stop_transmission(void) {
+    uint8_t ret;
+    uint8_t i;
+
+    spi_transmit(CMD_STOP_TRANSMISSION + 0x40);
+    spi_transmit(0);
+    spi_transmit(0);
+    spi_transmit(0);
+    spi_transmit(0);
+    spi_transmit(0xff);
+
+    /* skip stuff byte, then wait for R1 */
+    spi_receive();
+    for (i = 0; ((ret = spi_receive()) & 0x80) && (i < 0x10); i++);
+    if (ret & 0x80)
+        return -EIO;
+
+    /* card may hold busy low after stopping */
+    return sd_wait_ready(10000);
+}
+
+/**
+ * Reads one or more sectors off the SD card.
+ * A single sector uses READ_SINGLE_BLOCK, otherwise READ_MULTIPLE_BLOCK
+ * is used so the command and access latency is paid once per request.
+ *
+ * buf, seg: buffer to be written with the SD card's contents.
+ * Must be count * 512 bytes long.
+ * sector: starting sector number.
+ * count: number of sectors.
+ *
+ * returns: # sectors read, or negative value on failure.
+ */
+static int sd_read(char *buf, ramdesc_t seg, sector_t sector, unsigned int count) {
     int ret;
-    uint16_t count = SD_FIXED_SECTOR_SIZE;
+    unsigned int n = 0;
+    uint8_t cmd = (count == 1)? CMD_READ_SINGLE_BLOCK: CMD_READ_MULTIPLE_BLOCK;
 
     if (_sd_type != SDHC) {
         /* SDv1 and SDv2 use address instead of sectors */
         sector *= SD_FIXED_SECTOR_SIZE;
     }
 
-    /* READ_SINGLE_BLOCK */
-    if (sd_send_cmd(CMD_READ_SINGLE_BLOCK, sector) != 0) {
+    if (sd_send_cmd(cmd, sector) != 0) {
         ret = -EIO;
         goto fail;
     }
 
-    ret = sd_wait_for_token(0xfe);
-    if (ret < 0) {
-        goto fail;
-    }
-
     do {
-        *buffer++ = spi_receive();
-    } while (--count);
+        ret = sd_wait_for_token(TOKEN_START_BLOCK);
+        if (ret < 0)
+            break;
 
-    /* Skip trailing CRC */
-    spi_send_ffs(2);
+        /* FIXME won't work with XMS buffers */
+        spi_receive_block(buf, (seg_t)seg, SD_FIXED_SECTOR_SIZE);
+
+        /* Skip trailing CRC */
+        spi_send_ffs(2);
+        buf += SD_FIXED_SECTOR_SIZE;
+    } while (++n < count);
+
+    if (cmd == CMD_READ_MULTIPLE_BLOCK && sd_stop_transmission() < 0)
+        ret = -EIO;
 
 fail:
     sd_release_spi();
 
-    return ret;
+    return (ret < 0 && n == 0)? ret: n;
 }
 
 /**
- * Writes an entire sector off the SD card.
- * 
- * *buffer: __far pointer of the buffer containing data to be
- * written on the SD card. Must be 512 bytes long.
- * sector: sector number.
- * 
- * returns: 0 on success, negative value on failure.
+ * Writes one or more sectors to the SD card.
+ * A single sector uses WRITE_BLOCK, otherwise WRITE_MULTIPLE_BLOCK
+ * terminated by a stop transmission token.
+ *
+ * buf, seg: buffer containing data to be written on the SD card.
+ * Must be count * 512 bytes long.
+ * sector: starting sector number.
+ * count: number of sectors.
+ *
+ * returns: # sectors written, or negative value on failure.
  */
-static int sd_write(char *buf, ramdesc_t seg, sector_t sector) {
-    /* init far pointer to segment:offset. FIXME won't work with XMS buffers*/
-    unsigned char __far *buffer = _MK_FP((seg_t)seg, (unsigned)buf);
+static int sd_write(char *buf, ramdesc_t seg, sector_t sector, unsigned int count) {
     int ret;
-    uint16_t count = SD_FIXED_SECTOR_SIZE;
+    unsigned int n = 0;
+    uint8_t cmd, token;
+
+    if (count == 1) {
+        cmd = CMD_WRITE_BLOCK;
+        token = TOKEN_START_BLOCK;
+    } else {
+        cmd = CMD_WRITE_MULTIPLE_BLOCK;
+        token = TOKEN_START_MULTI_WRITE;
+    }
 
     if (_sd_type != SDHC) {
         /* SDv1 and SDv2 use address instead of sectors */
         sector *= SD_FIXED_SECTOR_SIZE;
     }
 
-    /* WRITE_SINGLE_BLOCK */
-    if (sd_send_cmd(CMD_WRITE_BLOCK, sector) != 0) {
+    if (sd_send_cmd(cmd, sector) != 0) {
         ret = -EIO;
         goto fail;
     }
 
-    /* Send data block header */
-    spi_transmit(0xff);
-    spi_transmit(0xfe);
-
-    /* Send the entire sector data */
     do {
-        spi_transmit(*buffer++);
-    } while (--count);
+        /* Send data block header */
+        spi_transmit(0xff);
+        spi_transmit(token);
 
-    /* Send a dummy CRC */
-    spi_transmit(0);
-    spi_transmit(0);
+        /* Send the entire sector data. FIXME won't work with XMS buffers */
+        spi_transmit_block(buf, (seg_t)seg, SD_FIXED_SECTOR_SIZE);
 
-    /* Check data response */
-    if ((spi_receive() & 0x1F) != 0x05) {
-        ret = -EIO;
-        goto fail;
-    }
+        /* Send a dummy CRC */
+        spi_transmit(0);
+        spi_transmit(0);
 
-    /* wait for the SD card to be ready */
-    ret = sd_wait_ready(10000);
+        /* Check data response */
+        if ((spi_receive() & 0x1F) != 0x05) {
+            ret = -EIO;
+            break;
+        }
+
+        /* wait for the SD card to be ready */
+        ret = sd_wait_ready(10000);
+        if (ret < 0)
+            break;
+        buf += SD_FIXED_SECTOR_SIZE;
+    } while (++n < count);
+
+    if (cmd == CMD_WRITE_MULTIPLE_BLOCK) {
+        /* blocks accepted before an error are still programmed */
+        spi_transmit(TOKEN_STOP_TRAN);
+        spi_receive();
+        if (sd_wait_ready(10000) < 0)
+            ret = -ETIMEDOUT;
+    }
 
 fail:
     sd_release_spi();
 
-    return ret;
+    return (ret < 0 && n == 0)? ret: n;
 }
 
 /**
@@ -591,31 +652,31 @@ int ssddev_ioctl(struct inode *inode, struct file *file,
 }
 
 /**
- * SSD API: Writes one sector to the SD card.
+ * SSD API: Writes count sectors to the SD card.
  * 
  * returns: # sectors written.
  */
-int ssddev_write(sector_t start, char *buf, ramdesc_t seg)
+int ssddev_write(sector_t start, char *buf, ramdesc_t seg, unsigned int count)
 {
     int ret;
 
-    ret = sd_write(buf, seg, start);
-    if (ret != 0)       /* error, no sectors were written */
+    ret = sd_write(buf, seg, start, count);
+    if (ret < 0)        /* error, no sectors were written */
         return 0;
-    return 1;
+    return ret;
 }
 
 /**
- * SSD API: Reads one sector from the SD card.
+ * SSD API: Reads count sectors from the SD card.
  * 
  * returns: # sectors read.
  */
-int ssddev_read(sector_t start, char *buf, ramdesc_t seg)
+int ssddev_read(sector_t start, char *buf, ramdesc_t seg, unsigned int count)
 {
     int ret;
 
-    ret = sd_read(buf, seg, start);
-    if (ret != 0)       /* error, no sectors were read */
+    ret = sd_read(buf, seg, start, count);
+    if (ret < 0)        /* error, no sectors were read */
         return 0;
-    return 1;
+    return ret;
 }
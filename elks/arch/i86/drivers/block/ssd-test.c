@@ -76,22 +76,22 @@ int ssddev_ioctl(struct inode *inode, struct file *file,
     return -EINVAL;
 }
 
-/* write one sector to SSD */
-int ssddev_write(sector_t start, char *buf, ramdesc_t seg)
+/* write count sectors to SSD */
+int ssddev_write(sector_t start, char *buf, ramdesc_t seg, unsigned int count)
 {
     unsigned long offset = start << 9;
 
     xms_fmemcpyw(0, ssd_seg->base + (unsigned int)(offset >> 4), buf, seg,
-        SD_FIXED_SECTOR_SIZE/2);
-    return 1;   /* # sectors written */
+        count * (SD_FIXED_SECTOR_SIZE/2));
+    return count;   /* # sectors written */
 }
 
-/* read one sector from SSD */
-int ssddev_read(sector_t start, char *buf, ramdesc_t seg)
+/* read count sectors from SSD */
+int ssddev_read(sector_t start, char *buf, ramdesc_t seg, unsigned int count)
 {
     unsigned long offset = start << 9;
 
     xms_fmemcpyw(buf, seg, 0, ssd_seg->base + (unsigned int)(offset >> 4),
-        SD_FIXED_SECTOR_SIZE/2);
-    return 1;   /* # sectors read */
+        count * (SD_FIXED_SECTOR_SIZE/2));
+    return count;   /* # sectors read */
 }
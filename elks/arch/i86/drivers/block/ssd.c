@@ -10,6 +10,9 @@
 #include <linuxmt/kernel.h>
 #include <linuxmt/errno.h>
 #include <linuxmt/debug.h>
+#include <linuxmt/ioctl.h>
+#include <linuxmt/mm.h>
+#include <linuxmt/sched.h>
 
 #define MAJOR_NR    SSD_MAJOR
 #include "blk.h"
@@ -21,10 +24,13 @@ jiff_t ssd_timeout;
 
 static sector_t NUM_SECTS = 0;  /* max # sectors on SSD device */
 static int access_count;
+static char ssd_benching;       /* request queue held off by ssd_bench */
 char ssd_initialized;
 
 static int ssd_open(struct inode *, struct file *);
 static void ssd_release(struct inode *, struct file *);
+static void do_ssd_request(void);
+static int ssd_ioctl(struct inode *, struct file *, unsigned int, unsigned int);
 
 static struct file_operations ssd_fops = {
     NULL,                       /* lseek */
@@ -32,7 +38,7 @@ static struct file_operations ssd_fops = {
     block_write,                /* write */
     NULL,                       /* readdir */
     NULL,                       /* select */
-    ssddev_ioctl,               /* ioctl */
+    ssd_ioctl,                  /* ioctl */
     ssd_open,                   /* open */
     ssd_release                 /* release */
 };
@@ -70,6 +76,67 @@ static void ssd_release(struct inode *inode, struct file *filp)
     }
 }
 
+/* read sectors using per_cmd sectors per device command, return elapsed jiffies */
+static int ssd_bench(struct ssd_bench *b)
+{
+    segment_s *seg;
+    sector_t start = b->start;
+    unsigned int left = b->sectors;
+    unsigned int n;
+    jiff_t begin;
+    int err = 0;
+
+    if (b->per_cmd == 0 || b->per_cmd > SSD_BENCH_MAX)
+        return -EINVAL;
+    if (start + left > NUM_SECTS)
+        return -EINVAL;
+    seg = seg_alloc(b->per_cmd * (SD_FIXED_SECTOR_SIZE >> 4), SEG_FLAG_EXTBUF);
+    if (!seg)
+        return -ENOMEM;
+
+    /* device commands can't be shared with async ssd_io_complete, wait for idle */
+    while (CURRENT || ssd_timeout || ssd_benching)
+        schedule();
+    ssd_benching = 1;
+
+    begin = jiffies;
+    while (left) {
+        n = left < b->per_cmd? left: b->per_cmd;
+        if (ssddev_read(start, 0, (ramdesc_t)seg->base, n) != n) {
+            err = -EIO;
+            break;
+        }
+        start += n;
+        left -= n;
+    }
+    b->ticks = jiffies - begin;
+    ssd_benching = 0;
+    if (CURRENT)                /* restart requests queued meanwhile */
+        do_ssd_request();
+    seg_put(seg);
+    return err;
+}
+
+static int ssd_ioctl(struct inode *inode, struct file *file,
+            unsigned int cmd, unsigned int arg)
+{
+    struct ssd_bench bench;
+    int err;
+
+    if (cmd == IOCTL_SSD_BENCH) {
+        if (!NUM_SECTS || !ssd_initialized)
+            return -ENODATA;
+        err = verified_memcpy_fromfs(&bench, (void *)arg, sizeof(bench));
+        if (err)
+            return err;
+        err = ssd_bench(&bench);
+        if (err)
+            return err;
+        return verified_memcpy_tofs((void *)arg, &bench, sizeof(bench));
+    }
+    return ssddev_ioctl(inode, file, cmd, arg);
+}
+
 /* called by timer interrupt if async operation */
 void ssd_io_complete(void)
 {
@@ -105,18 +172,19 @@ void ssd_io_complete(void)
             end_request(0);
             continue;
         }
-        for (count = 0; count < req->rq_nr_sectors; count++) {
+        /* subdriver may transfer fewer sectors per call than requested */
+        for (count = 0; count < req->rq_nr_sectors; count += ret) {
             if (req->rq_cmd == WRITE) {
                 debug_blk("SSD: writing sector %lu\n", start);
-                ret = ssddev_write(start, buf, req->rq_seg);
+                ret = ssddev_write(start, buf, req->rq_seg, req->rq_nr_sectors - count);
             } else {
                 debug_blk("SSD: reading sector %lu\n", start);
-                ret = ssddev_read(start, buf, req->rq_seg);
+                ret = ssddev_read(start, buf, req->rq_seg, req->rq_nr_sectors - count);
             }
-            if (ret != 1)           /* I/O error */
+            if (ret <= 0)           /* I/O error */
                 break;
-            start++;
-            buf += SD_FIXED_SECTOR_SIZE;
+            start += ret;
+            buf += ret * SD_FIXED_SECTOR_SIZE;
         }
         end_request(count == req->rq_nr_sectors);
 #ifdef CONFIG_ASYNCIO
@@ -144,6 +212,8 @@ static void do_ssd_request(void)
             end_request(0);
             return;
         }
+        if (ssd_benching)                   /* restarted by ssd_bench */
+            return;
 #ifdef CONFIG_ASYNCIO
         ssd_timeout = jiffies + IODELAY;    /* schedule completion callback */
         return;
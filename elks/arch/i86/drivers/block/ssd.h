@@ -7,8 +7,9 @@
 sector_t ssddev_init(void);
 int ssddev_ioctl(struct inode *inode, struct file *file,
             unsigned int cmd, unsigned int arg);
-int ssddev_write(sector_t start, char *buf, ramdesc_t seg);
-int ssddev_read(sector_t start, char *buf, ramdesc_t seg);
+/* transfer up to count sectors, returning # sectors done */
+int ssddev_write(sector_t start, char *buf, ramdesc_t seg, unsigned int count);
+int ssddev_read(sector_t start, char *buf, ramdesc_t seg, unsigned int count);
 
 extern char ssd_initialized;
 
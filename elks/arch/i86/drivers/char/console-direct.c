@@ -18,6 +18,7 @@
 #include <linuxmt/chqueue.h>
 #include <linuxmt/ntty.h>
 #include <linuxmt/kd.h>
+#include <linuxmt/memory.h>
 #include <arch/io.h>
 #include "console.h"
 
@@ -40,6 +41,9 @@
 #define BEL             '\x07'
 
 #define MAXPARMS        28
+#define MAXRUN          80      /* max printable chars written per block copy */
+#define SCROLLBACK_XMS  400     /* scrollback lines per console in XMS */
+#define SCROLLBACK_MEM  48      /* scrollback lines per console in main memory */
 
 struct console;
 typedef struct console Console;
@@ -56,6 +60,18 @@ struct console {
     unsigned char *parmptr;     /* ptr to params */
     unsigned char params[MAXPARMS];     /* ANSI params */
 #endif
+#ifdef CONFIG_CONSOLE_SHADOW
+    seg_t sseg;                 /* off-screen shadow buffer, 0 if none */
+    int top;                    /* shadow line of screen row 0, scrolled as ring */
+    int dirtymin, dirtymax;     /* rows changed since last flush */
+#endif
+#ifdef CONFIG_CONSOLE_SCROLLBACK
+    ramdesc_t sbuf;             /* scrollback line ring in XMS or far memory */
+    int sblines;                /* ring size in lines, 0 if none */
+    int sbhead;                 /* next ring line to write */
+    int sbcount;                /* lines saved */
+    int sbview;                 /* lines scrolled back on display, 0 if live */
+#endif
 };
 
 static struct wait_queue glock_wait;
@@ -65,6 +81,9 @@ static unsigned short CCBase;   /* 6845 CRTC base I/O address */
 static int Width, MaxCol, Height, MaxRow;
 static int NumConsoles = MAX_CONSOLES;
 static unsigned char isMDA, isCGA;
+#ifdef CONFIG_CONSOLE_SCROLLBACK
+static Console *sbpending;      /* console with scrollback view to redraw */
+#endif
 
 int Current_VCminor = 0;
 int kraw = 0;
@@ -109,24 +128,83 @@ static void DisplayCursor(int onoff)
     outb(v, CCBase + 1);
 }
 
+#ifdef CONFIG_CONSOLE_SHADOW
+/*
+ * With a shadow buffer all drawing is done in main memory, and rows are a
+ * ring so a scroll is a single line clear. Changed rows are copied to video
+ * memory once per write by FlushShadow, coalescing any number of scrolls.
+ */
+#define DrawSeg(C)      ((C)->sseg? (C)->sseg: (seg_t)(C)->vseg)
+
+static unsigned int RowOffset(register Console * C, int y)
+{
+    if (C->sseg) {
+        y += C->top;
+        if (y >= Height)
+            y -= Height;
+    }
+    return y * (Width << 1);
+}
+
+static void MarkDirty(register Console * C, int y, int y2)
+{
+    if (y < C->dirtymin)
+        C->dirtymin = y;
+    if (y2 > C->dirtymax)
+        C->dirtymax = y2;
+}
+
+static void FlushShadow(register Console * C)
+{
+    int y, n, ry, first;
+
+    if (!C->sseg)
+        return;
+#ifdef CONFIG_CONSOLE_SCROLLBACK
+    if (C->sbview) {                    /* new output returns to live screen */
+        C->sbview = 0;
+        MarkDirty(C, 0, MaxRow);
+    }
+#endif
+    if (C->dirtymin > C->dirtymax)
+        return;
+    y = C->dirtymin;
+    n = C->dirtymax - y + 1;
+    ry = y + C->top;
+    if (ry >= Height)
+        ry -= Height;
+    first = Height - ry;                /* rows before shadow ring wraps */
+    if (first > n)
+        first = n;
+    fmemcpyw((void *)(y * (Width << 1)), C->vseg,
+             (void *)(ry * (Width << 1)), C->sseg, first * Width);
+    if (n > first)
+        fmemcpyw((void *)((y + first) * (Width << 1)), C->vseg,
+                 0, C->sseg, (n - first) * Width);
+    C->dirtymin = Height;
+    C->dirtymax = -1;
+}
+#else
+#define DrawSeg(C)              ((seg_t)(C)->vseg)
+#define RowOffset(C,y)          ((y) * (Width << 1))
+#define MarkDirty(C,y,y2)
+#define FlushShadow(C)
+#endif
+
 static void VideoWrite(register Console * C, int c)
 {
-    pokew((C->cx + C->cy * Width) << 1, (seg_t) C->vseg,
+    pokew(RowOffset(C, C->cy) + (C->cx << 1), DrawSeg(C),
           (C->attr << 8) | (c & 255));
+    MarkDirty(C, C->cy, C->cy);
 }
 
 static void ClearRange(register Console * C, int x, int y, int x2, int y2)
 {
-    register int vp;
-
+    MarkDirty(C, y, y2);
     x2 = x2 - x + 1;
-    vp = (x + y * Width) << 1;
     do {
-        for (x = 0; x < x2; x++) {
-            pokew(vp, (seg_t) C->vseg, (C->attr << 8) | ' ');
-            vp += 2;
-        }
-        vp += (Width - x2) << 1;
+        fmemsetw((void *)(RowOffset(C, y) + (x << 1)), DrawSeg(C),
+                 (C->attr << 8) | ' ', x2);
     } while (++y <= y2);
 }
 
@@ -134,6 +212,33 @@ static void ScrollUp(register Console * C, int y)
 {
     register int vp;
 
+#ifdef CONFIG_CONSOLE_SHADOW
+    if (C->sseg && y == 0) {
+#ifdef CONFIG_CONSOLE_SCROLLBACK
+        if (C->sblines) {               /* save departing line */
+            xms_fmemcpyw((void *)(C->sbhead * (Width << 1)), C->sbuf,
+                         (void *)RowOffset(C, 0), C->sseg, Width);
+            if (++C->sbhead >= C->sblines)
+                C->sbhead = 0;
+            if (C->sbcount < C->sblines)
+                C->sbcount++;
+        }
+#endif
+        if (++C->top >= Height)         /* rotate ring, redraw whole screen */
+            C->top = 0;
+        MarkDirty(C, 0, MaxRow);
+        ClearRange(C, 0, MaxRow, MaxCol, MaxRow);
+        return;
+    }
+    if (C->sseg) {
+        MarkDirty(C, y, MaxRow);
+        for (; y < MaxRow; y++)
+            fmemcpyw((void *)RowOffset(C, y), C->sseg,
+                     (void *)RowOffset(C, y + 1), C->sseg, Width);
+        ClearRange(C, 0, MaxRow, MaxCol, MaxRow);
+        return;
+    }
+#endif
     vp = y * (Width << 1);
     if ((unsigned int)y < MaxRow)
         fmemcpyw((void *)vp, C->vseg,
@@ -144,18 +249,132 @@ static void ScrollUp(register Console * C, int y)
 #ifdef CONFIG_EMUL_ANSI
 static void ScrollDown(register Console * C, int y)
 {
-    register int vp;
     int yy = MaxRow;
 
-    vp = yy * (Width << 1);
-    while (--yy >= y) {
-        fmemcpyw((void *)vp, C->vseg, (void *)(vp - (Width << 1)), C->vseg, Width);
-        vp -= Width << 1;
-    }
+    MarkDirty(C, y, MaxRow);
+    while (--yy >= y)
+        fmemcpyw((void *)RowOffset(C, yy + 1), DrawSeg(C),
+                 (void *)RowOffset(C, yy), DrawSeg(C), Width);
     ClearRange(C, 0, y, MaxCol, y);
 }
 #endif
 
+#ifdef CONFIG_CONSOLE_SCROLLBACK
+/* allocate scrollback ring on first open, from XMS if enabled else main memory */
+static void ScrollbackInit(register Console * C)
+{
+    segment_s *seg;
+
+    if (C->sblines || !C->sseg)
+        return;
+#ifdef CONFIG_FS_XMS_BUFFER
+    if ((C->sbuf = xms_alloc((long_t)SCROLLBACK_XMS * (Width << 1))) != 0)
+        C->sblines = SCROLLBACK_XMS;
+    else
+#endif
+    if ((seg = seg_alloc((SCROLLBACK_MEM * (Width << 1) + 15) >> 4, SEG_FLAG_VIDEO))) {
+        C->sbuf = seg->base;
+        C->sblines = SCROLLBACK_MEM;
+    }
+    C->sbhead = C->sbcount = C->sbview = 0;
+}
+
+/* display screen scrolled back sbview lines, never at interrupt time */
+static void ShowScrollback(register Console * C)
+{
+    int y, line;
+
+    for (y = 0; y < Height; y++) {
+        line = y - C->sbview;
+        if (line < 0) {
+            line += C->sbhead;
+            if (line < 0)
+                line += C->sblines;
+            xms_fmemcpyw((void *)(y * (Width << 1)), C->vseg,
+                         (void *)(line * (Width << 1)), C->sbuf, Width);
+        } else
+            fmemcpyw((void *)(y * (Width << 1)), C->vseg,
+                     (void *)RowOffset(C, line), C->sseg, Width);
+    }
+}
+
+/*
+ * Shift-PgUp/PgDn from keyboard interrupt, move visible console by half a
+ * screen. Only the new view is recorded here, as the ring may be in XMS
+ * which can't be copied at interrupt time. Console_idle draws it.
+ */
+void Console_scrollback(int up)
+{
+    register Console *C = Visible;
+    int view;
+
+    if (!C->sblines || glock)
+        return;
+    view = C->sbview + (up? Height / 2: -(Height / 2));
+    if (view > C->sbcount)
+        view = C->sbcount;
+    if (view < 0)
+        view = 0;
+    if (view == C->sbview)
+        return;
+    C->sbview = view;
+    sbpending = C;
+}
+
+/* draw scrollback view requested by keyboard, called by idle task */
+void Console_idle(void)
+{
+    register Console *C = sbpending;
+
+    if (C) {
+        sbpending = 0;
+        if (C == Visible && !glock)
+            ShowScrollback(C);
+    }
+}
+#endif
+
+/*
+ * Write a run of printable characters from the output queue with a single
+ * block copy, stopping at end of line or any control character. Printable
+ * characters are never changed by tty_outproc, so they are taken directly.
+ */
+#define CONSOLE_WRITERUN
+static int WriteRun(register Console * C, struct ch_queue *q)
+{
+    static unsigned short runbuf[MAXRUN];
+    unsigned int attr = C->attr << 8;
+    int tail = q->tail;
+    int max = Width - C->cx;
+    int n = 0;
+    unsigned char c;
+
+    if (C->XN)                          /* delayed newline handled by std_char */
+        return 0;
+    if (max > MAXRUN)
+        max = MAXRUN;
+    while (n < max && n < q->len) {
+        if ((c = q->base[tail]) < ' ')
+            break;
+        runbuf[n++] = attr | c;
+        if (++tail >= q->size)
+            tail = 0;
+    }
+    if (n) {
+        fmemcpyw((void *)(RowOffset(C, C->cy) + (C->cx << 1)), DrawSeg(C),
+                 runbuf, kernel_ds, n);
+        MarkDirty(C, C->cy, C->cy);
+        q->tail = tail;
+        q->len -= n;
+        C->cx += n;
+        if (C->cx > MaxCol) {
+            C->XN = 1;
+            C->cx = MaxCol;
+        }
+    }
+    return n;
+}
+
 /* shared console routines*/
 #include "console.c"
 
@@ -167,8 +386,14 @@ void Console_set_vc(int N)
 {
     if ((N >= NumConsoles) || (Visible == &Con[N]) || glock)
         return;
+#ifdef CONFIG_CONSOLE_SCROLLBACK
+    if (Visible->sbview)                /* restore live screen from shadow */
+        FlushShadow(Visible);
+    sbpending = 0;
+#endif
     Visible = &Con[N];
 
+    FlushShadow(Visible);
     SetDisplayPage(Visible);
     PositionCursor(Visible);
     Current_VCminor = N;
@@ -223,6 +448,20 @@ void INITPROC console_init(void)
         C->savex = C->savey = 0;
 #endif
 
+#ifdef CONFIG_CONSOLE_SHADOW
+        /* shadow starts as copy of screen to keep early printk output */
+        {
+            segment_s *seg = seg_alloc((Width * Height * 2 + 15) >> 4, SEG_FLAG_VIDEO);
+            if (seg) {
+                C->sseg = seg->base;
+                fmemcpyw(0, C->sseg, 0, C->vseg, Width * Height);
+            }
+            C->top = 0;
+            C->dirtymin = Height;
+            C->dirtymax = -1;
+        }
+#endif
+
         /* Do not erase early printk() */
         /* ClearRange(C, 0, C->cy, MaxCol, MaxRow); */
 
@@ -18,6 +18,9 @@ void Console_conout(dev_t dev, int Ch)
     if (Ch == '\n')
         WriteChar(C, '\r');
     WriteChar(C, Ch);
+#ifdef CONSOLE_WRITERUN
+    FlushShadow(C);
+#endif
     PositionCursor(C);
 }
 
@@ -363,11 +366,24 @@ static int Console_write(register struct tty *tty)
 {
     register Console *C = &Con[tty->minor];
     int cnt = 0;
+#ifdef CONSOLE_WRITERUN
+    int n;
+#endif
 
     while ((tty->outq.len > 0) && !glock) {
+#ifdef CONSOLE_WRITERUN
+        /* fast path for runs of printable chars, no escape sequence in progress */
+        if (C->fsm == std_char && !tty->ostate && (n = WriteRun(C, &tty->outq))) {
+            cnt += n;
+            continue;
+        }
+#endif
         WriteChar(C, tty_outproc(tty));
         cnt++;
     }
+#ifdef CONSOLE_WRITERUN
+    FlushShadow(C);
+#endif
     if (C == Visible)
         PositionCursor(C);
     return cnt;
@@ -382,5 +398,8 @@ static int Console_open(register struct tty *tty)
 {
     if ((int)tty->minor >= NumConsoles)
         return -ENODEV;
+#ifdef CONFIG_CONSOLE_SCROLLBACK
+    ScrollbackInit(&Con[tty->minor]);
+#endif
     return ttystd_open(tty);
 }
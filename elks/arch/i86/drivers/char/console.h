@@ -13,3 +13,4 @@ void bell(void);
 
 /* for direct and bios consoles only*/
 void Console_set_vc(int N);
+void Console_scrollback(int up);
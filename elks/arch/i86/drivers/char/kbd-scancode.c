@@ -47,6 +47,8 @@ static int kb_read(void);
 #define SCAN_DEL	0x53	/* scan code for Delete key*/
 #define SCAN_F1		0x3B	/* scan code for F1 key*/
 #define SCAN_KP7	0x47	/* scan code for Keypad 7 key*/
+#define SCAN_PGUP	0x49	/* scan code for PgUp key*/
+#define SCAN_PGDN	0x51	/* scan code for PgDn key*/
 
 char kbd_name[] = "scan";
 
@@ -75,6 +77,9 @@ static unsigned int ModeState = 0;
 static int capslock;
 static int numlock;
 static int scrlock;
+#ifdef CONFIG_CONSOLE_SCROLLBACK
+static int ShiftDown;	/* non-E0 shift keys held, for Shift-PgUp/PgDn*/
+#endif
 /*
  * Whether we are currently trying to send a command to the keyboard
  * controller to update the LEDs, and at what stage are we in sending the
@@ -238,6 +243,14 @@ static void keyboard_irq(int irq, struct pt_regs *regs)
 #if defined(CONFIG_KEYMAP_DE) || defined(CONFIG_KEYMAP_SE) || defined(CONFIG_KEYMAP_FR) || defined(CONFIG_KEYMAP_ES)
 	if ((mode == ALT) && E0key)	/* ALT_GR has a E0 prefix*/
 	    mode = ALT_GR;
+#endif
+#ifdef CONFIG_CONSOLE_SCROLLBACK
+	/* track real shift keys, controller sends E0 shifts around grey keys*/
+	if (!E0key && (mode & (LSHIFT|RSHIFT))) {
+	    if (keyReleased)
+		ShiftDown &= ~mode;
+	    else ShiftDown |= mode;
+	}
 #endif
 	if (keyReleased) {
 	    switch (mode) {
@@ -269,6 +282,14 @@ static void keyboard_irq(int irq, struct pt_regs *regs)
     if (keyReleased)
 	return;
 
+#ifdef CONFIG_CONSOLE_SCROLLBACK
+    /* Shift-PgUp/PgDn scroll console history*/
+    if (ShiftDown && (code == SCAN_PGUP || code == SCAN_PGDN)) {
+	Console_scrollback(code == SCAN_PGUP);
+	return;
+    }
+#endif
+
     switch(mode & 0xC0) {
     /* --------------Handle Function keys-------------- */
     case 0x40:			/* F1 .. F10*/
@@ -225,6 +225,10 @@ int kmem_ioctl(struct inode *inode, struct file *file, int cmd, char *arg)
 {
     unsigned short retword;
     struct mem_usage mu;
+#ifdef CONFIG_FS_XMS_BUFFER
+    struct xms_bench xb;
+    int err;
+#endif
 
     switch (cmd) {
     case MEM_GETTASK:
@@ -252,6 +256,17 @@ int kmem_ioctl(struct inode *inode, struct file *file, int cmd, char *arg)
     case MEM_GETJIFFADDR:
 	retword = (unsigned short) &jiffies;
         break;
+#ifdef CONFIG_FS_XMS_BUFFER
+    case MEM_XMSBENCH:
+	if (!suser())
+	    return -EPERM;
+	err = verified_memcpy_fromfs(&xb, arg, sizeof(xb));
+	if (!err)
+	    err = xms_bench(&xb);
+	if (!err)
+	    err = verified_memcpy_tofs(arg, &xb, sizeof(xb));
+	return err;
+#endif
     case MEM_GETUPTIME:
 #ifdef CONFIG_CPU_USAGE
 	retword = (unsigned short) &uptime;
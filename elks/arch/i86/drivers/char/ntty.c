@@ -294,15 +294,33 @@ size_t tty_write(struct inode *inode, struct file *file, char *data, size_t len)
             if (s == -EINTR || s == -EAGAIN) {
                 tty->ops->write(tty);
                 wake_up(&tty->outq.wait);
+                if ((tty->flags & TTY_TXINT) && !(file->f_flags & O_NONBLOCK)) {
+                    /* sleep until transmit interrupt drains queue*/
+                    prepare_to_wait_interruptible(&tty->outq.wait);
+                    if (tty->outq.len == tty->outq.size)
+                        do_wait();
+                    finish_wait(&tty->outq.wait);
+                    if (current->signal) {
+                        if (i == 0)
+                            i = -EINTR;
+                        break;
+                    }
+                    continue;
+                }
                 schedule();
+                if (current->signal) {
+                    if (i == 0)
+                        i = -EINTR;
+                    break;
+                }
                 continue;
             }
             if (i == 0)
                 i = s;
             break;
         }
-        chq_addch_nowakeup(&tty->outq, get_user_char(data++));
-        i++;
+        /* output processing is done by tty_outproc, so block copy always*/
+        i += chq_copyin(&tty->outq, data + i, len - i);
     }
     tty->ops->write(tty);
     wake_up(&tty->outq.wait);
@@ -316,6 +334,8 @@ size_t tty_read(struct inode *inode, struct file *file, char *data, size_t len)
     unsigned int vmin = tty->termios.c_cc[VMIN];
     unsigned int vtime = tty->termios.c_cc[VTIME];
     int nonblock = (file->f_flags & O_NONBLOCK) || (!icanon && vtime && !vmin);
+    int raw = !icanon && !(tty->termios.c_lflag & (ECHO|ECHONL))
+                && !(tty->termios.c_iflag & ICRNL);
     jiff_t timeout;
     size_t i = 0;
     int ch, k;
@@ -328,6 +348,16 @@ again:
             nonblock = 1;
         }
 
+        /* no input processing or echo, block copy whatever is queued*/
+        if (raw && chq_peekch(&tty->inq)) {
+            k = chq_copyout(&tty->inq, data, len - i);
+            data += k;
+            i += k;
+            if (vtime && vmin)  /* start timeout after first character*/
+                nonblock = 1;
+            continue;
+        }
+
         if (chq_peekch(&tty->inq))
             ch = chq_getch(&tty->inq);
         else {
@@ -381,6 +411,10 @@ again:
         if (icanon && ((ch == '\n') || (ch == tty->termios.c_cc[VEOL])))
             break;
     }
+
+    /* restart input flow control when queue drained below low watermark*/
+    if ((tty->flags & TTY_THROTTLED) && tty->inq.len <= tty->inq.size / 4)
+        tty->ops->ioctl(tty, TCXONC, (char *)TCION);
     return i;
 }
 
@@ -39,8 +39,10 @@ void pty_release(struct inode *inode, struct file *file)
     register struct tty *otty;
 
     debug("pty release\n");
-    if ((otty = determine_tty(inode->i_rdev)))
+    if ((otty = determine_tty(inode->i_rdev))) {
+	otty->flags &= ~TTY_PKTMODE;
 	kill_pg(otty->pgrp, SIGHUP, 1);
+    }
 }
 
 /* /dev/ptyp0 master select */
@@ -74,6 +76,34 @@ int pty_select (struct inode *inode, struct file *file, int sel_type)
 	return res;
 }
 
+/*
+ * Copy slave output to master reader. Runs of characters not changed
+ * by output processing are block copied, others go through tty_outproc.
+ */
+static int pty_copyout (struct tty *tty, char *data, size_t len)
+{
+	struct ch_queue *q = &tty->outq;
+	unsigned char *p;
+	int n, max;
+
+	if (!(tty->termios.c_oflag & OPOST))
+		return chq_copyout (q, data, len);
+
+	if (!tty->ostate) {
+		max = q->size - q->tail;
+		if (max > q->len) max = q->len;
+		if (max > len) max = len;
+		p = q->base + q->tail;
+		for (n = 0; n < max && p[n] != '\n' && p[n] != '\t'; n++)
+			continue;
+		if (n)
+			return chq_copyout (q, data, n);
+	}
+
+	put_user_char (tty_outproc (tty), (void *)data);
+	return 1;
+}
+
 /* /dev/ptyp0 master read (from slave /dev/ttyp0 outq to telnetd) */
 size_t pty_read (struct inode *inode, struct file *file, char *data, size_t len)
 {
@@ -87,6 +117,15 @@ size_t pty_read (struct inode *inode, struct file *file, char *data, size_t len)
 	if (!tty->usecount)
 		return 0;
 
+	/* packet mode, data preceded by status byte*/
+	if ((tty->flags & TTY_PKTMODE) && len) {
+		err = chq_wait_rd (&tty->outq, file->f_flags & O_NONBLOCK);
+		if (err < 0)
+			return err;
+		put_user_char (TIOCPKT_DATA, (void *)(data++));
+		count++;
+	}
+
 	while (count < len) {
 		err = chq_wait_rd (&tty->outq, (file->f_flags & O_NONBLOCK) | count);
 		if (err < 0) {
@@ -94,8 +133,9 @@ size_t pty_read (struct inode *inode, struct file *file, char *data, size_t len)
 			break;
 		}
 
-		put_user_char (tty_outproc (tty), (void *)(data++));
-		count++;
+		err = pty_copyout (tty, data, len - count);
+		data += err;
+		count += err;
 	}
 
 	if (count > 0)
@@ -120,6 +160,14 @@ size_t pty_write (struct inode *inode, struct file *file, char *data, size_t len
 			break;
 		}
 
+		/* block copy when no signal characters to check*/
+		if (!(tty->termios.c_lflag & ISIG)) {
+			ret = chq_copyin (&tty->inq, data, len - count);
+			data += ret;
+			count += ret;
+			continue;
+		}
+
 		ret = get_user_char ((void *)(data++));
 		if (!tty_intcheck(tty, ret))
 			chq_addch_nowakeup (&tty->inq, ret);
@@ -131,12 +179,38 @@ size_t pty_write (struct inode *inode, struct file *file, char *data, size_t len
 	return count;
 }
 
-/* /dev/ttyp0 slave (TTY) open */
+/* /dev/ptyp0 master ioctl */
+int pty_ioctl (struct inode *inode, struct file *file, int cmd, char *arg)
+{
+	struct tty *tty = determine_tty (inode->i_rdev); /* get slave TTY*/
+	if (tty == NULL) return -EBADF;
+
+	switch (cmd) {
+	case TIOCPKT:
+		if (get_user (arg))
+			tty->flags |= TTY_PKTMODE;
+		else tty->flags &= ~TTY_PKTMODE;
+		return 0;
+	case FIONREAD:			/* bytes available to master read*/
+		put_user (tty->usecount? tty->outq.len: 0, arg);
+		return 0;
+	}
+	return -EINVAL;
+}
+
+/* /dev/ttyp0 slave (TTY) open, large queues when heap allows */
 static int ttyp_open(struct tty *tty)
 {
+	int err;
+
 	if (tty->usecount++)
 		return 0;
-	return tty_allocq(tty, PTYINQ_SIZE, PTYOUTQ_SIZE);
+	err = tty_allocq(tty, PTYINQ_MAX, PTYOUTQ_MAX);
+	if (err)
+		err = tty_allocq(tty, PTYINQ_SIZE, PTYOUTQ_SIZE);
+	if (err)
+		tty->usecount--;
+	return err;
 }
 
 /* /dev/ttyp0 slave (TTY) close */
@@ -162,7 +236,7 @@ static struct file_operations pty_fops = {
     pty_write,
     NULL,
     pty_select,			/* Select - needs doing */
-    NULL,			/* ioctl */
+    pty_ioctl,
     pty_open,
     pty_release
 };
@@ -28,12 +28,24 @@ struct serial_info {
     unsigned char mcr;
     unsigned int  divisor;
     struct tty *tty;
-    int pad1, pad2, pad3;       // round out to 16 bytes for faster addressing of ports[]
+    unsigned int  inqsize;      /* receive queue size allocated at open*/
+    unsigned int  hiwater;      /* drop RTS at this receive queue length*/
+    unsigned char ier;          /* interrupt enable bits except THRI*/
+    unsigned char flow;         /* flow control state*/
+    unsigned long rxcount;      /* statistics returned by TIOCGSERIAL*/
+    unsigned long txcount;
+    unsigned int  overruns;
+    unsigned int  drops;
+    unsigned int  throttles;
+    int pad1;                   // round out to 32 bytes for faster addressing of ports[]
 };
 
 /* flags*/
 #define SERF_TYPE       15
 #define SERF_EXIST      16
+#define SERF_FIFO       32      /* 16 byte transmit FIFO enabled*/
+#define SERF_TXINT      64      /* interrupt driven transmit*/
+#define SERF_TXBUSY     128     /* transmit interrupt enabled, output in progress*/
 #define ST_8250         0
 #define ST_16450        1
 #define ST_16550        2
@@ -41,6 +53,13 @@ struct serial_info {
 #define ST_16750        4
 #define ST_UNKNOWN      15
 
+#define TX_FIFO_SIZE    16      /* bytes written per THRE interrupt with FIFO*/
+
+/* flow*/
+#define FLOW_RTSCTS     1       /* CRTSCTS hardware flow control*/
+#define FLOW_RTSOFF     2       /* RTS dropped, receive queue above high watermark*/
+#define CTS_TIMEOUT     (HZ/2)  /* max polled wait for CTS before giving up*/
+
 #define CONSOLE_PORT 0
 
 /* I/O delay settings*/
@@ -53,10 +72,14 @@ struct serial_info {
         ((unsigned char) (UART_MCR_DTR | UART_MCR_RTS | UART_MCR_OUT2))
 
 static struct serial_info ports[NR_SERIAL] = {
-    {(char *)COM1_PORT, COM1_IRQ, 0, DEFAULT_LCR, DEFAULT_MCR, 0, NULL, 0,0,0},
-    {(char *)COM2_PORT, COM2_IRQ, 0, DEFAULT_LCR, DEFAULT_MCR, 0, NULL, 0,0,0},
-    {(char *)COM3_PORT, COM3_IRQ, 0, DEFAULT_LCR, DEFAULT_MCR, 0, NULL, 0,0,0},
-    {(char *)COM4_PORT, COM4_IRQ, 0, DEFAULT_LCR, DEFAULT_MCR, 0, NULL, 0,0,0},
+    {(char *)COM1_PORT, COM1_IRQ, 0, DEFAULT_LCR, DEFAULT_MCR, 0, NULL, RSINQ_SIZE, 0,
+        UART_IER_RDI, 0, 0, 0, 0, 0, 0, 0},
+    {(char *)COM2_PORT, COM2_IRQ, 0, DEFAULT_LCR, DEFAULT_MCR, 0, NULL, RSINQ_SIZE, 0,
+        UART_IER_RDI, 0, 0, 0, 0, 0, 0, 0},
+    {(char *)COM3_PORT, COM3_IRQ, 0, DEFAULT_LCR, DEFAULT_MCR, 0, NULL, RSINQ_SIZE, 0,
+        UART_IER_RDI, 0, 0, 0, 0, 0, 0, 0},
+    {(char *)COM4_PORT, COM4_IRQ, 0, DEFAULT_LCR, DEFAULT_MCR, 0, NULL, RSINQ_SIZE, 0,
+        UART_IER_RDI, 0, 0, 0, 0, 0, 0, 0},
 };
 
 static char irq_to_port[16];
@@ -84,9 +107,8 @@ static unsigned int divisors[] = {
 
 extern struct tty ttys[];
 
-/* Flow control buffer markers */
-#define RS_IALLMOSTFULL         (3 * INQ_SIZE / 4)
-#define RS_IALLMOSTEMPTY        (    INQ_SIZE / 4)
+/* Flow control high watermark, RTS raised again by tty_read below size/4 */
+#define RS_IALMOSTFULL(size)    ((size) - (size) / 4)
 
 /* allow init to easily update the port irq from bootopts */
 void set_serial_irq(int tty, int irq)
@@ -155,6 +177,25 @@ static int rs_probe(register struct serial_info *sp)
     return 0;
 }
 
+/* raise RTS after reader drained receive queue*/
+static void rs_unthrottle(register struct serial_info *sp)
+{
+    clr_irq();
+    sp->flow &= ~FLOW_RTSOFF;
+    sp->tty->flags &= ~TTY_THROTTLED;
+    OUTB(sp->mcr, sp->io + UART_MCR);
+    set_irq();
+}
+
+/* drop RTS when receive queue reaches high watermark, called with interrupts disabled*/
+static void rs_throttle(register struct serial_info *sp)
+{
+    sp->flow |= FLOW_RTSOFF;
+    sp->tty->flags |= TTY_THROTTLED;
+    sp->throttles++;
+    OUTB(sp->mcr & ~UART_MCR_RTS, sp->io + UART_MCR);
+}
+
 static void update_port(register struct serial_info *port)
 {
     unsigned int cflags;        /* use smaller 16-bit width to save code*/
@@ -168,6 +209,19 @@ static void update_port(register struct serial_info *port)
 
     //FIXME: update lcr parity and data width from termios values
 
+    /* hardware flow control, enable modem status interrupts for CTS changes*/
+    if (port->tty->termios.c_cflag & CRTSCTS) {
+        port->flow |= FLOW_RTSCTS;
+        port->ier = UART_IER_RDI | UART_IER_MSI;
+    } else {
+        port->flow &= ~FLOW_RTSCTS;
+        port->ier = UART_IER_RDI;
+        if (port->flow & FLOW_RTSOFF)
+            rs_unthrottle(port);
+    }
+    if (port->tty->usecount)
+        OUTB(port->ier | ((port->flags & SERF_TXBUSY)? UART_IER_THRI: 0), port->io + UART_IER);
+
     /* update divisor only if changed, since we have not TCSETW*/
     if (divisor != port->divisor) {
         port->divisor = divisor;
@@ -188,17 +242,68 @@ static void update_port(register struct serial_info *port)
     }
 }
 
-/* serial write - busy loops until transmit buffer available */
+/*
+ * Fill transmitter from output queue, called with interrupts disabled.
+ * Up to TX_FIFO_SIZE bytes are written when the FIFO is enabled,
+ * otherwise one. The transmit interrupt is turned off when the queue empties.
+ */
+static void rs_xmit(register struct serial_info *sp)
+{
+    struct tty *tty = sp->tty;
+    int n = (sp->flags & SERF_FIFO)? TX_FIFO_SIZE: 1;
+
+    /* stop transmit interrupts while CTS low, modem status interrupt restarts*/
+    if ((sp->flow & FLOW_RTSCTS) && !(INB(sp->io + UART_MSR) & UART_MSR_CTS)) {
+        OUTB(sp->ier, sp->io + UART_IER);
+        return;
+    }
+
+    while (tty->outq.len > 0) {
+        OUTB((char)tty_outproc(tty), sp->io + UART_TX);
+        sp->txcount++;
+        if (--n == 0)
+            break;
+    }
+    if (tty->outq.len == 0) {
+        sp->flags &= ~SERF_TXBUSY;
+        OUTB(sp->ier, sp->io + UART_IER);
+    } else
+        OUTB(sp->ier | UART_IER_THRI, sp->io + UART_IER);
+    wake_up(&tty->outq.wait);
+}
+
+/* serial write - start transmit interrupts, or busy loop until transmit buffer available */
 static int rs_write(struct tty *tty)
 {
     register struct serial_info *port = &ports[tty->minor - RS_MINOR_OFFSET];
     int i = 0;
 
+    if (port->flags & SERF_TXINT) {
+        clr_irq();
+        if (!(port->flags & SERF_TXBUSY) && tty->outq.len > 0) {
+            port->flags |= SERF_TXBUSY;
+            OUTB(port->ier | UART_IER_THRI, port->io + UART_IER);
+            if (INB(port->io + UART_LSR) & UART_LSR_THRE)
+                rs_xmit(port);          /* prime transmitter, rest sent by rs_irq*/
+        }
+        set_irq();
+        return 0;
+    }
+
     while (tty->outq.len > 0) {
-        /* Wait until transmitter hold buffer empty */
+        /* Wait until transmitter hold buffer empty and clear to send*/
         while (!(INB(port->io + UART_LSR) & UART_LSR_THRE))
                 ;
+        if (port->flow & FLOW_RTSCTS) {
+            /* peer may hold CTS low indefinitely, leave the rest queued*/
+            jiff_t timeout = jiffies + CTS_TIMEOUT;
+            while (!(INB(port->io + UART_MSR) & UART_MSR_CTS)) {
+                if (current->signal || time_after(jiffies, timeout))
+                    return i;
+            }
+        }
         outb((char)tty_outproc(tty), port->io + UART_TX);
+        port->txcount++;
         i++;
     }
     return i;
@@ -248,12 +353,19 @@ void fast_com1_irq(void)
     unsigned char c;
 
     c = INB(io + UART_RX);              /* Read received data */
+    sp->rxcount++;
     if (q->len < q->size) {
         q->base[q->head] = c;
         if (++q->head >= q->size)
             q->head = 0;
-        q->len++;
-    }
+        /* drop RTS inline, no function calls allowed here*/
+        if (++q->len >= sp->hiwater && sp->flow == FLOW_RTSCTS) {
+            sp->flow |= FLOW_RTSOFF;
+            sp->tty->flags |= TTY_THROTTLED;
+            sp->throttles++;
+            OUTB(sp->mcr & ~UART_MCR_RTS, io + UART_MCR);
+        }
+    } else sp->drops++;
 }
 #endif
 
@@ -267,12 +379,19 @@ void fast_com2_irq(void)
     unsigned char c;
 
     c = INB(io + UART_RX);              /* Read received data */
+    sp->rxcount++;
     if (q->len < q->size) {
         q->base[q->head] = c;
         if (++q->head >= q->size)
             q->head = 0;
-        q->len++;
-    }
+        /* drop RTS inline, no function calls allowed here*/
+        if (++q->len >= sp->hiwater && sp->flow == FLOW_RTSCTS) {
+            sp->flow |= FLOW_RTSOFF;
+            sp->tty->flags |= TTY_THROTTLED;
+            sp->throttles++;
+            OUTB(sp->mcr & ~UART_MCR_RTS, io + UART_MCR);
+        }
+    } else sp->drops++;
 }
 #endif
 
@@ -281,34 +400,50 @@ void fast_com2_irq(void)
 
 /*
  * Slower serial interrupt routine, called from _irq_com with passed irq #
- * Reads all FIFO data available per interrupt and can provide serial stats
+ * Reads all FIFO data available per interrupt and can provide serial stats.
+ * Refills the transmitter when interrupt driven output is in progress.
  */
 void rs_irq(int irq, struct pt_regs *regs)
 {
     struct serial_info *sp = &ports[(int)irq_to_port[irq]];
     char *io = sp->io;
     struct ch_queue *q = &sp->tty->inq;
+    int status, iir;
+
+    /* loop until no interrupt pending, since 8259 is edge triggered*/
+    for (;;) {
+        status = INB(io + UART_LSR);                    /* check for data overrun*/
+        if (status & UART_LSR_DR) {                     /* QEMU may interrupt w/no data*/
+            if (status & UART_LSR_OE)
+                sp->overruns++;
+
+            /* read uart/fifo until empty*/
+            do {
+                unsigned char c = INB(io + UART_RX);    /* Read received data */
+                sp->rxcount++;
+                if (!tty_intcheck(sp->tty, c)) {
+                    if (q->len >= q->size)
+                        sp->drops++;
+                    else chq_addch_nowakeup(q, c);
+                }
+            } while ((status = INB(io + UART_LSR)) & UART_LSR_DR); /* while data available (for FIFOs)*/
+
+            if (q->len >= sp->hiwater && sp->flow == FLOW_RTSCTS)
+                rs_throttle(sp);
+
+            if (q->len)         /* don't wakeup unless chars else EINTR result*/
+                wake_up(&q->wait);
+        }
 
-    int status = INB(io + UART_LSR);                    /* check for data overrun*/
-    if ((status & UART_LSR_DR) == 0)                    /* QEMU may interrupt w/no data*/
-        return;
-
-#if UNUSED      // turn on for serial stats
-    if (status & UART_LSR_OE)
-        printk("serial: data overrun\n");
-    if (status & (UART_LSR_FE|UART_LSR_PE))
-        printk("serial: frame/parity error\n");
-#endif
-
-    /* read uart/fifo until empty*/
-    do {
-        unsigned char c = INB(io + UART_RX);            /* Read received data */
-        if (!tty_intcheck(sp->tty, c))
-            chq_addch_nowakeup(q, c);
-    } while (INB(io + UART_LSR) & UART_LSR_DR); /* while data available (for FIFOs)*/
+        if ((sp->flags & SERF_TXBUSY) && (status & UART_LSR_THRE))
+            rs_xmit(sp);
 
-    if (q->len)         /* don't wakeup unless chars else EINTR result*/
-        wake_up(&q->wait);
+        iir = INB(io + UART_IIR);
+        if (iir & UART_IIR_NO_INT)
+            break;
+        if ((iir & UART_IIR_ID) == UART_IIR_MSI)
+            INB(io + UART_MSR);         /* clear CTS change, rechecked by rs_xmit*/
+    }
 }
 
 #endif  // !defined(CONFIG_FAST_IRQ4) || !defined(CONFIG_FAST_IRQ3)
@@ -320,7 +455,17 @@ static void rs_release(struct tty *tty)
 
     debug_tty("SERIAL close %P\n");
     if (--tty->usecount == 0) {
+        /* let interrupt driven output drain before shutdown*/
+        while ((port->flags & SERF_TXBUSY) && !current->signal) {
+            prepare_to_wait_interruptible(&tty->outq.wait);
+            if (port->flags & SERF_TXBUSY)
+                do_wait();
+            finish_wait(&tty->outq.wait);
+        }
         OUTB(0, port->io + UART_IER);   /* Disable all interrupts */
+        port->flags &= ~(SERF_FIFO | SERF_TXINT | SERF_TXBUSY);
+        port->flow &= ~FLOW_RTSOFF;
+        tty->flags &= ~(TTY_TXINT | TTY_THROTTLED);
         free_irq(port->irq);
         tty_freeq(tty);
     }
@@ -353,13 +498,20 @@ static int rs_open(struct tty *tty)
 #endif
     default:
         err = request_irq(port->irq, rs_irq, INT_GENERIC);
+        if (!err) {
+            port->flags |= SERF_TXINT;  /* rs_irq handles transmit interrupts*/
+            tty->flags |= TTY_TXINT;
+        }
         break;
     }
     if (err) goto errout;
     irq_to_port[port->irq] = port - ports;      /* Map irq to this tty # */
 
-    err = tty_allocq(tty, RSINQ_SIZE, RSOUTQ_SIZE);
+    err = tty_allocq(tty, port->inqsize, RSOUTQ_SIZE);
     if (err) {
+        free_irq(port->irq);
+        port->flags &= ~SERF_TXINT;
+        tty->flags &= ~TTY_TXINT;
 errout:
         --tty->usecount;
         return err;
@@ -370,8 +522,10 @@ errout:
 
     /* enable FIFO and flush input*/
 #ifdef CONFIG_HW_SERIAL_FIFO
-    if ((port->flags & SERF_TYPE) > ST_16550)
+    if ((port->flags & SERF_TYPE) > ST_16550) {
         OUTB(UART_FCR_ENABLE_FIFO14, port->io + UART_FCR);
+        port->flags |= SERF_FIFO;
+    }
 #else
     /* flush input*/
     flush_input(port);
@@ -381,10 +535,11 @@ errout:
     INB(port->io + UART_MSR);
 
     /* set serial port parameters to match ports[rs_minor] */
+    port->hiwater = RS_IALMOSTFULL(port->inqsize);
     update_port(port);
 
-    /* enable receiver data interrupt*/
-    OUTB(UART_IER_RDI, port->io + UART_IER);
+    /* enable receiver data and modem status interrupts*/
+    OUTB(port->ier, port->io + UART_IER);
 
     OUTB(port->mcr, port->io + UART_MCR);
 
@@ -397,34 +552,40 @@ errout:
     return 0;
 }
 
-#if UNUSED      // removed for bloat
-static int set_serial_info(struct serial_info *info,
-                           struct serial_info *new_info)
+static int get_serial_info(struct serial_info *sp, struct serial_stats *arg)
 {
-    register struct tty *tty;
-    int err;
-
-    tty = info->tty;
-    err = verified_memcpy_fromfs(info, new_info, sizeof(struct serial_info));
-    if (!err) {
-        /* shutdown serial port and restart UART with new settings */
-
-        /* witty cheat :) - either we do this (and waste some DS) or duplicate
-         * almost whole rs_release and rs_open (and waste much more CS)
-         */
-        info->tty = tty;
-        rs_release(tty);
-        err = rs_open(tty);
-    }
-    return err;
+    struct serial_stats ss;
+
+    ss.port = (unsigned int)sp->io;
+    ss.irq = sp->irq;
+    ss.type = sp->flags & SERF_TYPE;
+    ss.inqsize = sp->inqsize;
+    clr_irq();
+    ss.rxcount = sp->rxcount;
+    ss.txcount = sp->txcount;
+    ss.overruns = sp->overruns;
+    ss.drops = sp->drops;
+    ss.throttles = sp->throttles;
+    set_irq();
+    return verified_memcpy_tofs(arg, &ss, sizeof(ss));
 }
 
-static int get_serial_info(struct serial_info *info,
-                           struct serial_info *ret_info)
+/* set receive queue size for next open and reset statistics*/
+static int set_serial_info(struct serial_info *sp, struct serial_stats *arg)
 {
-    return verified_memcpy_tofs(ret_info, info, sizeof(struct serial_info));
+    struct serial_stats ss;
+
+    if (verified_memcpy_fromfs(&ss, arg, sizeof(ss)))
+        return -EFAULT;
+    if (ss.inqsize < RS_MIN_INQ || ss.inqsize > RS_MAX_INQ)
+        return -EINVAL;
+    sp->inqsize = ss.inqsize;
+    clr_irq();
+    sp->rxcount = sp->txcount = 0;
+    sp->overruns = sp->drops = sp->throttles = 0;
+    set_irq();
+    return 0;
 }
-#endif
 
 static int rs_ioctl(struct tty *tty, int cmd, char *arg)
 {
@@ -441,14 +602,26 @@ static int rs_ioctl(struct tty *tty, int cmd, char *arg)
         //FIXME: update_port() only sets baud rate from termios, not parity or wordlen*/
         update_port(port);      /* ignored return value*/
         break;
-#if UNUSED
+    case TCXONC:
+        /* TCION called by tty_read when receive queue drained*/
+        if ((int)arg == TCION) {
+            if (port->flow & FLOW_RTSOFF)
+                rs_unthrottle(port);
+        } else if ((int)arg == TCIOFF) {
+            clr_irq();
+            if (!(port->flow & FLOW_RTSOFF))
+                rs_throttle(port);
+            set_irq();
+        } else return -EINVAL;
+        break;
+
     case TIOCSSERIAL:
-        retval = set_serial_info(port, (struct serial_info *)arg);
+        retval = set_serial_info(port, (struct serial_stats *)arg);
         break;
 
     case TIOCGSERIAL:
-        retval = get_serial_info(port, (struct serial_info *)arg);
-#endif
+        retval = get_serial_info(port, (struct serial_stats *)arg);
+        break;
 
     default:
         return -EINVAL;
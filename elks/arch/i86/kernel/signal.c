@@ -50,7 +50,7 @@ int do_signal(void)
 		current->state = TASK_STOPPED;
 		/* Let the parent know */
 		current->exit_status = signr;
-		schedule();
+		schedule_user();
 	    }
 	    else {					/* Default Core or Terminate */
 #if UNUSED
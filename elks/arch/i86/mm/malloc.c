@@ -8,6 +8,7 @@
 #include <linuxmt/errno.h>
 #include <linuxmt/debug.h>
 #include <linuxmt/heap.h>
+#include <linuxmt/memory.h>
 
 #include <arch/segment.h>
 
@@ -25,6 +26,29 @@
 static list_s _seg_all;
 static list_s _seg_free;
 
+#ifdef CONFIG_SEG_SWAP
+
+// Swap area in XMS memory, allocated in 1K units
+// A swapped out segment keeps its last base for register
+// fixups and keeps its owner pid, its first swap unit is in swap.
+// It stays on the all list, after the main memory segments
+
+#define SWAP_UNITS      CONFIG_SEG_SWAP_SIZE
+#define swap_units(seg) (((seg)->size + 63) >> 6)
+#define swap_addr(seg)  (swap_base + ((ramdesc_t)(seg)->swap << 10))
+
+static ramdesc_t swap_base;
+static byte_t swap_map [(SWAP_UNITS + 7) >> 3];
+
+// Tasks waiting for memory to swap back in
+
+static struct wait_queue swap_wait;
+static int swap_waiting;
+
+static int seg_swapout_idle (void);
+static void swap_put (word_t unit, word_t count);
+#endif
+
 
 // Split segment if enough large
 
@@ -113,12 +137,391 @@ static void seg_merge (segment_s * s1, segment_s * s2)
 }
 
 
+#ifdef CONFIG_SEG_COMPACT
+
+// Check that the segment is only referenced by tasks
+// switched out on return to user mode so that its base can be changed.
+// Tasks asleep in a system call may hold far pointers into their segments
+
+static int seg_movable (segment_s * seg)
+{
+	struct task_struct * t;
+	int i, refs = 0;
+	word_t type = seg->flags & SEG_FLAG_TYPE;
+
+	if ((seg->flags & (SEG_FLAG_FIXED|SEG_FLAG_ALIGN1K|SEG_FLAG_SWAPPED))
+		|| (type != SEG_FLAG_CSEG && type != SEG_FLAG_DSEG))
+		return 0;
+
+	for_each_task (t) {
+		for (i = 0; i < MAX_SEGS; i++) {
+			if (t->mm[i] != seg)
+				continue;
+
+			// Skip current, tasks inside the kernel and
+			// tasks that have borrowed DS
+
+			if (t == current || !t->t_atuser
+				|| t->state >= TASK_ZOMBIE
+				|| t->t_regs.ds != t->t_regs.ss
+				|| !t->mm[SEG_DATA] || t->t_regs.ss != t->mm[SEG_DATA]->base)
+				return 0;
+
+			// User signal handler frames on stack
+			// may hold far return addresses
+
+			if (type == SEG_FLAG_CSEG && t->sig.handler)
+				return 0;
+
+			refs++;
+		}
+	}
+
+	return refs == seg->ref_count;
+}
+
+
+// Update user CS in the bp ip cs f frame on the user stack
+
+static void seg_fix_ustack (struct task_struct * t, seg_t old, seg_t cs)
+{
+#ifdef CONFIG_SEG_SWAP
+	segment_s * data = t->mm[SEG_DATA];
+
+	if (data->flags & SEG_FLAG_SWAPPED) {
+		word_t w;
+		char * off = (char *) t->t_regs.sp + 4;
+
+		xms_fmemcpyw (&w, kernel_ds, off, swap_addr (data), 1);
+		if (w == old)
+			xms_fmemcpyw (off, swap_addr (data), &cs, kernel_ds, 1);
+		return;
+	}
+#endif
+	if (get_ustack (t, 4) == old)
+		put_ustack (t, 4, cs);
+}
+
+
+// Update the registers of all tasks using a moved segment
+
+static void seg_relocate (segment_s * seg, seg_t old)
+{
+	struct task_struct * t;
+	int i;
+
+	for_each_task (t) {
+		for (i = 0; i < MAX_SEGS; i++) {
+			if (t->mm[i] != seg)
+				continue;
+
+			if ((seg->flags & SEG_FLAG_TYPE) == SEG_FLAG_CSEG) {
+				t->t_xregs.cs = seg->base;
+				seg_fix_ustack (t, old, seg->base);
+			} else {
+				t->t_regs.ds = t->t_regs.ss = seg->base;
+				if (t->t_regs.es == old)	// else far data or video RAM
+					t->t_regs.es = seg->base;
+			}
+		}
+	}
+}
+
+
+// Slide movable segments down into the free segments below them
+// Return the size of the largest free segment afterwards
+
+static segext_t seg_compact (void)
+{
+	segext_t largest = 0;
+	list_s * n = _seg_all.next;
+
+	while (n != &_seg_all) {
+		segment_s * seg = structof (n, segment_s, all);
+		list_s * nn = seg->all.next;
+
+		if (seg->flags == SEG_FLAG_FREE && nn != &_seg_all) {
+			segment_s * next = structof (nn, segment_s, all);
+
+			if (seg->base + seg->size == next->base && seg_movable (next)) {
+				seg_t old = next->base;
+				seg_t dst = seg->base;
+				segext_t left = next->size;
+
+				debug("seg:move %x to %x size %x\n", old, dst, left);
+				while (left) {
+					segext_t count = (left > 0x1000)? 0x1000: left;
+					fmemcpyw (0, dst, 0, old + (dst - seg->base), count << 3);
+					dst += count;
+					left -= count;
+				}
+
+				// Swap the free and used segments in the address list
+
+				next->base = seg->base;
+				seg->base = next->base + next->size;
+				list_remove (&seg->all);
+				list_insert_after (&next->all, &seg->all);
+				seg_relocate (next, old);
+
+				// Then merge the free segment with its new neighbour
+
+				nn = seg->all.next;
+				if (nn != &_seg_all) {
+					segment_s * after = structof (nn, segment_s, all);
+					if (after->flags == SEG_FLAG_FREE && seg->base + seg->size == after->base) {
+						list_remove (&after->free);
+						seg_merge (seg, after);
+					}
+				}
+				continue;
+			}
+		}
+
+		if (seg->flags == SEG_FLAG_FREE && seg->size > largest)
+			largest = seg->size;
+		n = seg->all.next;
+	}
+
+	return largest;
+}
+#endif
+
+#ifdef CONFIG_SEG_SWAP
+
+// Get contiguous swap units, return first unit or -1
+
+static int swap_get (word_t count)
+{
+	word_t unit, run = 0;
+
+	for (unit = 0; unit < SWAP_UNITS; unit++) {
+		if (swap_map [unit >> 3] & (1 << (unit & 7)))
+			run = 0;
+		else if (++run == count) {
+			unit -= count - 1;
+			for (run = 0; run < count; run++)
+				swap_map [(unit + run) >> 3] |= 1 << ((unit + run) & 7);
+			return unit;
+		}
+	}
+
+	return -1;
+}
+
+
+// Release swap units
+
+static void swap_put (word_t unit, word_t count)
+{
+	while (count--) {
+		swap_map [unit >> 3] &= ~(1 << (unit & 7));
+		unit++;
+	}
+	if (swap_waiting)
+		wake_up (&swap_wait);
+}
+
+
+// Copy segment to or from swap in 64K chunks
+
+static void swap_copy (segment_s * seg, seg_t base, int out)
+{
+	segext_t done = 0;
+
+	while (done < seg->size) {
+		segext_t count = seg->size - done;
+		ramdesc_t swap = swap_addr (seg) + ((ramdesc_t) done << 4);
+
+		if (count > 0x1000)
+			count = 0x1000;
+		if (out)
+			xms_fmemcpyw (0, swap, 0, base + done, count << 3);
+		else
+			xms_fmemcpyw (0, base + done, 0, swap, count << 3);
+		done += count;
+	}
+}
+
+
+// Move segment to swap and release its main memory
+
+static int seg_swapout (segment_s * seg)
+{
+	int unit = swap_get (swap_units (seg));
+	if (unit < 0)
+		return 0;
+
+	// Hand the main memory over to a new descriptor
+	// so that it is freed and merged as usual
+
+	segment_s * hole = (segment_s *) heap_alloc (sizeof (segment_s), HEAP_TAG_SEG);
+	if (!hole) {
+		swap_put (unit, swap_units (seg));
+		return 0;
+	}
+
+	seg->swap = unit;
+	swap_copy (seg, seg->base, 1);
+	debug("seg:swap out %x size %x to %u\n", seg->base, seg->size, unit);
+
+	hole->base = seg->base;
+	hole->size = seg->size;
+	hole->flags = SEG_FLAG_USED;
+	hole->ref_count = 1;
+	list_insert_after (&seg->all, &hole->all);
+	list_remove (&seg->all);
+	list_insert_before (&_seg_all, &seg->all);
+	seg->flags |= SEG_FLAG_SWAPPED;
+	seg_free (hole);
+
+	return 1;
+}
+
+
+// Bring segment back from swap to any free main memory
+
+static int seg_swapin (segment_s * seg)
+{
+	seg_t old = seg->base;
+	segment_s * hole = seg_alloc (seg->size, seg->flags & SEG_FLAG_TYPE);
+	if (!hole)
+		return 0;
+
+	swap_copy (seg, hole->base, 0);
+	debug("seg:swap in %x size %x from %u\n", hole->base, seg->size, seg->swap);
+
+	swap_put (seg->swap, swap_units (seg));
+	seg->flags &= ~SEG_FLAG_SWAPPED;
+	seg->base = hole->base;
+	list_remove (&seg->all);
+	list_insert_after (&hole->all, &seg->all);
+	list_remove (&hole->all);
+	heap_free (hole);
+
+	seg_relocate (seg, old);
+	return 1;
+}
+
+
+// Swap out the segments of the most idle stopped or waiting task
+// Return the number of segments swapped out
+
+static int seg_swapout_idle (void)
+{
+	struct task_struct * t;
+	struct task_struct * best = 0;
+	int i, count = 0;
+
+	if (!swap_base)
+		return 0;
+
+	for_each_task (t) {
+		if (t == current || t->state == TASK_RUNNING)
+			continue;
+		for (i = 0; i < MAX_SEGS; i++) {
+			if (t->mm[i] && seg_movable (t->mm[i]))
+				break;
+		}
+		if (i == MAX_SEGS)
+			continue;
+#ifdef CONFIG_CPU_USAGE
+		if (!best || t->average < best->average)
+			best = t;
+#else
+		best = t;
+		break;
+#endif
+	}
+
+	if (best) {
+		for (i = 0; i < MAX_SEGS; i++) {
+			if (best->mm[i] && seg_movable (best->mm[i]))
+				count += seg_swapout (best->mm[i]);
+		}
+	}
+
+	return count;
+}
+
+
+// Bring back the swapped segments of the current task
+// Data first so that the user stack is there for code fixup
+
+static int seg_swapin_current (void)
+{
+	int i, pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < MAX_SEGS; i++) {
+			segment_s * seg = current->mm[i];
+
+			if (!seg || !(seg->flags & SEG_FLAG_SWAPPED))
+				continue;
+			if (((seg->flags & SEG_FLAG_TYPE) == SEG_FLAG_CSEG) != pass)
+				continue;
+			if (!seg_swapin (seg))
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+// Called by the task on its way back to user mode, where its
+// segments may have been swapped out. Sleep until memory or swap
+// space is released by another task when they cannot come back
+
+void seg_swapin_wait (void)
+{
+	while (!seg_swapin_current ()) {
+		swap_waiting++;
+		prepare_to_wait (&swap_wait);
+		do_wait ();
+		finish_wait (&swap_wait);
+		swap_waiting--;
+	}
+}
+
+
+// Allocate the swap area once XMS is enabled
+
+void INITPROC seg_swap_init (void)
+{
+	swap_base = xms_alloc ((long_t) SWAP_UNITS << 10);
+	if (swap_base)
+		printk("swap: %uK xms\n", SWAP_UNITS);
+}
+#endif
+
+
 // Allocate segment
 
 segment_s * seg_alloc (segext_t size, word_t type)
 {
 	segment_s * seg = 0;
 	seg = seg_free_get (size, type);
+#ifdef CONFIG_EXEC_CODE_CACHE
+	while (!seg && exec_cache_shrink (0))
+		seg = seg_free_get (size, type);
+#endif
+#ifdef CONFIG_SEG_COMPACT
+	if (!seg && seg_compact () >= size)
+		seg = seg_free_get (size, type);
+#ifdef CONFIG_EXEC_CODE_CACHE
+	while (!seg && exec_cache_shrink (1)) {
+		if (seg_compact () >= size)
+			seg = seg_free_get (size, type);
+	}
+#endif
+#endif
+#ifdef CONFIG_SEG_SWAP
+	while (!seg && seg_swapout_idle ()) {
+		if (seg_compact () >= size)
+			seg = seg_free_get (size, type);
+	}
+#endif
 	if (seg && (type & SEG_FLAG_ALIGN1K))
 		seg->base += ((~seg->base + 1) & ((1024 >> 4) - 1));
 	return seg;
@@ -135,6 +538,21 @@ void seg_free (segment_s * seg)
 	//     chance on next allocation of same size
 
 	list_s * i = &_seg_free;
+
+	if ((seg->flags & SEG_FLAG_TYPE) == SEG_FLAG_ROM) {
+		heap_free (seg);
+		return;
+	}
+
+#ifdef CONFIG_SEG_SWAP
+	if (seg->flags & SEG_FLAG_SWAPPED) {
+		list_remove (&seg->all);
+		swap_put (seg->swap, swap_units (seg));
+		heap_free (seg);
+		return;
+	}
+#endif
+
 	seg->flags = SEG_FLAG_FREE;
 	seg->pid = 0;
 
@@ -165,6 +583,11 @@ void seg_free (segment_s * seg)
 	// Insert to free list head or tail
 
 	list_insert_after (i, &(seg->free));
+
+#ifdef CONFIG_SEG_SWAP
+	if (swap_waiting)
+		wake_up (&swap_wait);
+#endif
 }
 
 
@@ -199,6 +622,24 @@ segment_s * seg_dup (segment_s * src)
 }
 
 
+// Describe memory outside of main memory, such as code
+// executing in place from ROM. Never on the segment lists,
+// so it is not moved, swapped or merged, just dropped when freed
+
+segment_s * seg_rom (seg_t base, segext_t size)
+{
+	segment_s * seg = (segment_s *) heap_alloc (sizeof (segment_s), HEAP_TAG_SEG);
+	if (seg) {
+		seg->base = base;
+		seg->size = size;
+		seg->flags = SEG_FLAG_USED | SEG_FLAG_FIXED | SEG_FLAG_ROM;
+		seg->ref_count = 1;
+		seg->pid = 0;
+	}
+	return seg;
+}
+
+
 // Get memory information (free and used) in KB
 
 void mm_get_usage (unsigned int * pfree, unsigned int * pused)
@@ -216,7 +657,7 @@ void mm_get_usage (unsigned int * pfree, unsigned int * pused)
 
 		if (seg->flags == SEG_FLAG_FREE)
 			free += seg->size;
-		else
+		else if (!(seg->flags & SEG_FLAG_SWAPPED))
 			used += seg->size;
 
 		n = seg->all.next;
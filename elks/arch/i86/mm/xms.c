@@ -10,6 +10,11 @@
 #include <linuxmt/init.h>
 
 #include <linuxmt/string.h>
+#include <linuxmt/mm.h>
+#include <linuxmt/fs.h>
+#include <linuxmt/mem.h>
+#include <linuxmt/sched.h>
+#include <linuxmt/errno.h>
 #include <arch/segment.h>
 
 /* linear address to start XMS buffer allocations from */
@@ -18,11 +23,20 @@
 
 #ifdef CONFIG_FS_XMS_BUFFER
 
-/* these used in CONFIG_FS_XMS_INT15 only */
+/* BIOS block move, INT 15h AH=87h or INT 1Fh AH=90h on PC-98 */
 struct gdt_table;
 extern int block_move(struct gdt_table *gdtp, size_t words);
-extern void int15_fmemcpyw(void *dst_off, addr_t dst_seg, void *src_off, addr_t src_seg,
+static void int15_init(void);
+static void int15_fmemcpyw(void *dst_off, addr_t dst_seg, void *src_off, addr_t src_seg,
 		size_t count);
+static void int15_fmemset(void *dst_off, addr_t dst_seg, byte_t val, size_t count);
+
+/* K bytes of extended memory above 1M */
+#ifdef CONFIG_ARCH_PC98
+#define get_extmem()	((unsigned int)peekb(0x401, 0) << 7)	/* 128K units below 16M */
+#else
+extern unsigned int get_extmem(void);	/* BIOS INT 15h AX=E801h or AH=88h */
+#endif
 
 /*
  * ramdesc_t: if CONFIG_FS_XMS_BUFFER not set, then it's a normal seg_t segment descriptor.
@@ -33,25 +47,40 @@ extern void int15_fmemcpyw(void *dst_off, addr_t dst_seg, void *src_off, addr_t
  * addr_t: linear 32-bit RAM address, used directly by CPU using 32-bit
  *     address operand prefix and unreal mode for indexing off of DS:ESI or ES:EDI
  *     in linear32_fmemcypw.
+ *
+ * The copy method is chosen once at init: unreal mode with 32-bit moves on a 386+
+ * not running in V86 mode, otherwise the BIOS block move on a 286+ (or always,
+ * when CONFIG_FS_XMS_INT15 is set).
  */
 
-static int xms_enabled;
+static int xms_enabled;		/* copy method, XMS_COPY_UNREAL or XMS_COPY_INT15 */
 static long_t xms_alloc_ptr = XMS_START_ADDR;
+static long_t xms_alloc_end;	/* end of installed extended memory */
 
-/* try to enable unreal mode and A20 gate. Return 1 if successful */
+/* try to enable unreal mode or BIOS block move and A20 gate. Return 1 if successful */
 int xms_init(void)
 {
 	int enabled;
+	int method = XMS_COPY_INT15;
+	unsigned int kbytes;
 
 	/* display initial A20 and A20 enable result */
 	printk("xms: ");
 #ifndef CONFIG_FS_XMS_INT15
-	if (check_unreal_mode() <= 0) {
-		printk("disabled, requires 386, ");
+	if (check_unreal_mode() > 0)
+		method = XMS_COPY_UNREAL;
+	else if (SETUP_CPU_TYPE < 6) {	/* cputype.S: 6 = 80286, 0xff = 386+ */
+		printk("disabled, requires 286, ");
 		return 0;
 	}
 #endif
-	printk("A20 was %s", verify_a20()? "on" : "off");
+	kbytes = get_extmem();
+	xms_alloc_end = 0x00100000L + ((long_t)kbytes << 10);
+	if (xms_alloc_end <= XMS_START_ADDR) {
+		printk("disabled, no extended memory, ");
+		return 0;
+	}
+	printk("%uK, A20 was %s", kbytes, verify_a20()? "on" : "off");
 	enable_a20_gate();
 	enabled = verify_a20();
 	printk(" now %s, ", enabled? "on" : "off");
@@ -59,26 +88,39 @@ int xms_init(void)
 		printk("disabled, A20 error, ");
 		return 0;
 	}
-#ifdef CONFIG_FS_XMS_INT15
-	printk("using int 15/1F, ");
-#else
-	enable_unreal_mode();
-	printk("using unreal mode, ");
+#ifndef CONFIG_FS_XMS_INT15
+	if (method == XMS_COPY_UNREAL) {
+		enable_unreal_mode();
+		printk("using unreal mode, ");
+	} else
 #endif
-	xms_enabled = 1;	/* enables xms_fmemcpyw()*/
-	return xms_enabled;
+	{
+		int15_init();
+		printk("using int 15/1F, ");
+	}
+	xms_enabled = method;	/* enables xms_fmemcpyw()*/
+	return 1;
 }
 
-/* allocate from XMS memory - very simple for now, no free */
+/* allocate from XMS memory - very simple for now, no free, returns 0 if no XMS or full */
 ramdesc_t xms_alloc(long_t size)
 {
 	long_t mem = xms_alloc_ptr;
 
+	if (!xms_enabled || size > xms_alloc_end - xms_alloc_ptr)
+		return 0;
+
 	xms_alloc_ptr += size;
 	//printk("xms_alloc %lx size %lu\n", mem, size);
 	return mem;
 }
 
+/* return bytes of XMS memory left to allocate */
+long_t xms_avail(void)
+{
+	return xms_enabled? xms_alloc_end - xms_alloc_ptr: 0;
+}
+
 /* copy words between XMS and far memory */
 void xms_fmemcpyw(void *dst_off, ramdesc_t dst_seg, void *src_off, ramdesc_t src_seg,
 		size_t count)
@@ -92,10 +134,12 @@ void xms_fmemcpyw(void *dst_off, ramdesc_t dst_seg, void *src_off, ramdesc_t src
 		if (!need_xms_dst) dst_seg <<= 4;
 
 #ifndef CONFIG_FS_XMS_INT15
-		linear32_fmemcpyw(dst_off, dst_seg, src_off, src_seg, count);
-#else
-		int15_fmemcpyw(dst_off, dst_seg, src_off, src_seg, count);
+		if (xms_enabled == XMS_COPY_UNREAL) {
+			linear32_fmemcpyw(dst_off, dst_seg, src_off, src_seg, count);
+			return;
+		}
 #endif
+		int15_fmemcpyw(dst_off, dst_seg, src_off, src_seg, count);
 		return;
 	}
 	fmemcpyw(dst_off, (seg_t)dst_seg, src_off, (seg_t)src_seg, count);
@@ -114,8 +158,11 @@ void xms_fmemcpyb(void *dst_off, ramdesc_t dst_seg, void *src_off, ramdesc_t src
 		if (!need_xms_dst) dst_seg <<= 4;
 
 #ifndef CONFIG_FS_XMS_INT15
-		linear32_fmemcpyb(dst_off, dst_seg, src_off, src_seg, count);
-#else
+		if (xms_enabled == XMS_COPY_UNREAL) {
+			linear32_fmemcpyb(dst_off, dst_seg, src_off, src_seg, count);
+			return;
+		}
+#endif
 		/* lots of extra work on odd transfers because INT 15 block moves words only */
 		size_t wc = count >> 1;
 		if (count & 1) {
@@ -140,13 +187,11 @@ void xms_fmemcpyb(void *dst_off, ramdesc_t dst_seg, void *src_off, ramdesc_t src
 			return;
 		}
 		int15_fmemcpyw(dst_off, dst_seg, src_off, src_seg, wc);
-#endif
 		return;
 	}
 	fmemcpyb(dst_off, (seg_t)dst_seg, src_off, (seg_t)src_seg, count);
 }
 
-/* memset XMS or far memory, INT 15 not yet supported */
 void xms_fmemset(void *dst_off, ramdesc_t dst_seg, byte_t val, size_t count)
 {
 	int	need_xms_dst = dst_seg >> 16;
@@ -154,17 +199,18 @@ void xms_fmemset(void *dst_off, ramdesc_t dst_seg, byte_t val, size_t count)
 	if (need_xms_dst) {
 		if (!xms_enabled) panic("xms_fmemset");
 
-#ifdef CONFIG_FS_XMS_INT15
-		panic("xms_fmemset int15");
-#else
-		linear32_fmemset(dst_off, dst_seg, val, count);
+#ifndef CONFIG_FS_XMS_INT15
+		if (xms_enabled == XMS_COPY_UNREAL) {
+			linear32_fmemset(dst_off, dst_seg, val, count);
+			return;
+		}
 #endif
+		int15_fmemset(dst_off, dst_seg, val, count);
 		return;
 	}
 	fmemsetb(dst_off, (seg_t)dst_seg, val, count);
 }
 
-#ifdef CONFIG_FS_XMS_INT15
 struct gdt_table {
 	word_t	limit_15_0;
 	word_t	base_15_0;
@@ -176,35 +222,131 @@ struct gdt_table {
 
 static struct gdt_table gdt_table[8];
 
-/* move words between XMS and main memory using BIOS INT 15h AH=87h block move */
-void int15_fmemcpyw(void *dst_off, addr_t dst_seg, void *src_off, addr_t src_seg,
+#define INT15_MAX_WORDS	0x8000U		/* 64K descriptor limit per block move */
+
+/* set up source and destination descriptors once, only the bases change per move */
+static void int15_init(void)
+{
+	struct gdt_table *gp;
+
+	for (gp = &gdt_table[2]; gp <= &gdt_table[3]; gp++) {
+		gp->limit_15_0 = 0xffff;
+		gp->access_byte = 0x93;		/* present, ring 0, data, expand-up, writable, accessed */
+		//gp->flags_limit_19_16 = 0;	/* byte-granular, 16-bit, limit=64K */
+		//gp->flags_limit_19_16 = 0xCF;	/* page-granular, 32-bit, limit=4GB */
+	}
+}
+
+/*
+ * Move words between XMS and main memory using BIOS INT 15h AH=87h block move.
+ * Each BIOS call switches to protected mode and back, so the entire transfer is
+ * done in as few calls as the 64K descriptor limit allows.
+ */
+static void int15_fmemcpyw(void *dst_off, addr_t dst_seg, void *src_off, addr_t src_seg,
 		size_t count)
 {
 	struct gdt_table *gp;
-	memset(gdt_table, 0, sizeof(gdt_table));
+	size_t n;
 
 	src_seg += (word_t)src_off;
 	dst_seg += (word_t)dst_off;
 
-	gp = &gdt_table[2];		/* source descriptor*/
-	gp->limit_15_0 = 0xffff;
-	gp->base_15_0 = (word_t)src_seg;
-	gp->base_23_16 = src_seg >> 16;
-	gp->access_byte = 0x93;		/* present, rignt 0, data, expand-up, writable, accessed */
-	//gp->flags_limit_19_16 = 0;	/* byte-granular, 16-bit, limit=64K */
-	//gp->flags_limit_19_16 = 0xCF;	/* page-granular, 32-bit, limit=4GB */
-	gp->base_31_24 = src_seg >> 24;
-
-	gp = &gdt_table[3];		/* dest descriptor*/
-	gp->limit_15_0 = 0xffff;
-	gp->base_15_0 = (word_t)dst_seg;
-	gp->base_23_16 = dst_seg >> 16;
-	gp->access_byte = 0x93;		/* present, rignt 0, data, expand-up, writable, accessed */
-	//gp->flags_limit_19_16 = 0;	/* byte-granular, 16-bit, limit=64K */
-	//gp->flags_limit_19_16 = 0xCF;	/* page-granular, 32-bit, limit=4GB */
-	gp->base_31_24 = dst_seg >> 24;
-	block_move(gdt_table, count);
+	while (count) {
+		n = count > INT15_MAX_WORDS? INT15_MAX_WORDS: count;
+
+		/* BIOS fills in the GDT, code and stack descriptors */
+		memset(&gdt_table[0], 0, 2 * sizeof(struct gdt_table));
+		memset(&gdt_table[4], 0, 4 * sizeof(struct gdt_table));
+
+		gp = &gdt_table[2];		/* source descriptor*/
+		gp->base_15_0 = (word_t)src_seg;
+		gp->base_23_16 = src_seg >> 16;
+		gp->base_31_24 = src_seg >> 24;
+
+		gp = &gdt_table[3];		/* dest descriptor*/
+		gp->base_15_0 = (word_t)dst_seg;
+		gp->base_23_16 = dst_seg >> 16;
+		gp->base_31_24 = dst_seg >> 24;
+		block_move(gdt_table, n);
+
+		src_seg += (addr_t)n << 1;
+		dst_seg += (addr_t)n << 1;
+		count -= n;
+	}
 }
+
+/* set XMS memory using block moves from a filled buffer in the kernel data segment */
+static void int15_fmemset(void *dst_off, addr_t dst_seg, byte_t val, size_t count)
+{
+	static word_t fill[64];
+	addr_t kernel_ds_32 = (addr_t)kernel_ds << 4;
+	size_t n;
+
+	memset(fill, val, sizeof(fill));
+	dst_seg += (word_t)dst_off;
+	while (count > 1) {
+		n = count >> 1;
+		if (n > sizeof(fill)/2)
+			n = sizeof(fill)/2;
+		int15_fmemcpyw(0, dst_seg, fill, kernel_ds_32, n);
+		dst_seg += n << 1;
+		count -= n << 1;
+	}
+	if (count) {				/* odd final byte, read-modify-write */
+		int15_fmemcpyw(fill, kernel_ds_32, 0, dst_seg, 1);
+		*(byte_t *)fill = val;
+		int15_fmemcpyw(0, dst_seg, fill, kernel_ds_32, 1);
+	}
+}
+
+/*
+ * Time copying kbytes 1K blocks to and back from XMS using the active copy method,
+ * the same transfer done by the buffer cache between L1 and L2 buffers,
+ * or main memory to main memory for comparison.
+ */
+int xms_bench(struct xms_bench *b)
+{
+	static ramdesc_t bench_xms;	/* never freed, reused by later benchmarks */
+	segment_s *seg;
+	addr_t conv, xms;
+	unsigned int i;
+	jiff_t start;
+
+	if (!xms_enabled)
+		return -ENODEV;
+	/* only the method set up by xms_init, the other has no GDT or tears down unreal mode */
+	if (b->method != XMS_COPY_FAR && b->method != xms_enabled)
+		return -EINVAL;
+	seg = seg_alloc(2 * (BLOCK_SIZE >> 4), SEG_FLAG_EXTBUF);
+	if (!seg)
+		return -ENOMEM;
+	if (!bench_xms)
+		bench_xms = xms_alloc(BLOCK_SIZE);
+	conv = (addr_t)seg->base << 4;
+	xms = bench_xms;
+
+	start = jiffies;
+	for (i = 0; i < b->kbytes; i++) {
+		switch (b->method) {
+		case XMS_COPY_FAR:		/* main memory to main memory */
+			fmemcpyw((char *)BLOCK_SIZE, seg->base, 0, seg->base, BLOCK_SIZE/2);
+			fmemcpyw(0, seg->base, (char *)BLOCK_SIZE, seg->base, BLOCK_SIZE/2);
+			break;
+#ifndef CONFIG_FS_XMS_INT15
+		case XMS_COPY_UNREAL:
+			linear32_fmemcpyw(0, xms, 0, conv, BLOCK_SIZE/2);
+			linear32_fmemcpyw(0, conv, 0, xms, BLOCK_SIZE/2);
+			break;
 #endif
+		case XMS_COPY_INT15:
+			int15_fmemcpyw(0, xms, 0, conv, BLOCK_SIZE/2);
+			int15_fmemcpyw(0, conv, 0, xms, BLOCK_SIZE/2);
+			break;
+		}
+	}
+	b->ticks = jiffies - start;
+	seg_put(seg);
+	return 0;
+}
 
 #endif /* CONFIG_FS_XMS_BUFFER */
@@ -11,6 +11,17 @@
 #include <linuxmt/fcntl.h>
 #include <linuxmt/debug.h>
 
+#ifdef CONFIG_BLK_DEV_CHAR
+/*
+ * O_DIRECT on a raw block device: whole aligned blocks are transferred
+ * between the device and the user buffer without passing through the
+ * buffer cache. Partial blocks still use the cache.
+ */
+#define RAW_DIRECT(inode,filp,count) \
+    (((filp)->f_flags & O_DIRECT) && !(inode)->i_op->getblk && \
+     !(((size_t)(filp)->f_pos) & (BLOCK_SIZE - 1)) && (count) >= BLOCK_SIZE)
+#endif
+
 size_t block_read(struct inode *inode, struct file *filp, char *buf, size_t count)
 {
 #if defined(CONFIG_MINIX_FS) || defined(CONFIG_BLK_DEV_CHAR)
@@ -31,10 +42,20 @@ size_t block_read(struct inode *inode, struct file *filp, char *buf, size_t coun
     while (count > 0) {
 	register struct buffer_head *bh;
 
+	chars = (filp->f_pos >> BLOCK_SIZE_BITS);
+#ifdef CONFIG_BLK_DEV_CHAR
+	if (RAW_DIRECT(inode, filp, count)) {
+	    if (raw_rw_block(READ, inode->i_rdev, (block_t)chars, buf, current->t_regs.ds)) {
+		if (!read) read = -EIO;
+		break;
+	    }
+	    chars = BLOCK_SIZE;
+	    goto next;
+	}
+#endif
 	/*
 	 *      Read the block in
 	 */
-	chars = (filp->f_pos >> BLOCK_SIZE_BITS);
 	if (inode->i_op->getblk) {
 	    bh = inode->i_op->getblk(inode, (block_t)chars, 0);
 	} else {
@@ -53,6 +74,9 @@ size_t block_read(struct inode *inode, struct file *filp, char *buf, size_t coun
 		buffer_seg(bh), chars);
 	    brelse(bh);
 	} else fmemsetb(buf, current->t_regs.ds, 0, chars);
+#ifdef CONFIG_BLK_DEV_CHAR
+      next:
+#endif
 	buf += chars;
 	filp->f_pos += chars;
 	read += chars;
@@ -82,6 +106,16 @@ size_t block_write(struct inode *inode, struct file *filp, char *buf, size_t cou
 	register struct buffer_head *bh;
 
 	chars = (filp->f_pos >> BLOCK_SIZE_BITS);
+#ifdef CONFIG_BLK_DEV_CHAR
+	if (RAW_DIRECT(inode, filp, count)) {
+	    if (raw_rw_block(WRITE, inode->i_rdev, (block_t)chars, buf, current->t_regs.ds)) {
+		if (!written) written = -EIO;
+		break;
+	    }
+	    chars = BLOCK_SIZE;
+	    goto next;
+	}
+#endif
 	if (inode->i_op->getblk) {
 	    bh = inode->i_op->getblk(inode, (block_t)chars, 1);
 	} else {
@@ -113,6 +147,9 @@ size_t block_write(struct inode *inode, struct file *filp, char *buf, size_t cou
 	mark_buffer_uptodate(bh, 1);
 	mark_buffer_dirty(bh);
 	brelse(bh);
+#ifdef CONFIG_BLK_DEV_CHAR
+      next:
+#endif
 	buf += chars;
 	filp->f_pos += chars;
 	written += chars;
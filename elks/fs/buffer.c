@@ -25,7 +25,11 @@
 /* Number of internal L1 buffers, used to map/copy external L2 buffers
    to/from kernel data segment. */
 int nr_map_bufs = NR_MAPBUFS;                   /* override with /bootopts cache= */
+#if defined(CONFIG_FS_EXTERNAL_BUFFER) || defined(CONFIG_FS_XMS_BUFFER)
+#define MAX_NR_MAPBUFS  48      /* L1 pool grows to this while near heap is available */
+#else
 #define MAX_NR_MAPBUFS  20
+#endif
 
 #ifdef CONFIG_FS_EXTERNAL_BUFFER
 int nr_ext_bufs = CONFIG_FS_NR_EXT_BUFFERS;     /* override with /bootopts buf= */
@@ -48,7 +52,7 @@ ext_buffer_head *EBH(struct buffer_head *bh)
 }
 
 /* functions for buffer_head points called outside of buffer.c */
-void mark_buffer_dirty(struct buffer_head *bh)     { EBH(bh)->b_dirty = 1; }
+void mark_buffer_dirty(struct buffer_head *bh)     { EBH(bh)->b_dirty = EBH(bh)->b_L1dirty = 1; }
 void mark_buffer_clean(struct buffer_head *bh)     { EBH(bh)->b_dirty = 0; }
 unsigned char buffer_count(struct buffer_head *bh) { return EBH(bh)->b_count; }
 block32_t buffer_blocknr(struct buffer_head *bh)   { return EBH(bh)->b_blocknr; }
@@ -56,8 +60,6 @@ kdev_t buffer_dev(struct buffer_head *bh)          { return EBH(bh)->b_dev; }
 
 #endif /* CONFIG_FAR_BUFHEADS */
 
-/* Internal L1 buffers, allocated from kernel near heap, must be DS addressable */
-static char *L1buf;
 
 /* Buffer cache */
 static struct buffer_head *bh_lru;      /* least recently used - reused/flushed first */
@@ -76,12 +78,25 @@ static struct buffer_head *bh_next;
  * Number of extended/xms  (L2) buffers specified in config by CONFIG_FS_NR_XMS_BUFFERS
  */
 #if defined(CONFIG_FS_EXTERNAL_BUFFER) || defined(CONFIG_FS_XMS_BUFFER)
+/*
+ * Internal L1 buffers, allocated from kernel near heap, must be DS addressable.
+ * The pool starts at nr_map_bufs and only grows, up to MAX_NR_MAPBUFS, when every
+ * area is mapped or locked and the near heap has room. Areas are given back when
+ * a heap allocation fails. Unmapped L1 buffers are reused least recently used
+ * first, and only copied back to L2 when modified.
+ */
+static char *L1buf[MAX_NR_MAPBUFS];               /* L1 buffer areas */
 static struct buffer_head *L1map[MAX_NR_MAPBUFS]; /* L1 indexed pointer to L2 buffer */
+static unsigned int L1age[MAX_NR_MAPBUFS];        /* L1clock at last map, for LRU */
+static unsigned int L1clock;
+static int min_map_bufs;                          /* initial L1 pool size */
+static int L1growing;                             /* no shrink during grow_L1 */
+static int shrink_L1(void);
 static struct wait_queue L1wait;                  /* Wait for a free L1 buffer area */
-static int lastL1map;
+#define L1_HEAP_RESERVE (4 * BLOCK_SIZE)          /* near heap left free when growing */
 #endif
 static int xms_enabled;
-static int map_count, remap_count, unmap_count;
+int map_count, remap_count, unmap_count, clean_count;  /* L1 statistics for sysctl */
 
 static int nr_free_bh, nr_bh;
 #ifdef CHECK_FREECNTS
@@ -178,11 +193,21 @@ static void list_buffer_status(void)
         if (isinuse) inuse++;
     } while ((bh = ebh->b_prev_lru) != NULL);
     printk("\nTotal L2 buffers inuse %d/%d (%d free)", inuse, nr_bh, nr_free_bh);
-    printk(", %dk L1 (map %u, unmap %u remap %u)\n",
-        nr_map_bufs, map_count, unmap_count, remap_count);
+    printk(", %dk L1 (map %u, unmap %u remap %u clean %u)\n",
+        nr_map_bufs, map_count, unmap_count, remap_count, clean_count);
 }
 #endif
 
+#ifdef CONFIG_BLK_DEV_CHAR
+/* one extra buffer head without data is reserved for O_DIRECT raw I/O */
+#define NR_BUFHEADS(n)  ((n) + 1)
+static struct buffer_head *raw_bh;
+static struct wait_queue raw_wait;
+static char raw_busy;
+#else
+#define NR_BUFHEADS(n)  (n)
+#endif
+
 int INITPROC buffer_init(void)
 {
     if (nr_map_bufs > MAX_NR_MAPBUFS) nr_map_bufs = MAX_NR_MAPBUFS;
@@ -203,6 +228,14 @@ int INITPROC buffer_init(void)
     if (bufs_to_alloc > 256) bufs_to_alloc = 256; /* protect against high XMS value*/
 #endif
 
+#ifdef CONFIG_SEG_SWAP
+    if (xms_enabled)
+        seg_swap_init();
+#endif
+#ifdef CONFIG_FS_XMS_BUFFER
+    if (xms_enabled && (long_t)bufs_to_alloc > (xms_avail() >> BLOCK_SIZE_BITS))
+        bufs_to_alloc = (int)(xms_avail() >> BLOCK_SIZE_BITS);   /* installed XMS */
+#endif
     printk("%d %s buffers (%dK ram), %dK cache, %d req hdrs\n", bufs_to_alloc,
         xms_enabled? "xms": "ext", bufs_to_alloc, nr_map_bufs, NR_REQUEST);
 #else
@@ -214,20 +247,32 @@ int INITPROC buffer_init(void)
     debug_setcallback(1, list_buffer_status);   /* ^O will generate buffer list */
 #endif
 
-    if (!(L1buf = heap_alloc(nr_map_bufs * BLOCK_SIZE, HEAP_TAG_BUFHEAD|HEAP_TAG_CLEAR)))
-        return 1;
+#if defined(CONFIG_FS_EXTERNAL_BUFFER) || defined(CONFIG_FS_XMS_BUFFER)
+    for (min_map_bufs = 0; min_map_bufs < nr_map_bufs; min_map_bufs++) {
+        if (!(L1buf[min_map_bufs] = heap_alloc(BLOCK_SIZE, HEAP_TAG_BUFHEAD)))
+            return 1;
+    }
+    heap_reclaim = shrink_L1;
+#else
+    char *L1buf = heap_alloc(nr_map_bufs * BLOCK_SIZE, HEAP_TAG_BUFHEAD|HEAP_TAG_CLEAR);
+    if (!L1buf) return 1;
+#endif
 
-    buffer_heads = heap_alloc(bufs_to_alloc * sizeof(struct buffer_head),
+    buffer_heads = heap_alloc(NR_BUFHEADS(bufs_to_alloc) * sizeof(struct buffer_head),
         HEAP_TAG_BUFHEAD|HEAP_TAG_CLEAR);
     if (!buffer_heads) return 1;
 #ifdef CONFIG_FAR_BUFHEADS
-    size_t size = bufs_to_alloc * sizeof(ext_buffer_head);
+    size_t size = NR_BUFHEADS(bufs_to_alloc) * sizeof(ext_buffer_head);
     segment_s *seg = seg_alloc((size + 15) >> 4, SEG_FLAG_EXTBUF);
     if (!seg) return 1;
     fmemsetw(0, seg->base, 0, size >> 1);
     ext_buffer_heads = _MK_FP(seg->base, 0);
 #endif
     bh_next = bh_lru = bh_llru = buffer_heads;
+#ifdef CONFIG_BLK_DEV_CHAR
+    raw_bh = buffer_heads + nr_bh;      /* extra head, never on LRU list */
+    EBH(raw_bh)->b_dev = NODEV;
+#endif
 
 #if defined(CONFIG_FS_EXTERNAL_BUFFER) || defined(CONFIG_FS_XMS_BUFFER)
     do {
@@ -538,6 +583,79 @@ struct buffer_head *readbuf(struct buffer_head *bh)
     return bh;
 }
 
+#ifdef CONFIG_ASYNCIO
+/*
+ * Start reading a block into the cache unless it's already there or in
+ * progress, and release it without waiting for the I/O to complete.
+ */
+void bread_ahead(kdev_t dev, block32_t block)
+{
+    struct buffer_head *bh = getblk32(dev, block);
+    ext_buffer_head *ebh = EBH(bh);
+
+    if (!ebh->b_uptodate && !ebh->b_locked)
+        ll_rw_blk(READ, bh);
+    DCR_COUNT(ebh);
+}
+#endif
+
+#ifdef CONFIG_BLK_DEV_CHAR
+/*
+ * Read or write a whole block directly between a block device and buf:seg,
+ * bypassing the L1/L2 buffers (O_DIRECT). If the block is already cached,
+ * the cached copy is used and written through instead, so the cache never
+ * holds data older than the device. Returns 0 or -EIO.
+ */
+int raw_rw_block(int rw, kdev_t dev, block32_t block, char *buf, ramdesc_t seg)
+{
+    struct buffer_head *bh;
+    ext_buffer_head *ebh;
+    int ret = 0;
+
+    while (raw_busy)
+        sleep_on(&raw_wait);
+    raw_busy = 1;
+
+    if ((bh = find_buffer(dev, block)) != NULL) {
+        ebh = EBH(bh);
+        INR_COUNT(ebh);
+        wait_on_buffer(bh);
+        if (!ebh->b_uptodate) {         /* stale header, nothing cached */
+            brelse(bh);
+            bh = NULL;
+        }
+    }
+
+    if (bh) {
+        if (rw == READ) {
+            xms_fmemcpyb(buf, seg, buffer_data(bh), buffer_seg(bh), BLOCK_SIZE);
+            brelse(bh);
+        } else {
+            xms_fmemcpyb(buffer_data(bh), buffer_seg(bh), buf, seg, BLOCK_SIZE);
+            mark_buffer_dirty(bh);
+            ll_rw_blk(WRITE, bh);
+            wait_on_buffer(bh);
+            if (!ebh->b_uptodate) ret = -EIO;
+            brelse(bh);
+        }
+    } else {
+        ebh = EBH(raw_bh);
+        ebh->b_dev = dev;
+        ebh->b_blocknr = block;
+        ebh->b_uptodate = 0;
+        ebh->b_dirty = (rw == WRITE);
+        ll_rw_raw(rw, raw_bh, buf, seg);
+        wait_on_buffer(raw_bh);
+        if (!ebh->b_uptodate) ret = -EIO;
+        ebh->b_dev = NODEV;
+    }
+
+    raw_busy = 0;
+    wake_up(&raw_wait);
+    return ret;
+}
+#endif
+
 /*
  * bread() reads a specified block and returns the buffer that contains
  * it. It returns NULL if the block was unreadable.
@@ -634,7 +752,7 @@ void zero_buffer(struct buffer_head *bh, size_t offset, int count)
 #else
 #define FORCEMAP 0
 #endif
-    /* xms int15 doesn't support a memset function, so map into L1 */
+    /* xms int15 memset requires many block moves, so map into L1 */
     if (FORCEMAP || bh->b_data) {
         map_buffer(bh);
         memset(bh->b_data + offset, 0, count);
@@ -649,6 +767,64 @@ void zero_buffer(struct buffer_head *bh, size_t offset, int count)
 }
 
 #if defined(CONFIG_FS_EXTERNAL_BUFFER) || defined(CONFIG_FS_XMS_BUFFER)
+/* add an L1 buffer area if near heap has room, returns index or -1 */
+static int grow_L1(void)
+{
+    word_t total, largest;
+    char *p;
+
+    if (nr_map_bufs >= MAX_NR_MAPBUFS)
+        return -1;
+    heap_free_size(&total, &largest);
+    if (total < BLOCK_SIZE + L1_HEAP_RESERVE || largest < BLOCK_SIZE + sizeof(heap_s))
+        return -1;
+    L1growing = 1;
+    p = heap_alloc(BLOCK_SIZE, HEAP_TAG_BUFHEAD);
+    L1growing = 0;
+    if (!p)
+        return -1;
+    L1buf[nr_map_bufs] = p;
+    L1map[nr_map_bufs] = 0;
+    debug_map("GROW: L%02d\n", nr_map_bufs+1);
+    return nr_map_bufs++;
+}
+
+/*
+ * Give back the least recently used free L1 buffer area, called by heap_alloc
+ * when the near heap is short. Returns 1 if an area was freed.
+ */
+static int shrink_L1(void)
+{
+    int i, lru = -1;
+
+    if (nr_map_bufs <= min_map_bufs || L1growing)
+        return 0;
+    for (i = 0; i < nr_map_bufs; i++) {
+        if (L1map[i]) {
+            ext_buffer_head *ebh = EBH(L1map[i]);
+            if (ebh->b_mapcount || ebh->b_locked)
+                continue;
+        }
+        if (lru < 0 || !L1map[i] || (int)(L1age[i] - L1age[lru]) < 0)
+            lru = i;
+        if (!L1map[i])
+            break;
+    }
+    if (lru < 0)
+        return 0;
+    brelseL1_index(lru, 1);
+    heap_free(L1buf[lru]);
+    debug_map("SHRINK: L%02d\n", nr_map_bufs);
+
+    /* move last area down, mapped b_data pointers are unchanged */
+    i = --nr_map_bufs;
+    L1buf[lru] = L1buf[i];
+    L1map[lru] = L1map[i];
+    L1age[lru] = L1age[i];
+    L1map[i] = 0;
+    return 1;
+}
+
 /* map_buffer copies a buffer into L1 buffer space. It will freeze forever
  * before failing, so it can return void.  This is mostly 8086 dependant,
  * although the interface is not.
@@ -663,57 +839,63 @@ void map_buffer(struct buffer_head *bh)
 
     /* If buffer is already mapped, just increase the refcount and return */
     if (bh->b_data) {
-#if DEBUG_MAP
-        if (!ebh->b_mapcount) {
-            for (i=0; i<nr_map_bufs; i++) {
-                if (bh == L1map[i])
-                    break;
+        for (i=0; i<nr_map_bufs; i++) {
+            if (bh == L1map[i]) {
+                L1age[i] = ++L1clock;
+                break;
             }
-            debug_map("REMAP: L%02d block %ld\n", i+1, ebh->b_blocknr);
         }
-#endif
+        if (!ebh->b_mapcount)
+            debug_map("REMAP: L%02d block %ld\n", i+1, ebh->b_blocknr);
         remap_count++;
         goto end_map_buffer;
     }
 
-    i = lastL1map;
-    /* search for free L1 buffer or wait until one is available*/
+    /* search for free L1 buffer, else reuse least recently used, else grow pool */
     for (;;) {
-        struct buffer_head *bmap;
-        ext_buffer_head *ebmap;
+        int lru = -1;
 
-        if (++i >= nr_map_bufs) i = 0;
-        debug("map:   %d try %d\n", buf_num(bh), i);
+        for (i = 0; i < nr_map_bufs; i++) {
+            struct buffer_head *bmap;
+            ext_buffer_head *ebmap;
 
-        /* First check for the trivial case, to avoid dereferencing a null pointer */
-        if (!(bmap = L1map[i]))
-            break;
-        ebmap = EBH(bmap);
-
-        /* L1 with zero count can be unmapped and reused for this request*/
+            /* First check for the trivial case, to avoid dereferencing a null pointer */
+            if (!(bmap = L1map[i]))
+                break;
+            ebmap = EBH(bmap);
 #ifdef CHECK_BLOCKIO
-        if (ebmap->b_mapcount < 0)
-            printk("map_buffer: %d BAD mapcount %d\n", buf_num(bmap), ebmap->b_mapcount);
+            if (ebmap->b_mapcount < 0)
+                printk("map_buffer: %d BAD mapcount %d\n", buf_num(bmap), ebmap->b_mapcount);
 #endif
-        /* don't remap if I/O in progress to prevent bh/req buffer unpairing */
-        if (!ebmap->b_mapcount && !ebmap->b_locked) {
-            debug_map("UNMAP: L%02d block %ld\n", i+1, ebmap->b_blocknr);
-            brelseL1_index(i, 1);       /* Unmap/copy L1 to L2 */
-            break;
+            /* L1 with zero count can be unmapped and reused for this request,
+             * but don't remap if I/O in progress to prevent bh/req buffer unpairing */
+            if (!ebmap->b_mapcount && !ebmap->b_locked &&
+                (lru < 0 || (int)(L1age[i] - L1age[lru]) < 0))
+                lru = i;
         }
-        if (i == lastL1map) {
-            /* no free L1 buffers, must wait for L1 unmap_buffer*/
-            debug_map("MAPWAIT: block %ld\n", ebh->b_blocknr);
-            sleep_on(&L1wait);
+        if (i < nr_map_bufs)
+            break;
+        if ((i = lru) >= 0) {
+            debug_map("UNMAP: L%02d block %ld\n", i+1, EBH(L1map[i])->b_blocknr);
+            brelseL1_index(i, 1);       /* Unmap/copy L1 to L2 if modified */
+            break;
         }
+        if ((i = grow_L1()) >= 0)       /* all areas in use */
+            break;
+        /* no free L1 buffers, must wait for L1 unmap_buffer*/
+        debug_map("MAPWAIT: block %ld\n", ebh->b_blocknr);
+        sleep_on(&L1wait);
     }
 
     /* Map/copy L2 to L1 */
-    lastL1map = i;
     L1map[i] = bh;
-    bh->b_data = L1buf + (i << BLOCK_SIZE_BITS);
-    if (ebh->b_uptodate)
+    L1age[i] = ++L1clock;
+    bh->b_data = L1buf[i];
+    if (ebh->b_uptodate) {
         xms_fmemcpyw(bh->b_data, kernel_ds, 0, ebh->b_L2seg, BLOCK_SIZE/2);
+        ebh->b_L1dirty = 0;
+    } else
+        ebh->b_L1dirty = 1;         /* contents will be read or written in L1 */
     map_count++;
     debug_map("MAP:   L%02d block %ld\n", i+1, ebh->b_blocknr);
   end_map_buffer:
@@ -738,6 +920,8 @@ void unmap_buffer(struct buffer_head *bh)
 #endif
         if (--ebh->b_mapcount == 0) {
             debug("unmap: %d\n", buf_num(bh));
+            if (ebh->b_dirty)
+                ebh->b_L1dirty = 1;
             wake_up(&L1wait);
         } else
             debug("unmap_buffer: %d mapcount %d\n", buf_num(bh), ebh->b_mapcount+1);
@@ -761,9 +945,13 @@ void brelseL1_index(int i, int copyout)
     if (ebh->b_mapcount || ebh->b_locked)
         return;
     if (copyout && ebh->b_uptodate && bh->b_data) {
-        xms_fmemcpyw(0, ebh->b_L2seg, bh->b_data, kernel_ds, BLOCK_SIZE/2);
-        unmap_count++;
+        if (ebh->b_L1dirty) {
+            xms_fmemcpyw(0, ebh->b_L2seg, bh->b_data, kernel_ds, BLOCK_SIZE/2);
+            unmap_count++;
+        } else
+            clean_count++;              /* L2 already matches, skip copy */
     }
+    ebh->b_L1dirty = 0;
     bh->b_data = 0;
     L1map[i] = 0;
 }
@@ -62,6 +62,89 @@ static int execve_os2(struct inode *inode, struct file *filp, char *sptr, size_t
 static segment_s *mm_table[MAX_SEGS]; /* holds process segments until exec guaranteed */
 #endif
 
+#ifdef CONFIG_EXEC_CODE_CACHE
+/*
+ * Code segments of recently run executables are kept loaded while memory
+ * is available, so that the next exec of the same file doesn't reread,
+ * decompress and relocate its text. Each entry holds a reference to the
+ * segment, released by exec_cache_shrink() when memory runs out.
+ */
+static struct code_cache {
+    kdev_t      dev;
+    ino_t       ino;
+    __u32       mtime;
+    segment_s   *seg;
+    word_t      used;           /* LRU clock at last exec */
+} code_cache[NR_CODE_CACHE];
+static word_t code_cache_clock;
+
+static segment_s *code_cache_find(struct inode *inode)
+{
+    struct code_cache *c = code_cache;
+
+    do {
+        if (c->seg && c->ino == inode->i_ino && c->dev == inode->i_dev) {
+            if (c->mtime != inode->i_mtime) {   /* file changed since cached */
+                seg_put(c->seg);
+                c->seg = 0;
+                return 0;
+            }
+            c->used = ++code_cache_clock;
+            return c->seg;
+        }
+    } while (++c < &code_cache[NR_CODE_CACHE]);
+    return 0;
+}
+
+static void code_cache_add(struct inode *inode, segment_s *seg)
+{
+    struct code_cache *c = code_cache;
+    struct code_cache *lru = c;
+
+    do {
+        if (!c->seg) {
+            lru = c;
+            break;
+        }
+        if ((word_t)(code_cache_clock - c->used) > (word_t)(code_cache_clock - lru->used))
+            lru = c;
+    } while (++c < &code_cache[NR_CODE_CACHE]);
+
+    if (lru->seg)
+        seg_put(lru->seg);
+    lru->dev = inode->i_dev;
+    lru->ino = inode->i_ino;
+    lru->mtime = inode->i_mtime;
+    lru->seg = seg_get(seg);
+    lru->used = ++code_cache_clock;
+}
+
+/*
+ * Release the least recently used cached code segment on memory shortage.
+ * Segments still in use by a process free no memory, they are released
+ * only when inuse is set, so that compaction can then move them.
+ * Returns 1 when an entry was released, 0 when none is left.
+ */
+int exec_cache_shrink(int inuse)
+{
+    struct code_cache *c;
+    struct code_cache *lru = 0;
+
+    for (c = code_cache; c < &code_cache[NR_CODE_CACHE]; c++) {
+        if (c->seg && (inuse || c->seg->ref_count == 1) &&
+            (!lru || (word_t)(code_cache_clock - c->used) > (word_t)(code_cache_clock - lru->used)))
+                lru = c;
+    }
+    if (!lru)
+        return 0;
+
+    debug("EXEC: code cache release %x\n", lru->seg->base);
+    seg_put(lru->seg);
+    lru->seg = 0;
+    return 1;
+}
+#endif
+
 int sys_execve(const char *filename, char *sptr, size_t slen)
 {
     int retval;
@@ -129,31 +212,75 @@ int sys_execve(const char *filename, char *sptr, size_t slen)
         __w >> 3; })
 #endif
 
+#ifdef CONFIG_ROMFS_XIP
+/*
+ * Run the text of an uncompressed executable without text relocations
+ * directly from a romfs image. The text follows the header, and romfs
+ * files start on a paragraph, so it is paragraph aligned; far text must
+ * also be (mkromfs -x pads the near text for this).
+ */
+static segment_s *exec_in_place(struct inode *inode, struct minix_exec_hdr *mh,
+    struct elks_supl_hdr *esuph)
+{
+    segext_t paras = bytes_to_paras((size_t)mh->tseg);
+
+    if (!inode->i_sb || inode->i_sb->s_type->type != FST_ROMFS || (mh->hlen & 15))
+        return 0;
+    if (esuph) {
+        if (esuph->msh_trsize || esuph->esh_ftrsize
+            || esuph->esh_compr_tseg || esuph->esh_compr_ftseg)
+            return 0;
+        if (esuph->esh_ftseg) {
+            if ((size_t)mh->tseg & 15)
+                return 0;
+            paras += bytes_to_paras((size_t)esuph->esh_ftseg);
+        }
+    }
+
+    debug("EXEC: XIP text at %x\n", inode->u.romfs.seg + (mh->hlen >> 4));
+    return seg_rom(inode->u.romfs.seg + (mh->hlen >> 4), paras);
+}
+#endif
+
 #ifdef CONFIG_EXEC_MMODEL
 /*
  * Read relocations for a particular segment and apply them
  * Only IA-16 segment relocations are accepted
+ *
+ * Relocations are read in batches as large as the scratch area at buf_seg:buf
+ * allows, normally the unused part of the new data segment above its data,
+ * then applied from there.
  */
 static int relocate(seg_t place_base, unsigned long rsize, segment_s *seg_code,
-               segment_s *seg_data, struct inode *inode, struct file *filp, size_t tseg)
+               segment_s *seg_data, struct inode *inode, struct file *filp, size_t tseg,
+               seg_t buf_seg, char *buf, size_t buf_len)
 {
     int retval = 0;
     seg_t save_ds = current->t_regs.ds;
-    struct minix_reloc reloc;   //FIXME too large
-    word_t val;
+    size_t n;
+    char *r;
+    word_t val, vaddr;
 
     if ((int)rsize % sizeof(struct minix_reloc))
         return -EINVAL;
-    current->t_regs.ds = kernel_ds;
+    buf_len -= buf_len % sizeof(struct minix_reloc);
+    current->t_regs.ds = buf_seg;
     debug_reloc("EXEC: applying %04lx bytes of relocations to segment %x\n",
            (unsigned long)rsize, place_base);
     while (rsize >= sizeof(struct minix_reloc)) {
-        retval = filp->f_op->read(inode, filp, (char *)&reloc, sizeof(reloc));
-        if (retval != sizeof(reloc))
+        n = (rsize > buf_len)? buf_len: (size_t)rsize;
+        retval = filp->f_op->read(inode, filp, buf, n);
+        if (retval != n)
             goto error;
-        switch (reloc.r_type) {
-        case R_SEGWORD:
-            switch (reloc.r_symndx) {
+        for (r = buf; r < buf + n; r += sizeof(struct minix_reloc)) {
+            struct minix_reloc *reloc = (struct minix_reloc *)r;
+
+            if (peekw((word_t)&reloc->r_type, buf_seg) != R_SEGWORD) {
+                debug_reloc("EXEC: bad relocation type 0x%x\n",
+                    peekw((word_t)&reloc->r_type, buf_seg));
+                goto error;
+            }
+            switch (peekw((word_t)&reloc->r_symndx, buf_seg)) {
             case S_TEXT:
                 val = seg_code->base; break;
             case S_FTEXT:
@@ -161,19 +288,16 @@ static int relocate(seg_t place_base, unsigned long rsize, segment_s *seg_code,
             case S_DATA:
                 val = seg_data->base; break;
             default:
-                debug_reloc("EXEC: bad relocation symbol index 0x%x\n", reloc.r_symndx);
+                debug_reloc("EXEC: bad relocation symbol index 0x%x\n",
+                    peekw((word_t)&reloc->r_symndx, buf_seg));
                 goto error;
             }
-            debug_reloc("EXEC: reloc %d,%d,%04x:%04x %04x -> %04x\n",
-                reloc.r_type, reloc.r_symndx, place_base, (word_t)reloc.r_vaddr,
-                peekw((word_t)reloc.r_vaddr, place_base), val);
-            pokew((word_t)reloc.r_vaddr, place_base, val);
-            break;
-        default:
-            debug_reloc("EXEC: bad relocation type 0x%x\n", reloc.r_type);
-            goto error;
+            vaddr = peekw((word_t)&reloc->r_vaddr, buf_seg);
+            debug_reloc("EXEC: reloc %04x:%04x %04x -> %04x\n",
+                place_base, vaddr, peekw(vaddr, place_base), val);
+            pokew(vaddr, place_base, val);
         }
-        rsize -= sizeof(struct minix_reloc);
+        rsize -= n;
     }
     current->t_regs.ds = save_ds;
     return 0;
@@ -197,10 +321,15 @@ static int execve_aout(struct inode *inode, struct file *filp, char *sptr, size_
     size_t len, min_len, heap, stack = 0;
     size_t bytes;
     segext_t paras;
+    int new_code = 0;
     ASYNCIO_REENTRANT struct minix_exec_hdr mh;         /* 32 bytes */
 #ifdef CONFIG_EXEC_MMODEL
     ASYNCIO_REENTRANT struct elks_supl_hdr esuph;       /* 24 bytes */
+    ASYNCIO_REENTRANT struct minix_reloc reloc;         /* fallback relocation buffer */
     int need_reloc_code = 1;
+    seg_t reloc_seg;
+    char *reloc_buf;
+    size_t reloc_len;
 #endif
 
     /* (Re)read the header */
@@ -221,13 +350,20 @@ static int execve_aout(struct inode *inode, struct file *filp, char *sptr, size_
     seg_code = 0;
     currentp = &task[0];
     do {
-        if ((currentp->state <= TASK_STOPPED) && (currentp->t_inode == inode)) {
+        if ((currentp->state <= TASK_STOPPED) && (currentp->t_inode == inode)
+            && !(currentp->mm[SEG_CODE]->flags & SEG_FLAG_SWAPPED)) {
             debug("EXEC found copy\n");
             seg_code = currentp->mm[SEG_CODE];
             break;
         }
     } while (++currentp < &task[max_tasks]);
     currentp = current;
+#ifdef CONFIG_EXEC_CODE_CACHE
+    if (!seg_code)
+        seg_code = code_cache_find(inode);
+    else
+        code_cache_find(inode);                 /* update LRU */
+#endif
 
     min_len = (size_t)mh.dseg;
     if (add_overflow(min_len, (size_t)mh.bseg, &min_len)) {
@@ -370,6 +506,18 @@ static int execve_aout(struct inode *inode, struct file *filp, char *sptr, size_
     /*
      *      Looks good. Get the memory we need
      */
+#ifdef CONFIG_ROMFS_XIP
+#ifdef CONFIG_EXEC_MMODEL
+    if (!seg_code && (seg_code = exec_in_place(inode, &mh, &esuph)) != NULL) {
+        filp->f_pos += (size_t)mh.tseg + (size_t)esuph.esh_ftseg;
+        need_reloc_code = 0;            /* checked none */
+#else
+    if (!seg_code && (seg_code = exec_in_place(inode, &mh, NULL)) != NULL) {
+        filp->f_pos += (size_t)mh.tseg;
+#endif
+        new_code = 1;
+    } else
+#endif
     if (!seg_code) {
         bytes = (size_t)mh.tseg;
         paras = bytes_to_paras(bytes);
@@ -388,6 +536,7 @@ static int execve_aout(struct inode *inode, struct file *filp, char *sptr, size_
             bytes);
         seg_code = seg_alloc(paras, SEG_FLAG_CSEG);
         if (!seg_code) goto error_exec3;
+        new_code = 1;
         currentp->t_regs.ds = seg_code->base;
         retval = filp->f_op->read(inode, filp, 0, bytes);
         if (retval != bytes) {
@@ -461,16 +610,25 @@ static int execve_aout(struct inode *inode, struct file *filp, char *sptr, size_
 #endif
 
 #ifdef CONFIG_EXEC_MMODEL
+    /* Use the data segment above data as relocation buffer, bss is cleared later */
+    reloc_seg = seg_data->base;
+    reloc_buf = (char *)(((size_t)mh.dseg + base_data + 1) & ~1);
+    reloc_len = len - (size_t)reloc_buf;
+    if ((size_t)reloc_buf >= len || reloc_len < sizeof(struct minix_reloc)) {
+        reloc_seg = kernel_ds;
+        reloc_buf = (char *)&reloc;
+        reloc_len = sizeof(reloc);
+    }
     if (need_reloc_code) {
         /* Read and apply text segment relocations */
         retval = relocate(seg_code->base, esuph.msh_trsize, seg_code, seg_data,
-                          inode, filp, mh.tseg);
+                          inode, filp, mh.tseg, reloc_seg, reloc_buf, reloc_len);
         if (retval != 0)
             goto error_exec5;
         /* Read and apply far text segment relocations */
         retval = relocate(seg_code->base + bytes_to_paras((size_t)mh.tseg),
                           esuph.esh_ftrsize, seg_code, seg_data,
-                          inode, filp, mh.tseg);
+                          inode, filp, mh.tseg, reloc_seg, reloc_buf, reloc_len);
         if (retval != 0)
             goto error_exec5;
     } else {
@@ -480,9 +638,15 @@ static int execve_aout(struct inode *inode, struct file *filp, char *sptr, size_
     }
     /* Read and apply data relocations */
     retval = relocate(seg_data->base, esuph.msh_drsize, seg_code, seg_data,
-                      inode, filp, mh.tseg);
+                      inode, filp, mh.tseg, reloc_seg, reloc_buf, reloc_len);
     if (retval != 0)
         goto error_exec5;
+
+    /* Segment values are now stored in the image, pin both segments */
+    if (esuph.msh_trsize || esuph.esh_ftrsize || esuph.msh_drsize) {
+        seg_code->flags |= SEG_FLAG_FIXED;
+        seg_data->flags |= SEG_FLAG_FIXED;
+    }
 #endif
 
     /* From this point, exec() will surely succeed */
@@ -504,6 +668,11 @@ static int execve_aout(struct inode *inode, struct file *filp, char *sptr, size_
 #endif
     fmemcpyb((char *)currentp->t_begstack, seg_data->base, sptr, ds, slen);
 
+#ifdef CONFIG_EXEC_CODE_CACHE
+    if (new_code)
+        code_cache_add(inode, seg_code);
+#endif
+
     finalize_exec(inode, seg_code, seg_data, (word_t)mh.entry, 0);
     return 0;           /* success */
 
@@ -691,6 +860,7 @@ static int execve_os2(struct inode *inode, struct file *filp, char *sptr, size_t
             retval = -ENOMEM;
             goto errout2;
         }
+        mm_table[seg]->flags |= SEG_FLAG_FIXED; /* relocations hold segment values */
         if (seg+1 == os2hdr.reg_cs)             /* save entry code segment */
             seg_code = mm_table[seg];
         if (seg+1 == os2hdr.auto_data_segment)  /* save auto data segment */
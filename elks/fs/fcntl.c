@@ -80,12 +80,16 @@ int sys_fcntl(unsigned int fd, unsigned int cmd, unsigned int arg)
 	 * cannot be cleared
 	 */
 	if (!IS_APPEND(filp->f_inode) || (arg & O_APPEND)) {
-	    filp->f_flags &= ~(O_APPEND | O_NONBLOCK);
-	    filp->f_flags |= arg & (O_APPEND | O_NONBLOCK);
+	    filp->f_flags &= ~(O_APPEND | O_NONBLOCK | O_DIRECT);
+	    filp->f_flags |= arg & (O_APPEND | O_NONBLOCK | O_DIRECT);
 	    break;
 	}
 	result = -EPERM;
 	break;
+    case F_SETPIPE_SZ:
+    case F_GETPIPE_SZ:
+	result = pipe_fcntl(filp->f_inode, cmd, arg);
+	break;
     default:
 	result = -EINVAL;
     }
@@ -19,6 +19,8 @@
 #include <arch/segment.h>
 #include <arch/bitops.h>
 
+#define MINIX_READAHEAD	2	/* max contiguous blocks read ahead on a miss */
+
 /* Static functions in this file */
 
 static unsigned short map_iblock(register struct inode *,block_t,block_t,int);
@@ -75,6 +77,7 @@ void minix_put_super(register struct super_block *sb)
 	if (!(sb->s_flags & MS_RDONLY))
 		minix_set_super_state(sb, 0, sb->u.minix_sb.s_mount_state);	/* set original fs state*/
 	unlock_super(sb);
+	minix_map_invalidate(sb->s_dev);
 	sb->s_dev = 0;
 }
 
@@ -133,6 +136,8 @@ struct super_block *minix_read_super(register struct super_block *s, char *data,
     static const char *err3 = "minix: get root inode failed\n";
     static const char *err4 = "minix: inode table too large\n";
 
+    minix_map_invalidate(dev);
+
     lock_super(s);
 	if (!(bh = bread(dev, MINIX_SUPER_BLOCK))) {
 		msgerr = err1;
@@ -234,25 +239,113 @@ static unsigned short map_izone(register struct inode *inode, block_t block, int
     return *i_zone;
 }
 
+/*
+ * Indirect block map cache. Each slot holds a window of zone numbers copied
+ * from an indirect (or double indirect) block, so that sequential access to
+ * files over 7K doesn't bread and L1 map the same indirect block for every
+ * data block. Slots are keyed by device and indirect block number and
+ * shared by all inodes, which costs far less near memory than a per-inode
+ * cache. Entries allocated by map_iblock are written through; truncate and
+ * mount/umount invalidate the device's slots.
+ */
+#define NR_MAPCACHE	4		/* cached windows */
+#define MAPWIN		16		/* zone numbers per window, power of 2 */
+
+static struct mapcache {
+    kdev_t	mc_dev;
+    block_t	mc_iblock;		/* indirect block number, 0 if slot unused */
+    block_t	mc_base;		/* index in indirect block of zone[0] */
+    unsigned	mc_age;
+    __u16	mc_zone[MAPWIN];
+} mapcache[NR_MAPCACHE];
+static unsigned mapclock;
+
+void minix_map_invalidate(kdev_t dev)
+{
+    register struct mapcache *mc;
+
+    for (mc = mapcache; mc < &mapcache[NR_MAPCACHE]; mc++) {
+	if (mc->mc_dev == dev)
+	    mc->mc_iblock = 0;
+    }
+}
+
+/* Return slot holding entry block of indirect block i, else LRU slot to reload */
+static struct mapcache *find_map(kdev_t dev, block_t i, block_t block, int *found)
+{
+    register struct mapcache *mc;
+    struct mapcache *lru = mapcache;
+
+    for (mc = mapcache; mc < &mapcache[NR_MAPCACHE]; mc++) {
+	if (mc->mc_iblock == i && mc->mc_dev == dev &&
+	    block - mc->mc_base < MAPWIN) {
+	    *found = 1;
+	    mc->mc_age = ++mapclock;
+	    return mc;
+	}
+	if (mc->mc_age < lru->mc_age)
+	    lru = mc;
+    }
+    *found = 0;
+    return lru;
+}
+
+/* Write through zone b allocated for entry block of indirect block i */
+static void update_map(kdev_t dev, block_t i, block_t block, block_t b)
+{
+    register struct mapcache *mc;
+
+    for (mc = mapcache; mc < &mapcache[NR_MAPCACHE]; mc++) {
+	if (mc->mc_iblock == i && mc->mc_dev == dev &&
+	    block - mc->mc_base < MAPWIN)
+	    mc->mc_zone[block - mc->mc_base] = b;
+    }
+}
+
 static unsigned short map_iblock(struct inode *inode, block_t i,
 				 block_t block, int create)
 {
     register struct buffer_head *bh;
     register block_t *b_zone;
+    struct mapcache *mc;
+    int found;
     block_t b;
 
+    mc = find_map(inode->i_dev, i, block, &found);
+    if (found && (mc->mc_zone[block - mc->mc_base] || !create))
+	return mc->mc_zone[block - mc->mc_base];
+
     if (!(bh = bread(inode->i_dev, i))) {
 	return 0;
     }
+    if (!create) {
+	/* bread may have slept, recheck in case another task loaded the window */
+	mc = find_map(inode->i_dev, i, block, &found);
+	if (found) {
+	    brelse(bh);
+	    return mc->mc_zone[block - mc->mc_base];
+	}
+	/* load the whole window without mapping the indirect block */
+	mc->mc_dev = inode->i_dev;
+	mc->mc_iblock = i;
+	mc->mc_base = block & ~(MAPWIN - 1);
+	mc->mc_age = ++mapclock;
+	xms_fmemcpyw(mc->mc_zone, kernel_ds, buffer_data(bh) + mc->mc_base * sizeof(block_t),
+	    buffer_seg(bh), MAPWIN);
+	brelse(bh);
+	return mc->mc_zone[block - mc->mc_base];
+    }
     map_buffer(bh);
     b_zone = &(((block_t *) (bh->b_data))[block]);
-    if (create && !(*b_zone)) {
+    if (!(*b_zone)) {
 	if ((*b_zone = minix_new_block(inode->i_sb))) {
 	    mark_buffer_dirty(bh);
 	}
     }
     b = *b_zone;
     unmap_brelse(bh);
+    /* slots may have been reloaded or invalidated while sleeping, so search again */
+    update_map(inode->i_dev, i, block, b);
     return b;
 }
 
@@ -294,13 +387,50 @@ unsigned short _minix_bmap(register struct inode *inode, block_t block, int crea
     return i;
 }
 
+/*
+ * Return the number of blocks, up to max, physically following blknum
+ * that are also the next logical blocks of the file.
+ */
+static int minix_contig(struct inode *inode, block_t block, block_t blknum, int max)
+{
+    block_t nblocks = (block_t)((inode->i_size + BLOCK_SIZE - 1) >> BLOCK_SIZE_BITS);
+    int n;
+
+    for (n = 0; n < max && block + n + 1 < nblocks; n++) {
+	if (_minix_bmap(inode, block + n + 1, 0) != (block_t)(blknum + n + 1))
+	    break;
+    }
+    return n;
+}
+
 struct buffer_head *minix_getblk(register struct inode *inode, block_t block, int create)
 {
+    struct buffer_head *bh;
     unsigned short blknum;
+#ifdef CONFIG_ASYNCIO
+    int n;
+#endif
 
     if (!(blknum = _minix_bmap(inode, block, create)))
 	return NULL;
-    return getblk(inode->i_dev, (block_t) blknum);
+    bh = getblk(inode->i_dev, (block_t) blknum);
+#ifdef CONFIG_ASYNCIO
+    /*
+     * On a read miss, start reading this block and read ahead the physically
+     * contiguous blocks that follow, so that they're on the request queue
+     * together. The caller's readbuf waits for this block's I/O to complete.
+     */
+    if (!create && !EBH(bh)->b_uptodate) {
+	n = minix_contig(inode, block, blknum, MINIX_READAHEAD);
+	if (n) {
+	    ll_rw_blk(READ, bh);
+	    do {
+		bread_ahead(inode->i_dev, ++blknum);
+	    } while (--n);
+	}
+    }
+#endif
+    return bh;
 }
 
 struct buffer_head *minix_bread(struct inode *inode,
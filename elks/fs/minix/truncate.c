@@ -180,12 +180,14 @@ void minix_truncate(register struct inode *inode)
     if (!(S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode) ||
 	  S_ISLNK(inode->i_mode))) return;
     while (1) {
+	minix_map_invalidate(inode->i_dev);	/* before freeing any zones */
 	retry = V1_trunc_direct(inode);
 	retry |= V1_trunc_indirect(inode, 7, &inode->u.minix_i.i_zone[7]);
 	retry |= V1_trunc_dindirect(inode, 7 + 512, &inode->u.minix_i.i_zone[8]);
 	if (!retry) break;
 	schedule();
     }
+    minix_map_invalidate(inode->i_dev);
     inode->i_mtime = inode->i_ctime = current_time();
     inode->i_dirt = 1;
 }
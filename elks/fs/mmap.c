@@ -0,0 +1,177 @@
+/*
+ * Read-only file mapping
+ *
+ * A restricted mmap(PROT_READ, MAP_SHARED) that loads a whole file of up
+ * to 64K into a far segment and returns the segment to the process.
+ * Processes mapping the same unchanged file share one segment. Files on
+ * romfs are already in memory and are returned in place.
+ */
+
+#include <linuxmt/config.h>
+#include <linuxmt/types.h>
+#include <linuxmt/errno.h>
+#include <linuxmt/fcntl.h>
+#include <linuxmt/stat.h>
+#include <linuxmt/sched.h>
+#include <linuxmt/kernel.h>
+#include <linuxmt/fs.h>
+#include <linuxmt/mm.h>
+#include <linuxmt/mman.h>
+#include <linuxmt/debug.h>
+
+#include <arch/segment.h>
+
+/* mapped files, one per loaded segment */
+static struct mmap_file {
+    kdev_t      dev;
+    ino_t       ino;
+    __u32       mtime;
+    segment_s   *seg;
+} mmap_file[NR_MMAP];
+
+/* process mappings, each holding a reference to seg (NULL for ROM) */
+static struct mmap_ref {
+    pid_t       pid;
+    seg_t       base;
+    segment_s   *seg;
+} mmap_ref[NR_MMAP_REF];
+
+static struct mmap_file *mmap_find(struct inode *inode)
+{
+    struct mmap_file *m = mmap_file;
+
+    do {
+        if (m->seg && m->ino == inode->i_ino && m->dev == inode->i_dev
+                   && m->mtime == inode->i_mtime)
+            return m;
+    } while (++m < &mmap_file[NR_MMAP]);
+    return 0;
+}
+
+/* read the whole file into a new segment */
+static int mmap_load(struct inode *inode, struct file *filp, segment_s **pseg)
+{
+    struct mmap_file *m = mmap_file;
+    struct file file;
+    segment_s *seg;
+    seg_t ds;
+    size_t n, size = (size_t)inode->i_size;
+
+    while (m->seg)
+        if (++m >= &mmap_file[NR_MMAP])
+            return -ENFILE;
+
+    seg = seg_alloc((segext_t)((inode->i_size + 15) >> 4), SEG_FLAG_MMAP);
+    if (!seg)
+        return -ENOMEM;
+
+    /* private file struct so the caller's file position is untouched */
+    file = *filp;
+    file.f_pos = 0;
+    ds = current->t_regs.ds;
+    current->t_regs.ds = seg->base;
+    n = file.f_op->read(inode, &file, 0, size);
+    current->t_regs.ds = ds;
+    if (n != size) {
+        seg_free(seg);
+        return ((int)n < 0)? (int)n: -EIO;
+    }
+
+    m->dev = inode->i_dev;
+    m->ino = inode->i_ino;
+    m->mtime = inode->i_mtime;
+    m->seg = seg;
+    *pseg = seg;
+    debug("MMAP: load inode %u size %u seg %x\n", inode->i_ino, size, seg->base);
+    return 0;
+}
+
+static void mmap_put(struct mmap_ref *r)
+{
+    struct mmap_file *m = mmap_file;
+
+    if (r->seg) {
+        if (r->seg->ref_count == 1) {
+            do {
+                if (m->seg == r->seg)
+                    m->seg = 0;
+            } while (++m < &mmap_file[NR_MMAP]);
+        }
+        seg_put(r->seg);
+    }
+    r->pid = 0;
+    r->seg = 0;
+}
+
+int sys_mmap(unsigned int fd, int prot, int flags, seg_t *pseg)
+{
+    struct file *filp;
+    struct inode *inode;
+    struct mmap_ref *r = mmap_ref;
+    struct mmap_file *m;
+    segment_s *seg = 0;
+    seg_t base;
+    int err;
+
+    if ((err = verify_area(VERIFY_WRITE, pseg, sizeof(*pseg))) != 0)
+        return err;
+    if (prot != PROT_READ || (flags != MAP_SHARED && flags != MAP_PRIVATE))
+        return -EINVAL;
+    if (fd >= NR_OPEN || !(filp = current->files.fd[fd]) || !(inode = filp->f_inode))
+        return -EBADF;
+    if (!(filp->f_mode & FMODE_READ))
+        return -EACCES;
+    if (!S_ISREG(inode->i_mode) || !filp->f_op || !filp->f_op->read)
+        return -ENODEV;
+    if (inode->i_size == 0)
+        return -EINVAL;
+    if (inode->i_size > MMAP_MAXSIZE)
+        return -ENOMEM;
+
+    while (r->pid)
+        if (++r >= &mmap_ref[NR_MMAP_REF])
+            return -ENFILE;
+
+#ifdef CONFIG_ROMFS_FS
+    if (inode->i_sb && inode->i_sb->s_type->type == FST_ROMFS)
+        base = inode->u.romfs.seg;          /* file data is contiguous in ROM */
+    else
+#endif
+    {
+        if ((m = mmap_find(inode)) != NULL)
+            seg = seg_get(m->seg);
+        else if ((err = mmap_load(inode, filp, &seg)) < 0)
+            return err;
+        base = seg->base;
+    }
+
+    r->pid = current->pid;
+    r->base = base;
+    r->seg = seg;
+    put_user(base, pseg);
+    return 0;
+}
+
+int sys_munmap(seg_t base)
+{
+    struct mmap_ref *r = mmap_ref;
+
+    do {
+        if (r->pid == current->pid && r->base == base) {
+            mmap_put(r);
+            return 0;
+        }
+    } while (++r < &mmap_ref[NR_MMAP_REF]);
+    return -EINVAL;
+}
+
+/* release all mappings for exiting process */
+void mmap_release_pid(pid_t pid)
+{
+    struct mmap_ref *r = mmap_ref;
+
+    do {
+        if (r->pid == pid)
+            mmap_put(r);
+    } while (++r < &mmap_ref[NR_MMAP_REF]);
+}
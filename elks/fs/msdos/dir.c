@@ -211,6 +211,221 @@ int FATPROC msdos_get_entry_long(
 	return 0;
 }
 
+/*
+ * Directory name index, for fast lookups in large directories.
+ *
+ * A per-directory open addressed hash table of short or long names to the
+ * directory position msdos_get_entry_long returns for each, built on the
+ * first lookup and kept in a main memory segment. Lookups verify each
+ * candidate by rereading its entry, so positions of deleted entries left
+ * in the table are harmless. New entries are added by msdos_create_entry,
+ * and the index is dropped on rmdir of the directory or umount.
+ */
+#define NR_DIRINDEX		2	/* directories indexed at once */
+#define DIRINDEX_MINENTS	64	/* don't index directories smaller than this */
+#define DIRINDEX_MIN		128	/* hash slots */
+#define DIRINDEX_MAX		8192	/* 3 bytes each: position + check byte */
+
+static struct dirindex {
+	kdev_t		di_dev;
+	ino_t		di_ino;		/* directory inode, 0 if unused */
+	segment_s	*di_seg;	/* slot table, NULL if not indexable */
+	unsigned	di_size;	/* # slots, power of 2 */
+	unsigned	di_count;	/* # slots in use */
+	unsigned	di_age;
+	unsigned	di_gen;		/* changes whenever the table is replaced */
+	int		di_busy;	/* being built */
+} dirindex[NR_DIRINDEX];
+static unsigned index_clock, index_gen;
+
+#define DI_SLOT(di)	((unsigned short __far *)_MK_FP((di)->di_seg->base, 0))
+#define DI_CHECK(di)	((unsigned char __far *)_MK_FP((di)->di_seg->base, (di)->di_size * 2))
+
+static unsigned FATPROC name_hash(char *name, int len)
+{
+	unsigned h = len;
+
+	while (--len >= 0)
+		h = (h << 5) + h + (unsigned char)*name++;
+	return h;
+}
+
+#define CHECK_BYTE(h)	((unsigned char)((h * 40503u) >> 8))
+
+static void FATPROC index_free(struct dirindex *di)
+{
+	if (di->di_seg)
+		seg_free(di->di_seg);
+	di->di_seg = NULL;
+	di->di_ino = 0;
+	di->di_gen = ++index_gen;
+}
+
+/* Drop index of directory ino, or all directories on dev if ino is 0 */
+void FATPROC msdos_index_inval(kdev_t dev, ino_t ino)
+{
+	struct dirindex *di;
+
+	for (di = dirindex; di < &dirindex[NR_DIRINDEX]; di++) {
+		if (di->di_dev == dev && di->di_ino && (!ino || di->di_ino == ino))
+			index_free(di);
+	}
+}
+
+static struct dirindex * FATPROC index_get(struct inode *dir)
+{
+	struct dirindex *di;
+
+	for (di = dirindex; di < &dirindex[NR_DIRINDEX]; di++) {
+		if (di->di_ino == dir->i_ino && di->di_dev == dir->i_dev && !di->di_busy)
+			return di;
+	}
+	return NULL;
+}
+
+static int FATPROC index_insert(struct dirindex *di, char *name, int len, off_t dirpos)
+{
+	unsigned short __far *slot = DI_SLOT(di);
+	unsigned h, i;
+
+	if ((unsigned long)(dirpos >> MSDOS_DIR_BITS) >= 0xFFFF
+		|| di->di_count >= di->di_size - (di->di_size >> 2))
+		return -1;
+	h = name_hash(name, len);
+	for (i = h & (di->di_size - 1); slot[i]; i = (i + 1) & (di->di_size - 1))
+		continue;
+	slot[i] = (unsigned short)(dirpos >> MSDOS_DIR_BITS) + 1;
+	DI_CHECK(di)[i] = CHECK_BYTE(h);
+	di->di_count++;
+	return 0;
+}
+
+/* Build the index for a directory, leaving di_seg NULL if it can't be indexed */
+static void FATPROC index_build(struct inode *dir, struct dirindex *di)
+{
+	unsigned long ents = dir->i_size >> MSDOS_DIR_BITS;
+	struct buffer_head *bh = NULL;
+	off_t pos = 0, dirpos;
+	ino_t ino;
+	int len;
+	unsigned size;
+	ASYNCIO_REENTRANT char name[14];
+
+	for (size = DIRINDEX_MIN; size < DIRINDEX_MAX && size < ents + (ents >> 1); size <<= 1)
+		continue;
+	di->di_dev = dir->i_dev;
+	di->di_ino = dir->i_ino;
+	di->di_size = size;
+	di->di_count = 0;
+	di->di_gen = ++index_gen;
+	if (!(di->di_seg = seg_alloc((size * 3 + 15) >> 4, SEG_FLAG_EXTBUF)))
+		return;
+	fmemsetw(0, di->di_seg->base, 0, size * 3 / 2);
+
+	di->di_busy = 1;
+	while (msdos_get_entry_long(dir, &pos, &bh, name, &len, &dirpos, &ino) > 0) {
+		if (index_insert(di, name, len, dirpos) < 0) {
+			seg_free(di->di_seg);
+			di->di_seg = NULL;
+			break;
+		}
+	}
+	di->di_busy = 0;
+	if (bh)
+		unmap_brelse(bh);
+	debug_fat("index dir %lu: %u names in %u slots\n",
+		(unsigned long)dir->i_ino, di->di_count, di->di_seg? size: 0);
+}
+
+/*
+ * Look up name (in kernel space, len <= 14) using the directory index.
+ * Returns 0 with *bh and *ino set if found, -ENOENT if not present,
+ * or 1 if the directory isn't indexed and must be scanned.
+ */
+int FATPROC msdos_index_find(struct inode *dir, char *name, int len,
+	struct buffer_head **bh, ino_t *ino)
+{
+	struct dirindex *di;
+	unsigned h, i, gen;
+	unsigned short p;
+	off_t pos, dirpos;
+	int entry_len;
+	ASYNCIO_REENTRANT char entry_name[14];
+
+	if (dir->i_size < ((off_t)DIRINDEX_MINENTS << MSDOS_DIR_BITS))
+		return 1;
+#ifdef CONFIG_FS_DEV
+	if (dir->i_ino == MSDOS_SB(dir->i_sb)->dev_ino)
+		return 1;		/* compared case-insensitive */
+#endif
+	if (!(di = index_get(dir))) {
+		struct dirindex *lru = NULL;
+
+		for (di = dirindex; di < &dirindex[NR_DIRINDEX]; di++) {
+			if (di->di_ino && di->di_ino == dir->i_ino && di->di_dev == dir->i_dev)
+				return 1;	/* being built by another process */
+			if (!di->di_busy && (!lru || di->di_age < lru->di_age))
+				lru = di;
+		}
+		if (!lru)
+			return 1;
+		lock_creation();	/* no entries created while building */
+		index_free(lru);
+		index_build(dir, lru);
+		unlock_creation();
+		di = lru;
+	}
+	di->di_age = ++index_clock;
+	if (!di->di_seg)
+		return 1;
+
+	*bh = NULL;
+	gen = di->di_gen;
+	h = name_hash(name, len);
+	for (i = h & (di->di_size - 1); (p = DI_SLOT(di)[i]) != 0; i = (i + 1) & (di->di_size - 1)) {
+		if (DI_CHECK(di)[i] != CHECK_BYTE(h))
+			continue;
+		pos = (off_t)(p - 1) << MSDOS_DIR_BITS;
+		if (msdos_get_entry_long(dir, &pos, bh, entry_name, &entry_len, &dirpos, ino) > 0
+			&& dirpos == ((off_t)(p - 1) << MSDOS_DIR_BITS)
+			&& entry_len == len && !memcmp(entry_name, name, len))
+			return 0;
+		if (di->di_gen != gen) {	/* index replaced while reading entry */
+			if (*bh)
+				unmap_brelse(*bh);
+			*bh = NULL;
+			return 1;
+		}
+	}
+	if (*bh)
+		unmap_brelse(*bh);
+	*bh = NULL;
+	return -ENOENT;
+}
+
+/* Add the entry at directory position pos to the directory's index, if any */
+void FATPROC msdos_index_add(struct inode *dir, off_t pos)
+{
+	struct dirindex *di;
+	struct buffer_head *bh = NULL;
+	off_t dirpos;
+	ino_t ino;
+	int len, res;
+	unsigned gen;
+	ASYNCIO_REENTRANT char name[14];
+
+	if (!(di = index_get(dir)) || !di->di_seg)
+		return;
+	gen = di->di_gen;
+	res = msdos_get_entry_long(dir, &pos, &bh, name, &len, &dirpos, &ino);
+	if (bh)
+		unmap_brelse(bh);
+	if (di->di_gen != gen)
+		return;
+	if (res <= 0 || index_insert(di, name, len, dirpos) < 0)
+		index_free(di);		/* rebuilt larger on next lookup */
+}
+
 /* Read a complete directory entry for a (specified) file,
  * submit a message to the callback function,
  * return a value of 0 or an error code.
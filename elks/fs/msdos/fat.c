@@ -13,6 +13,23 @@
 
 static struct fat_cache *fat_cache,cache[FAT_CACHE];
 
+/* Track a cluster changing between free and in use in the free count and map */
+static void FATPROC note_free(struct super_block *s, cluster_t this, int free)
+{
+	struct msdos_sb_info *sb = MSDOS_SB(s);
+	unsigned char __far *p;
+
+	if (sb->free_clusters >= 0)
+		sb->free_clusters += free? 1: -1;
+	this -= 2;
+	if (sb->free_map && this >= 0 && this < sb->clusters) {
+		p = (unsigned char __far *)_MK_FP(sb->free_map->base, 0) + (unsigned)(this >> 3);
+		if (free)
+			*p |= 1 << ((unsigned)this & 7);
+		else *p &= ~(1 << ((unsigned)this & 7));
+	}
+}
+
 /* Returns the this'th FAT entry, -1 if it is an end-of-file entry.
    If new_value is != -1, that FAT entry is replaced by it. */
 
@@ -99,6 +116,8 @@ cluster_t FATPROC fat_access(struct super_block *sb,cluster_t this,cluster_t new
 #endif
 		debug_fat("fat_access block bh dirty %lu\n", buffer_blocknr(bh));
 		mark_buffer_dirty(bh);
+		if (!next != !new_value)
+			note_free(sb, this, !new_value);
 #if UNUSED  /* FIXME update 2nd FAT table? */
 		/* update extra FAT table copies*/
 		//FIXME does not look like multiple fat table update is working
@@ -136,6 +155,95 @@ cluster_t FATPROC fat_access(struct super_block *sb,cluster_t this,cluster_t new
 }
 
 
+/*
+ * Count the free clusters, and build the free cluster bitmap if the FAT is
+ * small enough. Done once per mount, after which fat_access keeps both
+ * current. FAT16 and FAT32 tables are decoded a sector at a time.
+ */
+void FATPROC fat_scan_free(struct super_block *s)
+{
+	struct msdos_sb_info *sb = MSDOS_SB(s);
+	struct buffer_head *bh;
+	unsigned char __far *map = NULL;
+	void *data;
+	cluster_t this, end = sb->clusters + 2;
+	long free = 0;
+	unsigned int i, n, bytes;
+	int shift;
+
+	if (!sb->free_map && sb->clusters <= FAT_FREEMAP_MAX) {
+		bytes = (unsigned int)((sb->clusters + 7) >> 3);
+		if ((sb->free_map = seg_alloc((bytes + 15) >> 4, SEG_FLAG_EXTBUF)) != NULL) {
+			fmemsetb(0, sb->free_map->base, 0, bytes);
+			map = _MK_FP(sb->free_map->base, 0);
+		}
+	}
+
+	if (sb->fat_bits == 12) {
+		for (this = 2; this < end; this++) {
+			if (!fat_access(s, this, -1L)) {
+				free++;
+				if (map) map[(unsigned)((this - 2) >> 3)] |= 1 << ((unsigned)(this - 2) & 7);
+			}
+		}
+	} else {
+		shift = (sb->fat_bits == 16)? 1: 2;
+		n = SECTOR_SIZE_SB(s) >> shift;		/* entries per sector */
+		for (this = 2; this < end; ) {
+			if (!(bh = msdos_sread(s, (sector_t)(sb->fat_start +
+					((this << shift) >> SECTOR_BITS_SB(s))), &data))) {
+				printk("FAT: bread fat failed\n");
+				if (sb->free_map) seg_free(sb->free_map);
+				sb->free_map = NULL;
+				return;
+			}
+			for (i = (unsigned)this & (n - 1); i < n && this < end; i++, this++) {
+				if (shift == 1? !((unsigned short *)data)[i]: !((unsigned long *)data)[i]) {
+					free++;
+					if (map) map[(unsigned)((this - 2) >> 3)] |= 1 << ((unsigned)(this - 2) & 7);
+				}
+			}
+			unmap_brelse(bh);
+		}
+	}
+	sb->free_clusters = free;
+	debug_fat("FAT: %ld free clusters%s\n", free, map? ", bitmap": "");
+}
+
+/* Return a free cluster, searching from cluster index start (0 is cluster 2),
+   or 0 if the filesystem is full. */
+cluster_t FATPROC fat_find_free(struct super_block *s, cluster_t start)
+{
+	struct msdos_sb_info *sb = MSDOS_SB(s);
+	cluster_t count, i, limit = sb->clusters;
+	unsigned char __far *map;
+
+	if (!limit || !sb->free_clusters)	/* exact once counted, never from FSInfo */
+		return 0;
+	i = start % limit;
+	if (sb->free_map) {
+		map = _MK_FP(sb->free_map->base, 0);
+		for (count = 0; count < limit; count++, i++) {
+			if (i >= limit) i = 0;
+			if (!((unsigned)i & 7) && !map[(unsigned)(i >> 3)] && i + 8 <= limit) {
+				i += 7;			/* skip 8 used clusters */
+				count += 7;
+				continue;
+			}
+			if (map[(unsigned)(i >> 3)] & (1 << ((unsigned)i & 7)))
+				return i + 2;
+		}
+		return 0;
+	}
+	for (count = 0; count < limit; count++, i++) {
+		if (i >= limit) i = 0;
+		if (fat_access(s, i + 2, -1L) == 0)
+			return i + 2;
+	}
+	return 0;
+}
+
+
 void FATPROC cache_init(void)
 {
 	static int initialized = 0;
@@ -80,10 +80,56 @@ static void msdos_put_inode(register struct inode *inode)
 }
 
 
+/* Update FAT32 FSInfo free count and next free cluster hints */
+static void msdos_write_fsinfo(struct super_block *s)
+{
+	struct msdos_sb_info *sb = MSDOS_SB(s);
+	struct msdos_fsinfo *fsinfo;
+	struct buffer_head *bh;
+
+	if (!sb->info_sector || (s->s_flags & MS_RDONLY))
+		return;
+	if (!(bh = msdos_sread(s, (sector_t)sb->info_sector, (void **)&fsinfo)))
+		return;
+	if (fsinfo->signature1 == FSINFO_SIG1 && fsinfo->signature2 == FSINFO_SIG2 &&
+	    ((sb->free_clusters >= 0 && fsinfo->free_clusters != (__u32)sb->free_clusters) ||
+	     fsinfo->next_cluster != (__u32)sb->previous_cluster + 2)) {
+		if (sb->free_clusters >= 0)		/* else keep the existing hint */
+			fsinfo->free_clusters = sb->free_clusters;
+		fsinfo->next_cluster = sb->previous_cluster + 2;
+		mark_buffer_dirty(bh);
+	}
+	unmap_brelse(bh);
+}
+
+/* Return FAT32 FSInfo free cluster count, only a hint as it may be stale, or -1 */
+static long msdos_fsinfo_free(struct super_block *s)
+{
+	struct msdos_sb_info *sb = MSDOS_SB(s);
+	struct msdos_fsinfo *fsinfo;
+	struct buffer_head *bh;
+	long free = -1;
+
+	if (!sb->info_sector)
+		return -1;
+	if (!(bh = msdos_sread(s, (sector_t)sb->info_sector, (void **)&fsinfo)))
+		return -1;
+	if (fsinfo->free_clusters <= sb->clusters)
+		free = fsinfo->free_clusters;
+	unmap_brelse(bh);
+	return free;
+}
+
 static void msdos_put_super(register struct super_block *sb)
 {
 	debug_fat("put_super\n");
 	cache_inval_dev(sb->s_dev);
+	msdos_index_inval(sb->s_dev, 0);
+	msdos_write_fsinfo(sb);
+	if (MSDOS_SB(sb)->free_map) {
+		seg_free(MSDOS_SB(sb)->free_map);
+		MSDOS_SB(sb)->free_map = NULL;
+	}
 	lock_super(sb);
 	sb->s_dev = 0;
 	unlock_super(sb);
@@ -113,6 +159,7 @@ static struct super_block *msdos_read_super(struct super_block *s, char *data,
 	int fat32;
 
 	cache_init();
+	msdos_index_inval(s->s_dev, 0);
 	lock_super(s);
 	bh = bread(s->s_dev, 0);
 	unlock_super(s);
@@ -123,20 +170,15 @@ static struct super_block *msdos_read_super(struct super_block *s, char *data,
 	}
 
 #ifdef CONFIG_VAR_SECTOR_SIZE
-        sb->sector_size = get_sector_size(s->s_dev);
-	switch (sb->sector_size) {
+	switch (get_sector_size(s->s_dev)) {
 	case 512:
 		sb->sector_bits = 9;	/* log2(sector_size) */
-		sb->msdos_dps = 16;		/* SECTOR_SIZE / sizeof(struct msdos_dir_entry) */
-		sb->msdos_dps_bits = 4;	/* log2(msdos_dps) */
 		break;
 	case 1024:
 		sb->sector_bits = 10;	/* log2(sector_size) */
-		sb->msdos_dps = 32;		/* SECTOR_SIZE / sizeof(struct msdos_dir_entry) */
-		sb->msdos_dps_bits = 5;	/* log2(msdos_dps) */
 		break;
 	default:
-		printk("FAT: %d sector size not supported\n", sb->sector_size);
+		printk("FAT: %d sector size not supported\n", get_sector_size(s->s_dev));
 		return NULL;
 	}
 #endif
@@ -146,10 +188,13 @@ static struct super_block *msdos_read_super(struct super_block *s, char *data,
 	sb->cluster_size = b->cluster_size;
 	sb->fats = b->fats;
 	sb->fat_start = b->reserved;
+	sb->info_sector = 0;
 	if(!b->fat_length && b->fat32_length){
 		fat32 = 1;
 		sb->fat_length = (unsigned short)b->fat32_length;
 		sb->root_cluster = b->root_cluster;
+		if (b->info_sector && b->info_sector < b->reserved)
+			sb->info_sector = b->info_sector;
 	} else {
 		fat32 = 0;
 #ifndef FAT_BITS_32
@@ -166,6 +211,8 @@ static struct super_block *msdos_read_super(struct super_block *s, char *data,
 	sb->clusters = sb->cluster_size?  data_sectors / sb->cluster_size : 0;
 	sb->fat_bits = fat32 ? 32 : sb->clusters > MSDOS_FAT12_MAX_CLUSTERS ? 16 : 12;
 	sb->previous_cluster = 0;
+	sb->free_clusters = -1;
+	sb->free_map = NULL;
 	unmap_brelse(bh);
 
 printk("FAT: me=%x,csz=%d,#f=%d,floc=%d,fsz=%d,rloc=%d,#d=%d,dloc=%d,#s=%lu,ts=%lu\n",
@@ -197,6 +244,19 @@ printk("FAT: me=%x,csz=%d,#f=%d,floc=%d,fsz=%d,rloc=%d,#d=%d,dloc=%d,#s=%lu,ts=%
 		return NULL;
 	}
 
+	/* use FAT32 FSInfo next free cluster hint, the free count is used by statfs only */
+	if (sb->info_sector) {
+		struct msdos_fsinfo *fsinfo;
+
+		if ((bh = msdos_sread(s, (sector_t)sb->info_sector, (void **)&fsinfo)) != NULL) {
+			if (fsinfo->signature1 == FSINFO_SIG1 && fsinfo->signature2 == FSINFO_SIG2) {
+				if (fsinfo->next_cluster >= 2 && fsinfo->next_cluster < sb->clusters + 2)
+					sb->previous_cluster = fsinfo->next_cluster - 2;
+			} else sb->info_sector = 0;
+			unmap_brelse(bh);
+		}
+	}
+
 	total_displayed = total_sectors >> (BLOCK_SIZE_BITS - SECTOR_BITS_SB(s));
 #if UNUSED      /* calculate free count on mount */
 	long free_displayed = 0;
@@ -246,18 +306,28 @@ printk("FAT: me=%x,csz=%d,#f=%d,floc=%d,fsz=%d,rloc=%d,#d=%d,dloc=%d,#s=%lu,ts=%
 
 static void msdos_statfs(struct super_block *s,struct statfs *sf, int flags)
 {
-	cluster_t cluster, cluster_size;
+	cluster_t cluster_size;
 	unsigned long total, free;
+	long count;
 
 	cluster_size = MSDOS_SB(s)->cluster_size;
 	sf->f_bsize = SECTOR_SIZE_SB(s);
 	total  = (MSDOS_SB(s)->clusters * cluster_size) + MSDOS_SB(s)->data_start;
 	sf->f_blocks = total >> (BLOCK_SIZE_BITS - SECTOR_BITS_SB(s));
-	if (!(flags & UF_NOFREESPACE)) {
-		free = 0;
-		for (cluster = 2; cluster < MSDOS_SB(s)->clusters + 2; cluster++)
-			if (!fat_access(s, cluster, -1))
-				free += cluster_size;
+	/*
+	 * Free count is kept current once known, so only counted once.
+	 * Until then a FAT32 FSInfo hint is reported instead of scanning.
+	 */
+	count = MSDOS_SB(s)->free_clusters;
+	if (count < 0 && !(flags & UF_NOFREESPACE) && (count = msdos_fsinfo_free(s)) < 0) {
+		lock_fat();			/* as msdos_add_cluster */
+		if (MSDOS_SB(s)->free_clusters < 0)
+			fat_scan_free(s);
+		unlock_fat();
+		count = MSDOS_SB(s)->free_clusters;
+	}
+	if (count >= 0) {
+		free = count * cluster_size;
 		free >>= (BLOCK_SIZE_BITS - SECTOR_BITS_SB(s));
 	} else free = -1L;
 	sf->f_bfree = free;
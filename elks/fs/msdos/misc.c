@@ -60,48 +60,39 @@ void FATPROC unlock_creation(void)
 }
 
 
+static struct wait_queue fat_wait;
+static int fat_lock = 0;
+
+
+/* serialize free cluster scan and allocation */
+void FATPROC lock_fat(void)
+{
+	while (fat_lock) sleep_on(&fat_wait);
+	fat_lock = 1;
+}
+
+
+void FATPROC unlock_fat(void)
+{
+	fat_lock = 0;
+	wake_up(&fat_wait);
+}
+
+
 int FATPROC msdos_add_cluster(register struct inode *inode)
 {
-	static struct wait_queue wait;
-	static int lock = 0;
-	cluster_t count, this, limit, curr, last;
+	cluster_t this, curr, last;
 	sector_t sector;
 	size_t offset;
 	struct buffer_head *bh;
 	struct msdos_sb_info *sb = MSDOS_SB(inode->i_sb);
 	int fatsz = sb->fat_bits;
-	cluster_t prev = sb->previous_cluster;
 
 	debug_fat("add_cluster\n");
 #ifndef FAT_BITS_32
 	if (fatsz != 32)
 		if (inode->i_ino == MSDOS_ROOT_INO) return -ENOSPC;
 #endif
-	while (lock) sleep_on(&wait);
-	lock = 1;
-	limit = sb->clusters;
-	for (count = 0; count < limit; count++) {
-		this = ((count+prev) % limit)+2;
-		if (fat_access(inode->i_sb,this,-1L) == 0) break;
-	}
-	debug("free cluster: %d\r\n",this);
-
-	prev = (count+prev+1) % limit;
-	sb->previous_cluster = prev;
-	if (count >= limit) {
-		lock = 0;
-		wake_up(&wait);
-		return -ENOSPC;
-	}
-	fat_access(inode->i_sb,this,
-#ifndef FAT_BITS_32
-	    fatsz == 12? 0xff8UL : fatsz == 16? 0xfff8UL:
-#endif
-	    0xffffff8UL);
-	lock = 0;
-	wake_up(&wait);
-	debug("set to %x\r\n",fat_access(inode->i_sb,this,-1L));
-
 	if (!S_ISDIR(inode->i_mode)) {
 		last = inode->i_size?
 			get_cluster(inode,(inode->i_size-1) / SECTOR_SIZE(inode) / sb->cluster_size)
@@ -119,6 +110,25 @@ int FATPROC msdos_add_cluster(register struct inode *inode)
 	}
 	debug("last = %d\r\n",last);
 
+	lock_fat();
+	if (sb->free_clusters < 0 && sb->clusters <= FAT_FREEMAP_MAX)
+		fat_scan_free(inode->i_sb);		/* build free map on first use */
+	/* keep growing files contiguous, else continue from last allocation */
+	this = fat_find_free(inode->i_sb, last? last - 1: sb->previous_cluster);
+	debug("free cluster: %d\r\n",this);
+	if (!this) {
+		unlock_fat();
+		return -ENOSPC;
+	}
+	sb->previous_cluster = this - 1;	/* index of following cluster */
+	fat_access(inode->i_sb,this,
+#ifndef FAT_BITS_32
+	    fatsz == 12? 0xff8UL : fatsz == 16? 0xfff8UL:
+#endif
+	    0xffffff8UL);
+	unlock_fat();
+	debug("set to %x\r\n",fat_access(inode->i_sb,this,-1L));
+
 	if (last)
 		fat_access(inode->i_sb,last,this);
 	else {
@@ -280,10 +290,11 @@ ino_t FATPROC msdos_get_entry(struct inode *dir,loff_t *pos,struct buffer_head *
 }
 
 /* Scans a directory for a given file (name points to its formatted name) or
-   for an empty directory slot (name is NULL). Returns the inode number. */
+   for an empty directory slot (name is NULL). Returns the inode number,
+   and the entry's directory position in res_pos if non-NULL. */
 
 int FATPROC msdos_scan(struct inode *dir,char *name,struct buffer_head **res_bh,
-    struct msdos_dir_entry **res_de,ino_t *ino)
+    struct msdos_dir_entry **res_de,ino_t *ino,off_t *res_pos)
 {
 	off_t pos;
 	struct msdos_dir_entry *de;
@@ -316,6 +327,7 @@ int FATPROC msdos_scan(struct inode *dir,char *name,struct buffer_head **res_bh,
 		return name ? -ENOENT : -ENOSPC;
 	}
 	*res_de = de;
+	if (res_pos) *res_pos = pos - sizeof(struct msdos_dir_entry);
 	return 0;
 }
 
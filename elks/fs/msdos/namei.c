@@ -71,7 +71,7 @@ static int FATPROC msdos_find(struct inode *dir,const char *name,int len,
 	ASYNCIO_REENTRANT char msdos_name[MSDOS_NAME+1];
 
 	if ((res = msdos_format_name(name,len, msdos_name)) < 0) return res;
-	res = msdos_scan(dir,msdos_name,bh,de,ino);
+	res = msdos_scan(dir,msdos_name,bh,de,ino,NULL);
 	msdos_name[MSDOS_NAME] = 0;
 	debug_fat("find '%11s', ino=%ld\n", msdos_name, (unsigned long)*ino);
 	return res;
@@ -98,10 +98,14 @@ static int FATPROC msdos_find_long(struct inode *dir, const char *name, int len,
 	ASYNCIO_REENTRANT char entry_name[14];
 	ASYNCIO_REENTRANT char msdos_name[14];
 
+	*bh = NULL;
+	if (len > 14)		/* longer names are never stored */
+		return -ENOENT;
 	for (i=0; i<len; i++)
 		msdos_name[i] = get_fs_byte(name++);
 
-	*bh = NULL;
+	if ((res = msdos_index_find(dir, msdos_name, len, bh, ino)) <= 0)
+		return res;
 	do {
 		res = msdos_get_entry_long(dir, &pos, bh, entry_name, &entry_len, &dirpos, ino);
 		if (res) {
@@ -173,16 +177,17 @@ static int FATPROC msdos_create_entry(struct inode *dir,const char *name,int is_
 	struct msdos_dir_entry *de;
 	int res;
 	ino_t ino;
+	off_t pos;
 
 	debug_fat("create_entry\n");
 	/* find empty directory entry*/
-	if ((res = msdos_scan(dir,NULL,&bh,&de,&ino)) < 0) {
+	if ((res = msdos_scan(dir,NULL,&bh,&de,&ino,&pos)) < 0) {
 		/* if rootdir return no space*/
 		if (dir->i_ino == MSDOS_ROOT_INO) return -ENOSPC;
 		/* try adding space to directory*/
 		if ((res = msdos_add_cluster(dir)) < 0) return res;
 		/* if can't find empty entry return error*/
-		if ((res = msdos_scan(dir,NULL,&bh,&de,&ino)) < 0) return res;
+		if ((res = msdos_scan(dir,NULL,&bh,&de,&ino,&pos)) < 0) return res;
 	}
 	memcpy(de->name,name,MSDOS_NAME);
 	de->attr = is_dir ? ATTR_DIR : ATTR_ARCH;
@@ -193,6 +198,7 @@ static int FATPROC msdos_create_entry(struct inode *dir,const char *name,int is_
 	mark_buffer_dirty(bh);
 	if ((*result = iget(dir->i_sb,ino)) != 0) msdos_read_inode(*result);
 	unmap_brelse(bh);
+	msdos_index_add(dir,pos);
 	if (!*result) return -EIO;
 	(*result)->i_mtime = current_time();
 	(*result)->i_dirt = 1;
@@ -215,7 +221,7 @@ int msdos_create(register struct inode *dir,const char *name,size_t len,mode_t m
 	}
 	lock_creation();
 	/* check for name already present*/
-	if (msdos_scan(dir,msdos_name,&bh,&de,&ino) >= 0) {
+	if (msdos_scan(dir,msdos_name,&bh,&de,&ino,NULL) >= 0) {
 		unlock_creation();
 		unmap_brelse(bh);
 		iput(dir);
@@ -243,7 +249,7 @@ int msdos_mkdir(struct inode *dir,const const char *name,size_t len,mode_t mode)
 	}
 	lock_creation();
 
-	if (msdos_scan(dir,msdos_name,&bh,&de,&ino) >= 0) {
+	if (msdos_scan(dir,msdos_name,&bh,&de,&ino,NULL) >= 0) {
 		unlock_creation();
 		unmap_brelse(bh);
 		iput(dir);
@@ -322,6 +328,7 @@ int msdos_rmdir(register struct inode *dir,const char *name,int len)
 	dir->i_mtime = current_time();
 	inode->i_dirt = dir->i_dirt = 1;
 	de->name[0] = (unsigned char)DELETED_FLAG;
+	msdos_index_inval(dir->i_dev, ino);
 	debug_fat("rmdir block write %lu\n", buffer_blocknr(bh));
 	mark_buffer_dirty(bh);
 	res = 0;
@@ -69,21 +69,109 @@ int pipe_lseek(struct inode *inode, struct file *file, loff_t offset,
     return -ESPIPE;
 }
 
-/* pipes are allocated from kernel local heap */
-static unsigned char *get_pipe_mem(void)
+/*
+ * Pipes are allocated from kernel local heap, or from far main memory
+ * when CONFIG_PIPE_FAR is set. A far pipe buffer starts at offset 0 of
+ * its segment, so PIPE_BASE is always the offset and pipe_seg() the segment.
+ */
+static int get_pipe_mem(struct inode *inode, size_t size)
+{
+#ifdef CONFIG_PIPE_FAR
+    segment_s *seg;
+
+    if ((seg = seg_alloc((size + 15) >> 4, SEG_FLAG_PIPE)) != NULL) {
+        PIPE_SEG(inode) = seg;
+        PIPE_BASE(inode) = NULL;
+        PIPE_SIZE(inode) = size;
+        return 0;
+    }
+    if (size > PIPE_BUFSIZ)     /* only small pipes in local heap */
+        return -ENOMEM;
+#endif
+    if (!(PIPE_BASE(inode) = heap_alloc(size, HEAP_TAG_PIPE)))
+        return -ENOMEM;
+    PIPE_SEG(inode) = NULL;
+    PIPE_SIZE(inode) = size;
+    return 0;
+}
+
+static void free_pipe_mem(struct inode *inode)
+{
+    if (PIPE_SEG(inode)) {
+        seg_put(PIPE_SEG(inode));
+        PIPE_SEG(inode) = NULL;
+    } else if (PIPE_BASE(inode)) {
+        heap_free(PIPE_BASE(inode));
+        PIPE_BASE(inode) = NULL;
+    }
+}
+
+static seg_t pipe_seg(struct inode *inode)
 {
-    return heap_alloc(PIPE_BUFSIZ, HEAP_TAG_PIPE);
+    return PIPE_SEG(inode)? PIPE_SEG(inode)->base: kernel_ds;
+}
+
+/* resize pipe buffer, keeping any unread data */
+static int pipe_resize(register struct inode *inode, size_t size)
+{
+    unsigned char *base = PIPE_BASE(inode);
+    segment_s *oseg = PIPE_SEG(inode);
+    seg_t seg = pipe_seg(inode);
+    size_t osize = PIPE_SIZE(inode);
+    size_t tail = PIPE_TAIL(inode);
+    size_t len = PIPE_LEN(inode);
+    size_t chars;
+    int error;
+
+    if (size < len) return -EBUSY;
+    if (size == osize) return 0;
+    if ((error = get_pipe_mem(inode, size)) < 0) {
+        PIPE_BASE(inode) = base;        /* keep old buffer */
+        PIPE_SEG(inode) = oseg;
+        PIPE_SIZE(inode) = osize;
+        return error;
+    }
+
+    /* linearize unread data at start of new buffer */
+    chars = osize - tail;
+    if (chars > len) chars = len;
+    fmemcpyb(PIPE_BASE(inode), pipe_seg(inode), base + tail, seg, chars);
+    if (chars < len)
+        fmemcpyb(PIPE_BASE(inode) + chars, pipe_seg(inode), base, seg, len - chars);
+    PIPE_TAIL(inode) = 0;
+    PIPE_HEAD(inode) = (len == size)? 0: len;
+    PIPE_WANT(inode) = 0;
+
+    if (oseg) seg_put(oseg);
+    else heap_free(base);
+    wake_up_interruptible(&PIPE_WAIT(inode));
+    return 0;
 }
 
-static void free_pipe_mem(unsigned char *buf)
+int pipe_fcntl(struct inode *inode, unsigned int cmd, unsigned int arg)
 {
-    heap_free(buf);
+    int error;
+
+    if (!S_ISFIFO(inode->i_mode) || !PIPE_ALLOCATED(inode))
+        return -EBADF;
+    if (cmd == F_GETPIPE_SZ)
+        return PIPE_SIZE(inode);
+
+    if (arg < PIPE_BUFSIZ) arg = PIPE_BUFSIZ;
+#ifdef CONFIG_PIPE_FAR
+    if (arg > PIPE_FAR_MAXSIZ) return -EINVAL;
+#else
+    if (arg > PIPE_MAXSIZ) return -EINVAL;
+#endif
+    if (PIPE_LOCK(inode)) return -EBUSY;
+    error = pipe_resize(inode, arg);
+    return error? error: PIPE_SIZE(inode);
 }
 
 static size_t pipe_read(register struct inode *inode, struct file *filp,
                      char *buf, size_t count)
 {
-    size_t chars;
+    size_t chars, free;
 
     debug("PIPE: read called.\n");
     while (PIPE_EMPTY(inode) || PIPE_LOCK(inode)) {
@@ -93,17 +181,30 @@ static size_t pipe_read(register struct inode *inode, struct file *filp,
         interruptible_sleep_on(&PIPE_WAIT(inode));
     }
     PIPE_LOCK(inode)++;
+    free = PIPE_FREE(inode);
     if (count > PIPE_LEN(inode)) count = PIPE_LEN(inode);
     chars = PIPE_SIZE(inode) - PIPE_TAIL(inode);
     if (chars > count) chars = count;
-    memcpy_tofs(buf, PIPE_BASE(inode) + PIPE_TAIL(inode), chars);
+    fmemcpyb(buf, current->t_regs.ds, PIPE_BASE(inode) + PIPE_TAIL(inode),
+        pipe_seg(inode), chars);
     if (chars < count)
-        memcpy_tofs(buf + chars, PIPE_BASE(inode), count - chars);
+        fmemcpyb(buf + chars, current->t_regs.ds, PIPE_BASE(inode),
+            pipe_seg(inode), count - chars);
     if ((PIPE_TAIL(inode) += count) >= PIPE_SIZE(inode))
         PIPE_TAIL(inode) -= PIPE_SIZE(inode);
     PIPE_LEN(inode) -= count;
     PIPE_LOCK(inode)--;
-    wake_up_interruptible(&PIPE_WAIT(inode));
+    /*
+     * Wake writers when the pipe empties or becomes half free, so a fast
+     * writer refills in large chunks instead of a byte at a time, or when
+     * there is room for the atomic write a sleeping writer is waiting on.
+     */
+    if (PIPE_EMPTY(inode) ||
+        (free < PIPE_SIZE(inode) / 2 && PIPE_FREE(inode) >= PIPE_SIZE(inode) / 2) ||
+        (PIPE_WANT(inode) && PIPE_FREE(inode) >= PIPE_WANT(inode))) {
+        PIPE_WANT(inode) = 0;           /* woken writers set it again */
+        wake_up_interruptible(&PIPE_WAIT(inode));
+    }
     if (count) inode->i_atime = current_time();
     else if (PIPE_WRITERS(inode)) count = -EAGAIN;
     return count;
@@ -113,6 +214,7 @@ static size_t pipe_write(register struct inode *inode, struct file *filp,
                       char *buf, size_t count)
 {
     size_t free, head, chars, written = 0;
+    int wasempty;
 
     debug("PIPE: write called.\n");
     if (!PIPE_READERS(inode)) goto snd_signal;
@@ -128,16 +230,20 @@ static size_t pipe_write(register struct inode *inode, struct file *filp,
             if (current->signal) return written ? written : -ERESTARTSYS; // FIXME
             if (filp->f_flags & O_NONBLOCK)
                 return written ? written : -EAGAIN;
+            if (free > PIPE_WANT(inode))
+                PIPE_WANT(inode) = free;
             interruptible_sleep_on(&PIPE_WAIT(inode));
         }
         PIPE_LOCK(inode)++;
+        wasempty = PIPE_EMPTY(inode);
         while (count > 0 && (free = (PIPE_SIZE(inode) - PIPE_LEN(inode)))) {
             head = PIPE_HEAD(inode);
             chars = PIPE_SIZE(inode) - head;
             if (chars > count) chars = count;
             if (chars > free) chars = free;
 
-            memcpy_fromfs(PIPE_BASE(inode) + head, buf, chars);
+            fmemcpyb(PIPE_BASE(inode) + head, pipe_seg(inode), buf,
+                current->t_regs.ds, chars);
             buf += chars;
             if ((PIPE_HEAD(inode) += chars) >= PIPE_SIZE(inode))
                 PIPE_HEAD(inode) -= PIPE_SIZE(inode);
@@ -146,7 +252,9 @@ static size_t pipe_write(register struct inode *inode, struct file *filp,
             count -= chars;
         }
         PIPE_LOCK(inode)--;
-        wake_up_interruptible(&PIPE_WAIT(inode));
+        /* readers only sleep on an empty pipe */
+        if (wasempty)
+            wake_up_interruptible(&PIPE_WAIT(inode));
         free = 1;
     }
     inode->i_ctime = inode->i_mtime = current_time();
@@ -179,11 +287,8 @@ static void pipe_rdwr_release(register struct inode *inode,
     if (filp->f_mode & FMODE_WRITE) PIPE_WRITERS(inode)--;
 
     if (!(PIPE_READERS(inode) + PIPE_WRITERS(inode))) {
-        if (PIPE_BASE(inode)) {
-            /* Free up any memory allocated to the pipe */
-            free_pipe_mem(PIPE_BASE(inode));
-            PIPE_BASE(inode) = NULL;
-        }
+        /* Free up any memory allocated to the pipe */
+        free_pipe_mem(inode);
     } else wake_up_interruptible(&PIPE_WAIT(inode));
 }
 
@@ -210,10 +315,12 @@ static int pipe_rdwr_open(register struct inode *inode,
 {
     debug("PIPE: rdwr called.\n");
 
-    if (!PIPE_BASE(inode)) {
-        if (!(PIPE_BASE(inode) = get_pipe_mem())) return -ENOMEM;
+    if (!PIPE_ALLOCATED(inode)) {
         /* PIPE_ fields set to zero by new_inode() */
-        PIPE_SIZE(inode) = PIPE_BUFSIZ;
+#ifdef CONFIG_PIPE_FAR
+        if (get_pipe_mem(inode, CONFIG_PIPE_FAR_SIZE) < 0)
+#endif
+            if (get_pipe_mem(inode, PIPE_BUFSIZ) < 0) return -ENOMEM;
     }
     if (filp->f_mode & FMODE_READ) {
         PIPE_READERS(inode)++;
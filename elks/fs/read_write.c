@@ -4,6 +4,7 @@
  *  Copyright (C) 1991, 1992  Linus Torvalds
  */
 
+#include <linuxmt/config.h>
 #include <linuxmt/types.h>
 #include <linuxmt/errno.h>
 #include <linuxmt/stat.h>
@@ -12,6 +13,8 @@
 #include <linuxmt/fcntl.h>
 #include <linuxmt/mm.h>
 #include <linuxmt/fs.h>
+#include <linuxmt/uio.h>
+#include <linuxmt/socket.h>
 #include <arch/segment.h>
 #include <linuxmt/debug.h>
 
@@ -90,41 +93,196 @@ int sys_read(unsigned int fd, char *buf, size_t count)
     return retval;
 }
 
+/*
+ * If data has been written to the file, remove the setuid and
+ * the setgid bits. We do it anyway otherwise there is an
+ * extremely exploitable race - does your OS get it right |->
+ *
+ * Set ATTR_FORCE so it will always be changed.
+ */
+static size_t do_write(register struct file *file, char *buf, size_t count)
+{
+    register struct inode *inode = file->f_inode;
+
+    if (!suser() && (inode->i_mode & (S_ISUID | S_ISGID))) {
+
+#ifdef USE_NOTIFY_CHANGE
+	struct iattr newattrs;
+	newattrs.ia_mode = inode->i_mode & ~(S_ISUID | S_ISGID);
+	newattrs.ia_valid = ATTR_CTIME | ATTR_MODE | ATTR_FORCE;
+	notify_change(inode, &newattrs);
+#else
+	inode->i_mode = inode->i_mode & ~(S_ISUID | S_ISGID);
+#endif
+
+    }
+    return file->f_op->write(inode, file, buf, count);
+}
+
 int sys_write(unsigned int fd, char *buf, size_t count)
 {
-    register struct file_operations *fop;
     struct file *file;
-    register struct inode *inode;
     int written;
 
     if (((written = fd_check(fd, buf, count, FMODE_WRITE, &file)) == 0) && count) {
 	written = -EINVAL;
-	fop = file->f_op;
-	if (fop->write) {
-	    inode = file->f_inode;
-
-	    /*
-	     * If data has been written to the file, remove the setuid and
-	     * the setgid bits. We do it anyway otherwise there is an
-	     * extremely exploitable race - does your OS get it right |->
-	     *
-	     * Set ATTR_FORCE so it will always be changed.
-	     */
-	    if (!suser() && (inode->i_mode & (S_ISUID | S_ISGID))) {
+	if (file->f_op->write) {
+	    written = (int) do_write(file, buf, count);
+	    schedule();         // FIXME removing these slows down localhost networking
+	}
+    }
+    return written;
+}
 
-#ifdef USE_NOTIFY_CHANGE
-		struct iattr newattrs;
-		newattrs.ia_mode = inode->i_mode & ~(S_ISUID | S_ISGID);
-		newattrs.ia_valid = ATTR_CTIME | ATTR_MODE | ATTR_FORCE;
-		notify_change(inode, &newattrs);
-#else
-		inode->i_mode = inode->i_mode & ~(S_ISUID | S_ISGID);
+/*
+ * Number of iovecs copied to the kernel stack at a time. The user array
+ * of up to UIO_MAXIOV entries is processed in chunks of this size.
+ */
+#define IOV_CHUNK	4
+
+/* copy in and check part of a user iovec array, returning its total length */
+static int get_iovec(struct iovec *uiov, int iovcnt, struct iovec *iov, int rw)
+{
+    int i;
+    size_t total = 0;
+
+    if (verified_memcpy_fromfs(iov, uiov, iovcnt * sizeof(struct iovec)))
+	return -EFAULT;
+    for (i = 0; i < iovcnt; i++) {
+	if (iov[i].iov_len && verify_area((rw == FMODE_READ)? VERIFY_WRITE: VERIFY_READ,
+		iov[i].iov_base, iov[i].iov_len))
+	    return -EFAULT;
+	total += iov[i].iov_len;
+	if ((int)total < 0)
+	    return -EINVAL;
+    }
+    return (int)total;
+}
+
+/*
+ * readv/writev: transfer each iovec in turn through the file's read/write
+ * op, stopping at the first short transfer. Reads from anything other than
+ * a regular file or block device return after the first segment with data,
+ * so a pipe or tty readv never blocks once some data has been read.
+ */
+static int do_readv_writev(unsigned int fd, struct iovec *uiov, int iovcnt, int rw)
+{
+    register struct file *file;
+    struct inode *inode;
+    struct file *f;
+    struct iovec iov[IOV_CHUNK];
+    int i, n, chunk, total, count = 0;
+
+    if ((n = fd_check(fd, NULL, 0, rw, &f)) != 0)
+	return n;
+    file = f;
+    inode = file->f_inode;
+    if (iovcnt <= 0 || iovcnt > UIO_MAXIOV)
+	return -EINVAL;
+    if (!S_ISSOCK(inode->i_mode) &&
+	    !((rw == FMODE_READ)? file->f_op->read: file->f_op->write))
+	return -EINVAL;
+
+    for (; iovcnt > 0; uiov += chunk, iovcnt -= chunk) {
+	chunk = (iovcnt > IOV_CHUNK)? IOV_CHUNK: iovcnt;
+	if ((total = get_iovec(uiov, chunk, iov, rw)) < 0) {
+	    n = total;
+	    goto out;
+	}
+	if ((int)(count + total) < 0) {
+	    n = -EINVAL;
+	    goto out;
+	}
+
+#ifdef CONFIG_SOCKET
+	if (S_ISSOCK(inode->i_mode)) {
+	    if (!total)
+		continue;
+	    if ((n = sock_iovec(inode, file, iov, chunk, rw)) < 0)
+		goto out;
+	    count += n;
+	    if (n < total || rw == FMODE_READ)
+		break;
+	    continue;
+	}
 #endif
 
-	    }
-	    written = (int) fop->write(inode, file, buf, count);
-	    schedule();         // FIXME removing these slows down localhost networking
+	for (i = 0; i < chunk; i++) {
+	    if (!iov[i].iov_len)
+		continue;
+	    if (rw == FMODE_READ)
+		n = (int) file->f_op->read(inode, file, iov[i].iov_base, iov[i].iov_len);
+	    else
+		n = (int) do_write(file, iov[i].iov_base, iov[i].iov_len);
+	    if (n < 0)
+		goto out;
+	    count += n;
+	    if (n < iov[i].iov_len)
+		goto done;
+	    if (rw == FMODE_READ && !S_ISREG(inode->i_mode) && !S_ISBLK(inode->i_mode))
+		goto done;
 	}
     }
-    return written;
+    goto done;
+
+out:
+    if (!count)
+	count = n;
+done:
+    schedule();         // FIXME see sys_read
+    return count;
+}
+
+int sys_readv(unsigned int fd, struct iovec *iov, int iovcnt)
+{
+    return do_readv_writev(fd, iov, iovcnt, FMODE_READ);
+}
+
+int sys_writev(unsigned int fd, struct iovec *iov, int iovcnt)
+{
+    return do_readv_writev(fd, iov, iovcnt, FMODE_WRITE);
+}
+
+/*
+ * pread/pwrite: transfer at the passed offset without moving the file
+ * position. As with lseek, the offset is passed by pointer.
+ */
+static int do_pread_pwrite(unsigned int fd, char *buf, size_t count,
+	loff_t *p_offset, int rw)
+{
+    register struct file *file;
+    struct file *f;
+    struct file pfile;
+    loff_t pos;
+    int retval;
+
+    if ((retval = fd_check(fd, buf, count, rw, &f)) != 0)
+	return retval;
+    file = f;
+    if (S_ISFIFO(file->f_inode->i_mode) || S_ISSOCK(file->f_inode->i_mode))
+	return -ESPIPE;
+    pos = (loff_t) get_user_long(p_offset);
+    if (pos < 0)
+	return -EINVAL;
+    if (!count)
+	return 0;
+    if (!((rw == FMODE_READ)? file->f_op->read: file->f_op->write))
+	return -EINVAL;
+
+    /* private file struct, the shared file position may be in use elsewhere */
+    pfile = *file;
+    pfile.f_pos = pos;
+    if (rw == FMODE_READ)
+	return (int) file->f_op->read(file->f_inode, &pfile, buf, count);
+    return (int) do_write(&pfile, buf, count);
+}
+
+int sys_pread(unsigned int fd, char *buf, size_t count, loff_t *p_offset)
+{
+    return do_pread_pwrite(fd, buf, count, p_offset, FMODE_READ);
+}
+
+int sys_pwrite(unsigned int fd, char *buf, size_t count, loff_t *p_offset)
+{
+    return do_pread_pwrite(fd, buf, count, p_offset, FMODE_WRITE);
 }
@@ -11,7 +11,6 @@
  *  4   Com1 (/dev/ttyS0)   CONFIG_CHAR_DEV_RS      Optional
  *  5*  Unused
  *  5*  Com3 (/devb/ttyS2)  CONFIG_CHAR_DEV_RS      Optional
- *  5*  HW IDE hard drive   CONFIG_BLK_DEV_HD       Driver doesn't work
  *  6*  Unused
  *  6*  HW floppy drive     CONFIG_BLK_DEV_FD       Driver doesn't compile
  *  7   Unused (LPT, Com4)
@@ -22,8 +21,8 @@
  * 12   NE2K (/dev/eth)     CONFIG_ETH_NE2K         Optional
  * 12*  Unused (Mouse)                              Turned off
  * 13   Unused (Math coproc.)                       Turned off
- * 14*  AT HD IDE (/dev/hda) CONFIG_BLK_DEV_HD      Driver doesn't work
- * 15*  AT HD IDE (/dev/hdb) CONFIG_BLK_DEV_HD      Driver doesn't work
+ * 14*  AT IDE (/dev/dhda)  CONFIG_BLK_DEV_HD       Optional, polled if unavailable
+ * 15*  AT IDE (/dev/dhdc)  CONFIG_BLK_DEV_HD       Optional, polled if unavailable
  *
  * Edit settings below to change port address or IRQ:
  *   Change I/O port and driver IRQ number to match your hardware
@@ -118,12 +117,11 @@
 /* bioshd.c*/
 #define FDC_DOR		0x3F2		/* floppy digital output register*/
 
-/* obsolete - experimental IDE hard drive, directhd.c (broken)*/
+/* ATA/IDE hard drive, directhd.c and idequery.c */
 #define HD1_PORT	0x1f0
 #define HD2_PORT	0x170
-#define HD_IRQ		5		/* missing request_irq call*/
-#define HD1_AT_IRQ	14		/* missing request_irq call*/
-#define HD2_AT_IRQ	15		/* missing request_irq call*/
+#define HD1_AT_IRQ	14		/* used with CONFIG_ASYNCIO */
+#define HD2_AT_IRQ	15
 
 /* direct floppy driver, directfd.c */
 #define FLOPPY_IRQ	6
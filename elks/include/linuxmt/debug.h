@@ -19,6 +19,7 @@
 #define DEBUG_ETH       0               /* ethernet*/
 #define DEBUG_FAT       0               /* FAT filesystem*/
 #define DEBUG_FILE      0               /* sys open and file i/o*/
+#define DEBUG_HEAP      0               /* kernel heap allocation trace*/
 #define DEBUG_LP        0               /* parallel port */
 #define DEBUG_MAP       0               /* L1 mapping */
 #define DEBUG_MM        0               /* mem char device*/
@@ -72,6 +73,12 @@ void debug_setcallback(int evnum, void (*cbfunc)()); /* callback on debug event*
 #define debug_file(...)
 #endif
 
+#if DEBUG_HEAP
+#define debug_heap      printk
+#else
+#define debug_heap(...)
+#endif
+
 #if DEBUG_LP
 #define debug_lp      PRINTK
 #else
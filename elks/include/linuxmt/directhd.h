@@ -5,26 +5,53 @@
 #define __LINUXMT_DIRECTHD_H
 
 /* define offsets from base port address */
+#define DIRECTHD_DATA 0
 #define DIRECTHD_ERROR 1
+#define DIRECTHD_FEATURE 1
 #define DIRECTHD_SEC_COUNT 2
-#define DIRECTHD_SECTOR 3
-#define DIRECTHD_CYLINDER_LO 4
-#define DIRECTHD_CYLINDER_HI 5
-#define DIRECTHD_DH 6
+#define DIRECTHD_SECTOR 3	/* LBA bits 0-7 */
+#define DIRECTHD_CYLINDER_LO 4	/* LBA bits 8-15 */
+#define DIRECTHD_CYLINDER_HI 5	/* LBA bits 16-23 */
+#define DIRECTHD_DH 6		/* LBA bits 24-27 */
 #define DIRECTHD_STATUS 7
 #define DIRECTHD_COMMAND 7
+#define DIRECTHD_CONTROL 0x206	/* device control, 0x3f6/0x376 */
 
 /* define drive masks */
 #define DIRECTHD_DRIVE0 0xa0
 #define DIRECTHD_DRIVE1 0xb0
+#define DIRECTHD_LBA 0x40	/* DH register LBA addressing */
+
+/* status register bits */
+#define DIRECTHD_ST_ERR 0x01	/* error, see error register */
+#define DIRECTHD_ST_DRQ 0x08	/* data request */
+#define DIRECTHD_ST_DF 0x20	/* drive fault */
+#define DIRECTHD_ST_BSY 0x80	/* busy */
+
+/* device control register bits */
+#define DIRECTHD_CTL_NIEN 0x02	/* disable drive interrupt */
+#define DIRECTHD_CTL_SRST 0x04	/* software reset */
 
 /* define drive commands */
 #define DIRECTHD_DRIVE_ID 0xec	/* drive id */
 #define DIRECTHD_READ 0x20	/* read with retry */
 #define DIRECTHD_WRITE 0x30	/* write with retry */
+#define DIRECTHD_READ_MULTI 0xc4	/* read multiple */
+#define DIRECTHD_WRITE_MULTI 0xc5	/* write multiple */
+#define DIRECTHD_SET_MULTI 0xc6	/* set multiple mode */
+
+/* IDENTIFY DEVICE data, word offsets */
+#define DIRECTHD_ID_CONFIG 0	/* bit 15 set for ATAPI */
+#define DIRECTHD_ID_MAX_MULTI 47	/* low byte max sectors per READ MULTIPLE */
+#define DIRECTHD_ID_CAPS 49	/* bit 9 LBA supported */
+#define DIRECTHD_ID_CUR_CYLS 54
+#define DIRECTHD_ID_CUR_HEADS 55
+#define DIRECTHD_ID_CUR_SECTORS 56
+#define DIRECTHD_ID_LBA_SECTS 60	/* words 60-61 LBA28 total sectors */
 
 /* other definitions */
 #define MAX_DRIVES 4		/* 2 per i/o channel and 2 i/o channels */
+#define DIRECTHD_MAX_MULTI 16	/* max sectors per interrupt used */
 
 #if 0
 #define DIRECTHD_DEVICE_NAME	"dhd"
@@ -18,6 +18,7 @@
 #define O_APPEND	 02000
 #define O_NONBLOCK	 04000
 #define O_NDELAY	O_NONBLOCK
+#define O_DIRECT	040000	/* raw block devices: bypass buffer cache */
 
 #if UNUSED
 #define O_SYNC		010000	/* Not supported */
@@ -36,6 +37,9 @@
 #define F_SETOWN	8	/*  for sockets. */
 #define F_GETOWN	9	/*  for sockets. */
 
+#define F_SETPIPE_SZ	1031	/* set pipe buffer size */
+#define F_GETPIPE_SZ	1032	/* get pipe buffer size */
+
 /* for F_[GET|SET]FL */
 #define FD_CLOEXEC	1	/* actually anything with low bit set goes */
 
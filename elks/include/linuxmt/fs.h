@@ -133,6 +133,7 @@ struct ext_buffer_head_s {
 #ifdef CONFIG_FS_EXTERNAL_BUFFER
     ramdesc_t                   b_L2seg;    /* EXT seg:0 or XMS linear addr of L2 */
     char                        b_mapcount; /* count of L2 buffer mapped into L1 */
+    unsigned char               b_L1dirty;  /* L1 copy may differ from L2 */
 #endif
 };
 
@@ -154,7 +155,11 @@ typedef struct buffer_head      ext_buffer_head;
 #define EBH(bh)         (bh)
 
 /* macros for buffer_head pointers called outside of buffer.c */
+#ifdef CONFIG_FS_EXTERNAL_BUFFER
+#define mark_buffer_dirty(bh)   ((bh)->b_dirty = (bh)->b_L1dirty = 1)
+#else
 #define mark_buffer_dirty(bh)   ((bh)->b_dirty = 1)
+#endif
 #define mark_buffer_clean(bh)   ((bh)->b_dirty = 0)
 #define buffer_count(bh)        ((bh)->b_count)
 #define buffer_blocknr(bh)      ((bh)->b_blocknr)
@@ -425,8 +430,15 @@ extern struct buffer_head *get_hash_table(kdev_t,block_t);
 extern struct buffer_head *getblk(kdev_t,block_t);
 extern struct buffer_head *getblk32(kdev_t,block32_t);
 extern struct buffer_head *readbuf(struct buffer_head *);
+#ifdef CONFIG_ASYNCIO
+extern void bread_ahead(kdev_t,block32_t);
+#endif
 
 extern void ll_rw_blk(int,struct buffer_head *);
+#ifdef CONFIG_BLK_DEV_CHAR
+extern void ll_rw_raw(int,struct buffer_head *,char *,ramdesc_t);
+extern int raw_rw_block(int,kdev_t,block32_t,char *,ramdesc_t);
+#endif
 extern int get_sector_size(kdev_t dev);
 
 extern struct super_block *get_super(kdev_t);
@@ -475,6 +487,7 @@ extern struct buffer_head *bread(dev_t,block_t);
 extern struct buffer_head *bread32(dev_t,block32_t);
 
 extern int open_fd(int flags, struct inode *inode);
+extern int pipe_fcntl(struct inode *inode, unsigned int cmd, unsigned int arg);
 
 extern void mark_buffer_uptodate(struct buffer_head *,int);
 
@@ -78,6 +78,7 @@ struct gendisk
 
 extern struct drive_infot *last_drive;  /* set to last drivep-> used in read/write */
 extern unsigned char bios_drive_map[];  /* map drive to BIOS drivenum */
+extern int directhd_drives;             /* bitmask of drives owned by directhd */
 
 extern struct gendisk *gendisk_head;    /* linked list of disks */
 
@@ -24,6 +24,10 @@
 #define HEAP_TAG_INODE   0x07   /* system inodes */
 #define HEAP_TAG_FILE    0x08   /* system open files */
 
+// Number of free list size classes
+
+#define HEAP_CLASS_COUNT 8
+
 
 // TODO: move free list node from header to body
 // to reduce overhead for allocated block
@@ -41,11 +45,13 @@ typedef struct heap heap_s;
 // Heap data
 
 extern list_s _heap_all;
+extern int (* heap_reclaim) (void);
 
 // Heap functions
 
 void * heap_alloc (word_t size, byte_t tag);
 void heap_free (void * data);
+void heap_free_size (word_t * total, word_t * largest);
 
 void heap_add (void * data, word_t size);
 void heap_init ();
@@ -5,6 +5,28 @@
 
 /* Block device generic driver operations */
 #define IOCTL_BLK_GET_SECTOR_SIZE 0x0330    /* ioctl get drive sector size */
+#define IOCTL_BLK_CACHE_STATS   0x0331  /* get track cache statistics */
+#define IOCTL_BLK_CACHE_RESET   0x0332  /* clear drive's track cache and statistics */
+
+struct blk_cache_stats {
+    unsigned long tries;        /* sector reads checked against cache */
+    unsigned long hits;         /* reads satisfied from cache */
+    unsigned long fills;        /* track reads into cache */
+    unsigned long invalidates;  /* entries dropped by writes or close */
+    unsigned int entries;       /* number of cache entries */
+    unsigned int entry_size;    /* bytes per entry */
+};
+
+/* Solid state disk driver operations */
+#define IOCTL_SSD_BENCH         0x0201  /* time raw sector reads */
+
+struct ssd_bench {
+    unsigned long start;        /* first sector to read */
+    unsigned int sectors;       /* total sectors to read */
+    unsigned int per_cmd;       /* sectors per device command, max SSD_BENCH_MAX */
+    unsigned long ticks;        /* returned elapsed jiffies */
+};
+#define SSD_BENCH_MAX           16
 
 /* Ethernet generic driver operations */
 #define IOCTL_ETH_ADDR_GET      0x0901
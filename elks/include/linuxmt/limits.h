@@ -40,9 +40,14 @@
 #define NR_SUPER        6       /* Max mounts */
 
 #define PIPE_BUFSIZ     80      /* doesn't have to be power of two */
+#define PIPE_MAXSIZ     1024    /* max F_SETPIPE_SZ size in kernel local heap */
+#define PIPE_FAR_MAXSIZ 16384   /* max F_SETPIPE_SZ size in far memory */
 
 #define MAXNAMLEN       26      /* Max filename, 14 for MINIX, 26 for FAT (not tunable) */
 
+#define NR_CODE_CACHE   8       /* Max number of cached executable code segments */
+#define NR_MMAP         8       /* Max number of memory mapped files */
+#define NR_MMAP_REF     16      /* Max number of process file mappings system-wide */
 #define NR_ALARMS       5       /* Max number of simultaneous alarms system-wide */
 
 #define MAX_PACKET_ETH 1536     /* Max packet size, 6 blocks of 256 bytes */
@@ -11,10 +11,22 @@
 #define MEM_GETFARTEXT  9
 #define MEM_GETMAXTASKS 10
 #define MEM_GETJIFFADDR 11
+#define MEM_XMSBENCH	12
 
 struct mem_usage {
 	unsigned int free_memory;
 	unsigned int used_memory;
 };
 
+/* XMS copy methods */
+#define XMS_COPY_FAR	0	/* main memory fmemcpyw, for comparison */
+#define XMS_COPY_UNREAL	1	/* unreal mode 32-bit moves, 386+ */
+#define XMS_COPY_INT15	2	/* BIOS INT 15h/1Fh block move */
+
+struct xms_bench {
+	int method;		/* XMS_COPY_* method to time */
+	unsigned int kbytes;	/* # 1K blocks copied each way */
+	unsigned long ticks;	/* returned elapsed jiffies */
+};
+
 #endif
@@ -43,6 +43,7 @@ typedef __u32 ramdesc_t;	/* special physical ram descriptor */
 /* allocate from XMS memory */
 int xms_init(void);		/* enables unreal mode and A20 gate */
 ramdesc_t xms_alloc(long_t size);
+long_t xms_avail(void);		/* bytes left to allocate */
 
 /* copy to/from XMS or far memory - XMS requires unreal mode and A20 gate enabled */
 void xms_fmemcpyw(void *dst_off, ramdesc_t dst_seg, void *src_off, ramdesc_t src_seg,
@@ -51,6 +52,10 @@ void xms_fmemcpyb(void *dst_off, ramdesc_t dst_seg, void *src_off, ramdesc_t src
 		size_t count);
 void xms_fmemset(void *dst_off, ramdesc_t dst_seg, byte_t val, size_t count);
 
+/* time a copy method, see MEM_XMSBENCH */
+struct xms_bench;
+int xms_bench(struct xms_bench *b);
+
 /* low level copy - must have 386 CPU and xms_enabled before calling! */
 void linear32_fmemcpyw(void *dst_off, addr_t dst_seg, void *src_off, addr_t src_seg,
 		size_t count);
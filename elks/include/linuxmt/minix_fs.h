@@ -84,6 +84,7 @@ extern int minix_create(register struct inode *,const char *,size_t,mode_t,
 extern void minix_free_block(register struct super_block *,block_t);
 extern void minix_free_inode(register struct inode *);
 extern struct buffer_head *minix_getblk(register struct inode *,block_t,int);
+extern void minix_map_invalidate(kdev_t);
 extern int minix_link(register struct inode *,char *,size_t,
 			register struct inode *);
 extern int minix_lookup(register struct inode *,const char *,size_t,
@@ -12,6 +12,7 @@ struct segment {
 	byte_t    flags;
 	byte_t    ref_count;
 	word_t    pid;
+	word_t    swap;       /* first swap unit when SEG_FLAG_SWAPPED */
 };
 
 typedef struct segment segment_s;
@@ -20,6 +21,8 @@ typedef struct segment segment_s;
 #define SEG_FLAG_FREE    0x00
 #define SEG_FLAG_USED	 0x80
 #define SEG_FLAG_ALIGN1K 0x40
+#define SEG_FLAG_FIXED   0x20   /* base stored in memory, cannot be moved */
+#define SEG_FLAG_SWAPPED 0x10   /* contents in swap, not in main memory */
 #define SEG_FLAG_TYPE	 0x0F
 #define SEG_FLAG_CSEG	 0x01   /* app code segment */
 #define SEG_FLAG_DSEG	 0x02   /* app auto (stack/heap) data segment */
@@ -27,6 +30,10 @@ typedef struct segment segment_s;
 #define SEG_FLAG_FDAT	 0x04   /* app fmemalloc far data */
 #define SEG_FLAG_EXTBUF	 0x05   /* ext/main memory buffers */
 #define SEG_FLAG_RAMDSK	 0x06   /* ram disk buffers */
+#define SEG_FLAG_VIDEO	 0x07   /* console shadow and scrollback buffers */
+#define SEG_FLAG_PIPE	 0x08   /* far pipe buffers */
+#define SEG_FLAG_MMAP	 0x09   /* memory mapped files */
+#define SEG_FLAG_ROM	 0x0A   /* outside main memory, code executing in place */
 
 #ifdef __KERNEL__
 
@@ -60,8 +67,14 @@ void seg_free (segment_s *);
 segment_s * seg_get (segment_s *);
 void seg_put (segment_s *);
 segment_s * seg_dup (segment_s *);
+segment_s * seg_rom (seg_t, segext_t);
 
 void seg_free_pid(pid_t pid);
+void mmap_release_pid(pid_t pid);
+
+void seg_swapin_wait (void);
+int exec_cache_shrink (int inuse);
+void seg_swap_init (void);
 
 void mm_get_usage (unsigned int * free, unsigned int * used);
 
@@ -0,0 +1,16 @@
+#ifndef __LINUXMT_MMAN_H
+#define __LINUXMT_MMAN_H
+
+/* mmap prot, only PROT_READ supported */
+#define PROT_NONE	0
+#define PROT_READ	1
+#define PROT_WRITE	2
+#define PROT_EXEC	4
+
+/* mmap flags, shared and private read-only mappings are the same */
+#define MAP_SHARED	1
+#define MAP_PRIVATE	2
+
+#define MMAP_MAXSIZE	0xFFF0U	/* largest file that fits in one segment */
+
+#endif
@@ -62,11 +62,25 @@ struct msdos_boot_sector {
 	__u16	flags;		/* bit 8: fat mirroring, low 4: active fat (unused) */
 	__u8	version[2];	/* major, minor filesystem version (unused) */
 	__u32	root_cluster;	/* first cluster of root directory 44 */
-	__u16	info_sector;	/* filesystem info sector (unused) */
+	__u16	info_sector;	/* filesystem info sector 48 */
 	__u16	backup_boot;	/* backup boot sector (unused) */
 	__u16	reserved2[6];	/* Unused */
 } __attribute__((packed));
 
+/* FAT32 filesystem info sector */
+struct msdos_fsinfo {
+	__u32	signature1;	/* FSINFO_SIG1 0*/
+	__u8	reserved1[480];
+	__u32	signature2;	/* FSINFO_SIG2 484*/
+	__u32	free_clusters;	/* free cluster count, -1 if unknown 488*/
+	__u32	next_cluster;	/* where to start looking for a free cluster 492*/
+} __attribute__((packed));
+
+#define FSINFO_SIG1	0x41615252L
+#define FSINFO_SIG2	0x61417272L
+
+#define FAT_FREEMAP_MAX	131072L	/* max clusters for free bitmap (16K) */
+
 struct msdos_dir_entry {
 	char name[8],ext[3]; /* name and extension */
 	unsigned char attr;  /* attribute bits */
@@ -121,13 +135,15 @@ struct buffer_head * FATPROC msdos_sread_nomap(struct super_block *s, sector_t s
 struct buffer_head * FATPROC msdos_sread(struct super_block *s, sector_t sector, void **start);
 void FATPROC lock_creation(void);
 void FATPROC unlock_creation(void);
+void FATPROC lock_fat(void);
+void FATPROC unlock_fat(void);
 int  FATPROC msdos_add_cluster(struct inode *inode);
 long FATPROC date_dos2unix(unsigned short time,unsigned short date);
 void FATPROC date_unix2dos(long unix_date,unsigned short *time, unsigned short *date);
 ino_t FATPROC msdos_get_entry(struct inode *dir,loff_t *pos,struct buffer_head **bh,
     struct msdos_dir_entry **de);
 int  FATPROC msdos_scan(struct inode *dir,char *name,struct buffer_head **res_bh,
-    struct msdos_dir_entry **res_de,ino_t *ino);
+    struct msdos_dir_entry **res_de,ino_t *ino,off_t *res_pos);
 ino_t FATPROC msdos_parent_ino(struct inode *dir,int locked);
 
 /* fat.c */
@@ -142,6 +158,8 @@ void FATPROC cache_add(struct inode *inode, cluster_t f_clu, cluster_t d_clu);
 void FATPROC cache_inval_inode(struct inode *inode);
 void FATPROC cache_inval_dev(kdev_t device);
 cluster_t FATPROC get_cluster(struct inode *inode, cluster_t cluster);
+void FATPROC fat_scan_free(struct super_block *sb);
+cluster_t FATPROC fat_find_free(struct super_block *sb, cluster_t start);
 
 /* namei.c */
 
@@ -165,6 +183,10 @@ extern int init_msdos_fs(void);
 extern struct inode_operations msdos_dir_inode_operations;
 int FATPROC msdos_get_entry_long(struct inode *dir, off_t *pos, struct buffer_head **bh,
     char *name, int *namelen, off_t *dirpos, ino_t *ino);
+int FATPROC msdos_index_find(struct inode *dir, char *name, int len,
+    struct buffer_head **bh, ino_t *ino);
+void FATPROC msdos_index_add(struct inode *dir, off_t pos);
+void FATPROC msdos_index_inval(kdev_t dev, ino_t ino);
 
 /* file.c */
 
@@ -1,7 +1,12 @@
 #ifndef _MSDOS_FS_SB
 #define _MSDOS_FS_SB
 
-struct msdos_sb_info { /* space in struct super_block is 28 bytes */
+/*
+ * Kept in the super_block union for every mount table entry, so keep it
+ * small: 38 bytes, 40 with CONFIG_VAR_SECTOR_SIZE, within the 46 bytes
+ * of minix_sb_info. The free cluster bitmap is a separate segment.
+ */
+struct msdos_sb_info {
 	unsigned short cluster_size; /* sectors/cluster */
 	unsigned char fats;          /* number of FATs */
 	unsigned char fat_bits;      /* FAT bits (12 or 16) */
@@ -12,13 +17,13 @@ struct msdos_sb_info { /* space in struct super_block is 28 bytes */
 	unsigned short data_start;   /* first data sector */
 	unsigned long clusters;      /* number of clusters */
 	unsigned long root_cluster;  /* root directory cluster */
-	long previous_cluster;       /* used in add_cluster */
+	long previous_cluster;       /* next free cluster search start (index from 0) */
+	long free_clusters;          /* exact free cluster count, -1 if not yet counted */
+	struct segment *free_map;    /* free cluster bitmap, NULL if none */
+	unsigned short info_sector;  /* FAT32 FSInfo sector, 0 if none */
 	ino_t dev_ino;               /* "/dev" ino */
 #ifdef CONFIG_VAR_SECTOR_SIZE
-	int sector_size;             /* physical sector size */
-	unsigned char sector_bits;   /* log2(sector_size) */
-	unsigned char msdos_dps;     /* dir entries / sector */
-	unsigned char msdos_dps_bits;/* log2(msdos_dbs) */
+	unsigned char sector_bits;   /* log2(sector_size), others derived to save space */
 #endif
 };
 
@@ -28,12 +33,12 @@ struct msdos_sb_info { /* space in struct super_block is 28 bytes */
 
 #ifdef CONFIG_VAR_SECTOR_SIZE
 /* variable sector size across disks - use calculated bits in block device superblock*/
-#define SECTOR_SIZE(inode)		(MSDOS_SB(inode->i_sb)->sector_size)
+#define SECTOR_SIZE(inode)		(1 << SECTOR_BITS(inode))
 #define SECTOR_BITS(inode)		(MSDOS_SB(inode->i_sb)->sector_bits)
-#define SECTOR_SIZE_SB(sb)		(MSDOS_SB(sb)->sector_size)
+#define SECTOR_SIZE_SB(sb)		(1 << SECTOR_BITS_SB(sb))
 #define SECTOR_BITS_SB(sb)		(MSDOS_SB(sb)->sector_bits)
-#define MSDOS_DPS_SB(sb)		(MSDOS_SB(sb)->msdos_dps)
-#define MSDOS_DPS_BITS(inode)	(MSDOS_SB(inode->i_sb)->msdos_dps_bits)
+#define MSDOS_DPS_SB(sb)		(1 << (SECTOR_BITS_SB(sb) - MSDOS_DIR_BITS)) /* dirents/sector */
+#define MSDOS_DPS_BITS(inode)	(SECTOR_BITS(inode) - MSDOS_DIR_BITS)
 #else
 /* fixed sector size - uses constants for code size */
 #define SECTOR_SIZE(inode)		512		/* sector size (bytes) */
@@ -11,9 +11,13 @@
 
 #define PTYINQ_SIZE	80	/* pty input queue size*/
 #define PTYOUTQ_SIZE	512	/* pty output queue size (=TDB_WRITE_MAX and telnetd buffer)*/
+#define PTYINQ_MAX	256	/* pty queue sizes tried first at open*/
+#define PTYOUTQ_MAX	1024
 
 #define RSINQ_SIZE	1024	/* serial input queue SLIP_MTU+128+8*/
 #define RSOUTQ_SIZE	80	/* serial output queue size*/
+#define RS_MIN_INQ	64	/* TIOCSSERIAL receive queue size limits*/
+#define RS_MAX_INQ	4096
 
 /*
  * Note: don't mess with NR_PTYS until you understand the tty minor
@@ -114,9 +118,17 @@ extern void set_console(dev_t dev);
 extern unsigned VideoSeg;
 #endif
 
+#ifdef CONFIG_CONSOLE_SCROLLBACK
+extern void Console_idle(void);
+		/* Redraw scrollback requested at interrupt time */
+#endif
+
 /* tty.flags */
 #define TTY_STOPPED 	1
 #define TTY_OPEN	2
+#define TTY_TXINT	4	/* driver transmits by interrupt, writers sleep*/
+#define TTY_THROTTLED	8	/* driver stopped input, TCXONC TCION when drained*/
+#define TTY_PKTMODE	16	/* pty master in TIOCPKT packet mode*/
 
 #endif
 
@@ -10,6 +10,8 @@ struct pipe_inode_info {
     unsigned int wr_openers;
     unsigned int readers;
     unsigned int writers;
+    unsigned int want;		/* free space a sleeping writer needs */
+    struct segment *seg;	/* far buffer, or NULL when in kernel local heap */
 };
 
 #define PIPE_WAIT(inode)	((inode)->u.pipe_i.q.wait)
@@ -18,12 +20,15 @@ struct pipe_inode_info {
 #define PIPE_TAIL(inode)	((inode)->u.pipe_i.q.tail)
 #define PIPE_LEN(inode)		((inode)->u.pipe_i.q.len)
 #define PIPE_SIZE(inode)	((inode)->u.pipe_i.q.size)
+#define PIPE_SEG(inode)		((inode)->u.pipe_i.seg)
 #define PIPE_LOCK(inode)	((inode)->u.pipe_i.lock)
 #define PIPE_RD_OPENERS(inode)	((inode)->u.pipe_i.rd_openers)
 #define PIPE_WR_OPENERS(inode)	((inode)->u.pipe_i.wr_openers)
 #define PIPE_READERS(inode)	((inode)->u.pipe_i.readers)
 #define PIPE_WRITERS(inode)	((inode)->u.pipe_i.writers)
+#define PIPE_WANT(inode)	((inode)->u.pipe_i.want)
 
+#define PIPE_ALLOCATED(inode)	(PIPE_BASE(inode) || PIPE_SEG(inode))
 #define PIPE_EMPTY(inode)	(PIPE_LEN(inode) == 0)
 #define PIPE_FULL(inode)	(PIPE_LEN(inode) == PIPE_SIZE(inode))
 #define PIPE_FREE(inode)	(PIPE_SIZE(inode) - PIPE_LEN(inode))
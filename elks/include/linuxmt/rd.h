@@ -3,5 +3,6 @@
 
 #define RDCREATE	((1<<8)|0)
 #define RDDESTROY	((1<<8)|1)
+#define RDRESIZE	((1<<8)|2)	/* grow ramdisk to arg K*/
 
 #endif
@@ -55,6 +55,7 @@ struct task_struct {
 
 /* Scheduling + status variables */
     unsigned char               state;
+    unsigned char               t_atuser;       /* switched out on return to user mode */
     struct wait_queue           child_wait;
     jiff_t                      timeout;        /* for select() */
     struct wait_queue           *waitpt;        /* Wait pointer */
@@ -130,6 +131,11 @@ extern time_t current_time(void);
 /* Scheduling and sleeping function prototypes */
 
 extern void schedule(void);
+#ifdef CONFIG_SEG_COMPACT
+extern void schedule_user(void);
+#else
+#define schedule_user() schedule()
+#endif
 
 extern void wait_set(struct wait_queue *);
 extern void wait_clear(struct wait_queue *);
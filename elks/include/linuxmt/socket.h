@@ -54,9 +54,17 @@ struct msghdr {
 #ifdef __KERNEL__
 struct proto_ops;
 struct socket;
+struct inode;
+struct file;
 int sock_register(int,struct proto_ops *);
 int move_addr_to_user(char *,size_t,char *,int *);
 int sock_awaitconn(struct socket *mysock, struct socket *servsock, int flags);
+int sock_iovec(struct inode *inode, struct file *file, struct iovec *iov,
+	int iovcnt, int rw);
+int sock_send_iov(struct socket *sock, int (*write)(), struct iovec *iov,
+	int iovcnt, int nonblock);
+int sock_recv_iov(struct socket *sock, int (*read)(), struct iovec *iov,
+	int iovcnt, int nonblock);
 #endif
 
 #endif
@@ -62,6 +62,19 @@
 #define TIOCGICOUNT	(__TERMIOS_MAJ+0x5D)	/* read serial port inline interrupt counts */
 #define TIOSETCONSOLE	(__TERMIOS_MAJ+0x5E)	/* set console dev_t*/
 
+/* TIOCGSERIAL/TIOCSSERIAL serial port information and statistics */
+struct serial_stats {
+	unsigned int	port;		/* I/O port*/
+	unsigned char	irq;
+	unsigned char	type;		/* UART 0=8250 1=16450 2=16550 3=16550A 4=16750*/
+	unsigned int	inqsize;	/* receive queue size, TIOCSSERIAL applies at next open*/
+	unsigned long	rxcount;	/* characters received*/
+	unsigned long	txcount;	/* characters transmitted*/
+	unsigned int	overruns;	/* UART receive overruns*/
+	unsigned int	drops;		/* characters dropped on full receive queue*/
+	unsigned int	throttles;	/* times RTS dropped for flow control*/
+};
+
 /* Used for packet mode */
 #define TIOCPKT_DATA		 0
 #define TIOCPKT_FLUSHREAD	 1
@@ -1,9 +1,11 @@
 #ifndef __LINUXMT_UIO_H
 #define __LINUXMT_UIO_H
 
+#include <linuxmt/types.h>
+
 struct iovec {
     void *iov_base;	/* BSD uses caddr_t (same thing in effect) */
-    int iov_len;
+    size_t iov_len;
 };
 
 #define UIO_MAXIOV	16
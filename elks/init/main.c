@@ -50,6 +50,7 @@ struct netif_parms netif_parms[MAX_ETHS] = {
 seg_t kernel_cs, kernel_ds;
 int tracing;
 int nr_ext_bufs, nr_xms_bufs, nr_map_bufs;
+extern int nr_track_cache;
 char running_qemu;
 static int boot_console;
 static seg_t membase, memend;
@@ -151,6 +152,9 @@ void start_kernel(void)
         test_ptime_idle_loop();
 #endif
         schedule();
+#ifdef CONFIG_CONSOLE_SCROLLBACK
+        Console_idle();     /* redraw console scrolled back by keyboard */
+#endif
 #ifdef CONFIG_TIMER_INT0F
         int0F();        /* simulate timer interrupt hooked on IRQ 7 */
 #else
@@ -318,6 +322,13 @@ static struct dev_name_struct {
 	{ "hdb",     DEV_HDB },
 	{ "hdc",     DEV_HDC },
 	{ "hdd",     DEV_HDD },
+#ifdef CONFIG_BLK_DEV_HD
+	{ "dhda",    DEV_DHDA },
+	{ "dhdb",    DEV_DHDB },
+#define NR_PARTDEVS	6
+#else
+#define NR_PARTDEVS	4
+#endif
 	{ "fd0",     DEV_FD0 },
 	{ "fd1",     DEV_FD1 },
 	{ "df0",     DEV_DF0 },
@@ -336,17 +347,18 @@ static struct dev_name_struct {
  */
 static char * INITPROC root_dev_name(int dev)
 {
-	int i;
+	int i, len;
 #define NAMEOFF	13
-	static char name[18] = "ROOTDEV=/dev/";
+	static char name[20] = "ROOTDEV=/dev/";
 
-	for (i=0; i<5; i++) {
-		if (devices[i].num == (dev & 0xfff0)) {
+	for (i=0; i<NR_PARTDEVS+1; i++) {
+		if (devices[i].num == (dev & 0xfff8)) {
 			strcpy(&name[NAMEOFF], devices[i].name);
-			if (i < 4) {
+			if (i < NR_PARTDEVS) {
 				if (dev & 0x07) {
-					name[NAMEOFF+3] = '0' + (dev & 7);
-					name[NAMEOFF+4] = '\0';
+					len = strlen(devices[i].name);
+					name[NAMEOFF+len] = '0' + (dev & 7);
+					name[NAMEOFF+len+1] = '\0';
 				}
 			}
 			return name;
@@ -540,6 +552,12 @@ static int INITPROC parse_options(void)
 			nr_map_bufs = (int)simple_strtol(line+6, 10);
 			continue;
 		}
+#ifdef CONFIG_TRACK_CACHE
+		if (!strncmp(line,"trkcache=",9)) {
+			nr_track_cache = (int)simple_strtol(line+9, 10);
+			continue;
+		}
+#endif
 		if (!strncmp(line,"task=",5)) {
 			max_tasks = (int)simple_strtol(line+5, 10);
 			continue;
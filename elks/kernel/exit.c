@@ -113,6 +113,7 @@ void do_exit(int status)
 
     /* free program allocated memory */
     seg_free_pid(current->pid);
+    mmap_release_pid(current->pid);
 
     parent = current->p_parent;
 
@@ -87,8 +87,9 @@ pid_t do_fork(int virtual)
     for (j = 0; j < MAX_SEGS; j++) {
         s = t->mm[j];
         if (s) {
-            if ((s->flags & SEG_FLAG_TYPE) == SEG_FLAG_CSEG)
-                seg_get(s);         /* share text */
+            if ((s->flags & SEG_FLAG_TYPE) == SEG_FLAG_CSEG ||
+                (s->flags & SEG_FLAG_TYPE) == SEG_FLAG_ROM)
+                seg_get(s);         /* share text, also executing in place */
             else {
                 if (virtual) {
                     seg_get(s);     /* share data for vfork */
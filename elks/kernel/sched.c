@@ -12,6 +12,7 @@
 #include <linuxmt/string.h>
 #include <linuxmt/trace.h>
 #include <linuxmt/debug.h>
+#include <linuxmt/mm.h>
 
 #include <arch/irq.h>
 
@@ -122,6 +123,25 @@ void schedule(void)
         debug_sched("resched: %P prevstate %d\n", prev->state);
 }
 
+#ifdef CONFIG_SEG_COMPACT
+/*
+ *  Reschedule on the way back to user mode, from the timer interrupt
+ *  or a stop signal. The kernel holds no pointers into the segments
+ *  of the task while it is switched out here, so they may be moved
+ *  or swapped out. Swapped segments are brought back before return.
+ */
+
+void schedule_user(void)
+{
+    current->t_atuser = 1;
+    schedule();
+#ifdef CONFIG_SEG_SWAP
+    seg_swapin_wait();
+#endif
+    current->t_atuser = 0;
+}
+#endif
+
 static struct timer_list *next_timer;
 
 void add_timer(struct timer_list * timer)
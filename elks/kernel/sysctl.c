@@ -14,12 +14,19 @@ struct sysctl {
 static int malloc_debug;
 static int net_debug;
 
+/* buffer cache L1 statistics, see fs/buffer.c */
+extern int map_count, remap_count, unmap_count, clean_count;
+
 struct sysctl sysctl[] = {
     { "kern.debug",         &dprintk_on         },  /* debug (^P) on/off */
     { "kern.strace",        &tracing            },  /* strace=1, kstack=2 */
     { "kern.console",       (int *)&dev_console },  /* console */
     { "malloc.debug",       &malloc_debug       },
     { "net.debug",          &net_debug          },
+    { "buf.map",            &map_count          },  /* L2 copied into L1 */
+    { "buf.remap",          &remap_count        },  /* already in L1 */
+    { "buf.unmap",          &unmap_count        },  /* modified L1 copied to L2 */
+    { "buf.clean",          &clean_count        },  /* clean L1 reused without copy */
 };
 
 static char ctlname[CTL_MAXNAMESZ];
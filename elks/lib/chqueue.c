@@ -26,6 +26,7 @@
 #include <linuxmt/types.h>
 #include <linuxmt/errno.h>
 #include <linuxmt/debug.h>
+#include <linuxmt/mm.h>
 #include <arch/irq.h>
 
 void chq_init(register struct ch_queue *q, unsigned char *buf, int size)
@@ -118,6 +119,62 @@ int chq_getch(register struct ch_queue *q)
     return retval;
 }
 
+/*
+ * Copy up to len bytes from user space into queue, using block copies
+ * of the contiguous spans between head and end of ring. Returns bytes added.
+ * Consumer may run at interrupt level, so head and len are updated last.
+ */
+int chq_copyin(register struct ch_queue *q, char *data, int len)
+{
+    int count = 0;
+    int n;
+
+    while (len > 0 && (n = q->size - q->len) > 0) {
+	if (n > q->size - q->head)
+	    n = q->size - q->head;
+	if (n > len)
+	    n = len;
+	memcpy_fromfs(q->base + q->head, data, n);
+	clr_irq();
+	if ((q->head += n) >= q->size)
+	    q->head = 0;
+	q->len += n;
+	set_irq();
+	data += n;
+	count += n;
+	len -= n;
+    }
+    return count;
+}
+
+/*
+ * Copy up to len bytes from queue to user space in contiguous spans.
+ * Producer may run at interrupt level, so tail and len are updated last.
+ * Returns bytes removed.
+ */
+int chq_copyout(register struct ch_queue *q, char *data, int len)
+{
+    int count = 0;
+    int n;
+
+    while (len > 0 && (n = q->len) > 0) {
+	if (n > q->size - q->tail)
+	    n = q->size - q->tail;
+	if (n > len)
+	    n = len;
+	memcpy_tofs(data, q->base + q->tail, n);
+	clr_irq();
+	if ((q->tail += n) >= q->size)
+	    q->tail = 0;
+	q->len -= n;
+	set_irq();
+	data += n;
+	count += n;
+	len -= n;
+    }
+    return count;
+}
+
 int chq_peekch(struct ch_queue *q)
 {
     return (q->len != 0);
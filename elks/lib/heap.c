@@ -4,6 +4,7 @@
 #include <linuxmt/kernel.h>
 #include <linuxmt/heap.h>
 #include <linuxmt/string.h>
+#include <linuxmt/debug.h>
 
 // Minimal block size to hold heap header
 // plus enough space in body to be useful
@@ -14,7 +15,63 @@
 // Heap root
 
 list_s _heap_all;
-static list_s _heap_free;
+
+// Free blocks are kept in segregated lists by size class,
+// class n holding blocks of size [2^(n+4), 2^(n+5)), the
+// first class also holding the smaller ones and the last
+// one all the larger ones. A bit set in the mask tells the
+// list is not empty, so that a large enough block is found
+// without walking the whole heap.
+
+static list_s _heap_free [HEAP_CLASS_COUNT];
+static word_t _heap_mask;
+
+// Called when an allocation fails so that a cache can give
+// back heap memory, returns nonzero if anything was freed
+
+int (* heap_reclaim) (void);
+
+
+// Get size class of block
+
+static int heap_class (word_t size)
+{
+	int c = 0;
+
+	size >>= 5;
+	while (size && c < HEAP_CLASS_COUNT - 1) {
+		size >>= 1;
+		c++;
+	}
+
+	return c;
+}
+
+
+// Add block to its free list
+//   - head to increase 'exact hit' chance
+//     on next allocation of same size
+
+static void free_insert (heap_s * h)
+{
+	int c = heap_class (h->size);
+
+	h->tag = HEAP_TAG_FREE;
+	list_insert_after (&_heap_free [c], &(h->free));
+	_heap_mask |= 1 << c;
+}
+
+
+// Remove block from its free list
+
+static void free_remove (heap_s * h)
+{
+	int c = heap_class (h->size);
+
+	list_remove (&(h->free));
+	if (_heap_free [c].next == &_heap_free [c])
+		_heap_mask &= ~(1 << c);
+}
 
 
 // Split block if enough large
@@ -28,10 +85,9 @@ static void heap_split (heap_s * h1, word_t size0)
 
 		heap_s * h2 = (heap_s *) ((byte_t *) (h1 + 1) + size0);
 		h2->size = size2 - sizeof (heap_s);
-		h2->tag = HEAP_TAG_FREE;
 
 		list_insert_after (&(h1->all), &(h2->all));
-		list_insert_after (&(h1->free), &(h2->free));
+		free_insert (h2);
 	}
 }
 
@@ -40,31 +96,51 @@ static void heap_split (heap_s * h1, word_t size0)
 
 static heap_s * free_get (word_t size0, byte_t tag)
 {
-	// First get the smallest suitable free block
-
 	heap_s * best_h  = 0;
-	word_t best_size = 0xFFFF;
-	list_s * n = _heap_free.next;
+	int c = heap_class (size0);
+
+	// First try the class of the requested size
+	// where blocks may still be too small
 
-	while (n != &_heap_free) {
-		heap_s * h = structof (n, heap_s, free);
-		word_t size1  = h->size;
+	if (_heap_mask & (1 << c)) {
+		word_t best_size = 0xFFFF;
+		list_s * n = _heap_free [c].next;
 
-		if ((h->tag == HEAP_TAG_FREE) && (size1 >= size0) && (size1 < best_size)) {
-			best_h  = h;
-			best_size = size1;
-			if (size1 == size0) break;
+		while (n != &_heap_free [c]) {
+			heap_s * h = structof (n, heap_s, free);
+			word_t size1  = h->size;
+
+			if ((size1 >= size0) && (size1 < best_size)) {
+				best_h  = h;
+				best_size = size1;
+				if (size1 == size0) break;
+			}
+
+			n = h->free.next;
 		}
+	}
 
-		n = h->free.next;
+	// Then any block of the next non-empty class
+	// that is large enough by construction
+
+	if (!best_h) {
+		word_t mask = _heap_mask & ~((2 << c) - 1);
+		if (mask) {
+			c = 0;
+			while (!(mask & 1)) {
+				mask >>= 1;
+				c++;
+			}
+			best_h = structof (_heap_free [c].next, heap_s, free);
+		}
 	}
 
 	// Then allocate that free block
 
 	if (best_h) {
+		free_remove (best_h);
 		heap_split (best_h, size0);
 		best_h->tag = HEAP_TAG_USED | tag;
-		list_remove (&(best_h->free));
 	}
 
 	return best_h;
@@ -84,13 +160,17 @@ static void heap_merge (heap_s * h1, heap_s * h2)
 
 void * heap_alloc (word_t size, byte_t tag)
 {
-	heap_s * h = free_get (size, tag);
+	heap_s * h;
+
+	while (!(h = free_get (size, tag)) && heap_reclaim && heap_reclaim ())
+		continue;
 	if (h) {
 		h++;						// skip header
 		if (tag & HEAP_TAG_CLEAR)
 			memset(h, 0, size);
 	}
 	if (!h) printk("HEAP: no memory (%u bytes)\n", size);
+	debug_heap("HEAP: a %x %u %x\n", h, size, tag);
 	return h;
 }
 
@@ -101,12 +181,7 @@ void heap_free (void * data)
 {
 	heap_s * h = ((heap_s *) (data)) - 1;  // back to header
 
-	// Free block will be inserted to free list:
-	//   - tail if merged to previous or next free block
-	//   - head if still alone to increase 'exact hit'
-	//     chance on next allocation of same size
-
-	list_s * i = &_heap_free;
+	debug_heap("HEAP: f %x\n", data);
 
 	// Try to merge with previous block if free
 
@@ -114,12 +189,9 @@ void heap_free (void * data)
 	if (&_heap_all != p) {
 		heap_s * prev = structof (p, heap_s, all);
 		if (prev->tag == HEAP_TAG_FREE) {
-			list_remove (&(prev->free));
+			free_remove (prev);
 			heap_merge (prev, h);
-			i = _heap_free.prev;
 			h = prev;
-		} else {
-			h->tag = HEAP_TAG_FREE;
 		}
 	}
 
@@ -129,15 +201,32 @@ void heap_free (void * data)
 	if (n != &_heap_all) {
 		heap_s * next = structof (n, heap_s, all);
 		if (next->tag == HEAP_TAG_FREE) {
-			list_remove (&(next->free));
+			free_remove (next);
 			heap_merge (h, next);
-			i = _heap_free.prev;
 		}
 	}
 
-	// Insert to free list head or tail
+	free_insert (h);
+}
+
 
-	list_insert_after (i, &(h->free));
+// Get total and largest free block sizes,
+// used to adapt kernel caches to the free heap
+
+void heap_free_size (word_t * total, word_t * largest)
+{
+	list_s * n = _heap_all.next;
+
+	*total = *largest = 0;
+	while (n != &_heap_all) {
+		heap_s * h = structof (n, heap_s, all);
+		if (h->tag == HEAP_TAG_FREE) {
+			*total += h->size;
+			if (h->size > *largest)
+				*largest = h->size;
+		}
+		n = h->all.next;
+	}
 }
 
 
@@ -148,13 +237,9 @@ void heap_add (void * data, word_t size)
 	if (size >= HEAP_MIN_SIZE) {
 		heap_s * h = (heap_s *) data;
 		h->size = size - sizeof (heap_s);
-		h->tag = HEAP_TAG_FREE;
-
-		// Add large block to tails of both lists
-		// as almost no chance for 'exact hit'
 
 		list_insert_before (&_heap_all, &(h->all));
-		list_insert_before (&_heap_free, &(h->free));
+		free_insert (h);
 	}
 }
 
@@ -162,8 +247,12 @@ void heap_add (void * data, word_t size)
 
 void heap_init ()
 {
+	int c;
+
 	list_init (&_heap_all);
-	list_init (&_heap_free);
+	for (c = 0; c < HEAP_CLASS_COUNT; c++)
+		list_init (&_heap_free [c]);
+	_heap_mask = 0;
 }
 
 #if UNUSED
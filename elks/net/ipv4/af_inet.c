@@ -321,14 +321,46 @@ static int inet_read(struct socket *sock, char *ubuf, int size, int nonblock)
     return ret;
 }
 
-static int inet_write(register struct socket *sock, char *ubuf, int size,
-                      int nonblock)
+/* copy up to max bytes starting at offset off within the user iovecs */
+static int iov_gather(unsigned char *data, struct iovec *iov, int iovcnt,
+                      size_t off, size_t max)
+{
+    size_t n, count = 0;
+
+    for (; iovcnt > 0 && count < max; iov++, iovcnt--) {
+        if (off >= iov->iov_len) {
+            off -= iov->iov_len;
+            continue;
+        }
+        n = iov->iov_len - off;
+        if (n > max - count)
+            n = max - count;
+        memcpy_fromfs(data + count, (char *)iov->iov_base + off, n);
+        count += n;
+        off = 0;
+    }
+    return count;
+}
+
+/*
+ * Gather the iovecs into TDB_WRITE_MAX packets for ktcp, so that a
+ * protocol header and its payload are sent with a single ktcp write.
+ */
+static int inet_send(register struct socket *sock, struct iovec *iov, int iovcnt,
+                     int nonblock, unsigned int flags)
 {
     register struct tdb_write *cmd;
-    int ret, usize, count;
+    int i, ret, usize;
+    size_t size = 0, count = 0;
 
-    debug("INET(%P) write sock %x size %d nonblock %d\n", sock, size, nonblock);
-    if (size <= 0)
+    if (flags != 0)
+        return -EINVAL;
+
+    for (i = 0; i < iovcnt; i++)
+        size += iov[i].iov_len;
+
+    debug("INET(%P) write sock %x size %u nonblock %d\n", sock, size, nonblock);
+    if (size == 0)
         return 0;
 
     if (sock->state == SS_DISCONNECTING)
@@ -337,18 +369,16 @@ static int inet_write(register struct socket *sock, char *ubuf, int size,
     if (sock->state != SS_CONNECTED)
         return -EINVAL;
 
-    count = size;
-    while (count) {
+    while (count < size) {
         down(&rwlock);
         cmd = (struct tdb_write *)get_tdout_buf();
         cmd->cmd = TDC_WRITE;
         cmd->sock = sock;
         cmd->nonblock = nonblock;
-        cmd->size = count > TDB_WRITE_MAX ? TDB_WRITE_MAX : count;
+        cmd->size = iov_gather(cmd->data, iov, iovcnt, count, TDB_WRITE_MAX);
 
         debug_net("INET(%P) WRITE %u\n", cmd->size);
 
-        memcpy_fromfs(cmd->data, ubuf, (size_t) cmd->size);
         usize = cmd->size;
         tcpdev_inetwrite(cmd, sizeof(struct tdb_write));
 
@@ -374,15 +404,23 @@ static int inet_write(register struct socket *sock, char *ubuf, int size,
             } else
                 return ret;
         }
-        else {
-            count -= usize;
-            ubuf += usize;
-        }
+        else count += usize;
     }
 
     return size;
 }
 
+static int inet_write(register struct socket *sock, char *ubuf, int size,
+                      int nonblock)
+{
+    struct iovec iov;
+
+    if (size <= 0)
+        return 0;
+    iov.iov_base = ubuf;
+    iov.iov_len = size;
+    return inet_send(sock, &iov, 1, nonblock, 0);
+}
 
 static int inet_select(register struct socket *sock, int sel_type)
 {
@@ -401,22 +439,28 @@ static int inet_select(register struct socket *sock, int sel_type)
     return 0;
 }
 
-static int inet_send(struct socket *sock, void *buff, int len, int nonblock,
-                     unsigned int flags)
+/* scatter into the iovecs, reading further only while ktcp has data */
+static int inet_recv(struct socket *sock, struct iovec *iov, int iovcnt,
+                     int nonblock, unsigned int flags)
 {
-    if (flags != 0)
-        return -EINVAL;
+    int n, count = 0;
 
-    return inet_write(sock, buff, len, nonblock);
-}
-
-static int inet_recv(struct socket *sock, void *buff, int len, int nonblock,
-                     unsigned int flags)
-{
     if (flags != 0)
         return -EINVAL;
 
-    return inet_read(sock, buff, len, nonblock);
+    for (; iovcnt > 0; iov++, iovcnt--) {
+        if (!iov->iov_len)
+            continue;
+        if (count && !sock->avail_data)
+            break;
+        n = inet_read(sock, iov->iov_base, iov->iov_len, nonblock);
+        if (n <= 0)
+            return count? count: n;
+        count += n;
+        if (n < iov->iov_len)
+            break;
+    }
+    return count;
 }
 
 static int inet_getname(struct socket *sock, struct sockaddr *usockaddr,
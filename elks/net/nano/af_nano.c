@@ -520,12 +520,12 @@ static int nano_listen(struct socket *sock, int backlog)
 }
 
 static int nano_send(struct socket *sock,
-		     void *buff, int len, int nonblock, unsigned int flags)
+		     struct iovec *iov, int iovcnt, int nonblock, unsigned int flags)
 {
     if (flags != 0)
 	return -EINVAL;
 
-    return nano_write(sock, (char *) buff, len, nonblock);
+    return sock_send_iov(sock, nano_write, iov, iovcnt, nonblock);
 }
 
 /*
@@ -533,12 +533,12 @@ static int nano_send(struct socket *sock,
  */
 
 static int nano_recv(struct socket *sock,
-		     void *buff, int len, int nonblock, unsigned flags)
+		     struct iovec *iov, int iovcnt, int nonblock, unsigned flags)
 {
     if (flags != 0)
 	return -EINVAL;
 
-    return nano_read(sock, (char *) buff, len, nonblock);
+    return sock_recv_iov(sock, nano_read, iov, iovcnt, nonblock);
 }
 
 struct proto_ops nano_proto_ops = {
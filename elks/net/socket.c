@@ -183,6 +183,54 @@ static size_t sock_write(struct inode *inode, struct file *file,
     return sock->ops->write(sock, ubuf, size, (file->f_flags & O_NONBLOCK));
 }
 
+/*
+ * Vectored I/O for readv/writev. The protocol send/recv ops are passed the
+ * kernel copy of the user iovec array, already checked by the VFS.
+ */
+int sock_iovec(struct inode *inode, struct file *file, struct iovec *iov,
+	int iovcnt, int rw)
+{
+    register struct socket *sock = socki_lookup(inode);
+    int nonblock = file->f_flags & O_NONBLOCK;
+
+    if (sock->flags & SF_ACCEPTCON)
+	return -EINVAL;
+
+    if (rw == FMODE_READ)
+	return sock->ops->recv(sock, iov, iovcnt, nonblock, 0);
+    return sock->ops->send(sock, iov, iovcnt, nonblock, 0);
+}
+
+/* send iovecs one at a time, for protocols without gather support */
+int sock_send_iov(struct socket *sock, int (*write)(), struct iovec *iov,
+	int iovcnt, int nonblock)
+{
+    int n, count = 0;
+
+    for (; iovcnt > 0; iov++, iovcnt--) {
+	if (!iov->iov_len)
+	    continue;
+	n = write(sock, iov->iov_base, iov->iov_len, nonblock);
+	if (n < 0)
+	    return count? count: n;
+	count += n;
+	if (n < iov->iov_len)
+	    break;
+    }
+    return count;
+}
+
+/* receive into the first non-empty iovec, for protocols without scatter support */
+int sock_recv_iov(struct socket *sock, int (*read)(), struct iovec *iov,
+	int iovcnt, int nonblock)
+{
+    for (; iovcnt > 0; iov++, iovcnt--) {
+	if (iov->iov_len)
+	    return read(sock, iov->iov_base, iov->iov_len, nonblock);
+    }
+    return 0;
+}
+
 static int sock_select(struct inode *inode, struct file *file, int sel_type)
 {
     register struct socket *sock;
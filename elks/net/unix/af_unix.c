@@ -519,12 +519,12 @@ static int unix_listen(struct socket *sock, int backlog)
 }
 
 static int unix_send(struct socket *sock,
-		     void *buff, int len, int nonblock, unsigned int flags)
+		     struct iovec *iov, int iovcnt, int nonblock, unsigned int flags)
 {
     if (flags != 0)
 	return -EINVAL;
 
-    return unix_write(sock, (char *) buff, len, nonblock);
+    return sock_send_iov(sock, unix_write, iov, iovcnt, nonblock);
 }
 
 /*
@@ -532,12 +532,12 @@ static int unix_send(struct socket *sock,
  */
 
 static int unix_recv(struct socket *sock,
-		     void *buff, int len, int nonblock, unsigned flags)
+		     struct iovec *iov, int iovcnt, int nonblock, unsigned flags)
 {
     if (flags != 0)
 	return -EINVAL;
 
-    return unix_read(sock, (char *) buff, len, nonblock);
+    return sock_recv_iov(sock, unix_read, iov, iovcnt, nonblock);
 }
 
 struct proto_ops unix_proto_ops = {
@@ -78,6 +78,7 @@ static list_root_t _inodes;  /* list of inodes */
 
 static int arglen;					/* passed filesystem prefix length*/
 static char *devfile;				/* passed special device filename*/
+static int xip;						/* align executables for execute in place*/
 
 /* Entry to build */
 
@@ -370,6 +371,99 @@ static int parse_dir (inode_build_t * grand_parent_inode,
 
 #define BLOCK_SIZE 256
 
+/* ELKS a.out header fields for execute in place */
+
+#define EXEC_HDR_FARTEXT 0x40  /* header size with far text */
+#define EXEC_SPLITID     0x04200301UL
+#define EXEC_SPLITID_AH  0x04300301UL
+
+static u32_t get_u32 (byte_t * p)
+	{
+	return p[0] | (p[1] << 8) | ((u32_t) p[2] << 16) | ((u32_t) p[3] << 24);
+	}
+
+static u16_t get_u16 (byte_t * p)
+	{
+	return p[0] | (p[1] << 8);
+	}
+
+static int copy_data (int fdin, int fdout, u32_t count)
+	{
+	byte_t buf [BLOCK_SIZE];
+
+	while (count)
+		{
+		int len = (count > BLOCK_SIZE) ? BLOCK_SIZE : count;
+		if (read (fdin, buf, len) != len || write (fdout, buf, len) != len)
+			{
+			perror ("copy");
+			return errno ? errno : EIO;
+			}
+		count -= len;
+		}
+
+	return 0;
+	}
+
+/* The kernel runs executables in place from ROM when their text is
+ * paragraph aligned. Near text always is, as it follows the header
+ * at the start of the file, but far text follows the near text.
+ * Pad the near text of uncompressed medium model executables to a
+ * paragraph, which doesn't change the text segment size in paragraphs.
+ * Returns 1 if the file is not such an executable.
+ */
+
+static int compile_exec (int fdin, int fdout, inode_build_t * inode)
+	{
+	byte_t hdr [EXEC_HDR_FARTEXT];
+	byte_t pad [16];
+	u32_t type, tseg, size;
+	int err, n;
+
+	n = read (fdin, hdr, EXEC_HDR_FARTEXT);
+	if (lseek (fdin, 0, SEEK_SET) < 0) return errno;
+	if (n != EXEC_HDR_FARTEXT) return 1;
+
+	type = get_u32 (hdr);
+	tseg = get_u32 (hdr + 0x08);
+	if ((type != EXEC_SPLITID && type != EXEC_SPLITID_AH) || hdr[4] != EXEC_HDR_FARTEXT
+		|| !get_u32 (hdr + 0x30) || get_u16 (hdr + 0x38) || get_u16 (hdr + 0x3C)
+		|| !(tseg & 0xF))
+		return 1;
+
+	n = 16 - (tseg & 0xF);
+	size = inode->size + n;
+	if (size >= ROMFS_FILE_MAX)
+		return 1;
+
+	tseg += n;
+	hdr[0x08] = tseg;
+	hdr[0x09] = tseg >> 8;
+	hdr[0x0A] = tseg >> 16;
+	hdr[0x0B] = tseg >> 24;
+	if (write (fdout, hdr, EXEC_HDR_FARTEXT) != EXEC_HDR_FARTEXT)
+		{
+		perror ("write");
+		return errno;
+		}
+	if (lseek (fdin, EXEC_HDR_FARTEXT, SEEK_SET) < 0) return errno;
+
+	err = copy_data (fdin, fdout, tseg - n);
+	if (err) return err;
+	memset (pad, 0, n);
+	if (write (fdout, pad, n) != n)
+		{
+		perror ("write");
+		return errno;
+		}
+	err = copy_data (fdin, fdout, inode->size - EXEC_HDR_FARTEXT - (tseg - n));
+	if (err) return err;
+
+	printf ("        text padded %d bytes for XIP\n", n);
+	inode->size = size;
+	return 0;
+	}
+
 static int compile_file (int fdout, inode_build_t * inode)
 	{
 	int err;
@@ -386,6 +480,12 @@ static int compile_file (int fdout, inode_build_t * inode)
 			break;
 			}
 
+		if (xip)
+			{
+			err = compile_exec (fdin, fdout, inode);
+			if (err <= 0) break;
+			}
+
 		u16_t size = 0;
 
 		while (1)
@@ -738,11 +838,18 @@ int main (int argc, char ** argv)
 		if (argc < 2)
 			{
 help:
-			puts ("usage: mkromfs [-d <devfile>] <dir>");
+			puts ("usage: mkromfs [-x] [-d <devfile>] <dir>");
 			err = 1;
 			break;
 			}
 
+		if (argv[1][0] == '-' && argv[1][1] == 'x') {
+			xip = 1;
+			++argv;
+			if (--argc < 2)
+				goto help;
+		}
+
 		if (argv[1][0] == '-' && argv[1][1] == 'd') {
 			++argv;
 			devfile = argv[1];
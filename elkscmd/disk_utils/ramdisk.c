@@ -7,14 +7,14 @@
 #include <sys/ioctl.h>
 #include <linuxmt/rd.h>
 
-#define MAX_SIZE 640 /* 1 KB blocks */
+#define MAX_SIZE 32767 /* 1 KB blocks, XMS ramdisks can be several MB */
 
 #define errmsg(str) write(STDERR_FILENO, str, sizeof(str) - 1)
 #define errstr(str) write(STDERR_FILENO, str, strlen(str))
 
 static int usage(void)
 {
-    errmsg("usage: ramdisk /dev/{rd0|ssd} {make | kill} [size in 1Kb blocks]\n");
+    errmsg("usage: ramdisk /dev/{rd0|ssd} {make | resize | kill} [size in 1Kb blocks]\n");
     return 1;
 }
 
@@ -33,7 +33,7 @@ int main(int argc, char **argv)
         size = 64; /* default */
 
     if (size < 1 || size > MAX_SIZE) {
-        errmsg("ramdisk: invalid size, range is 1-640\n");
+        errmsg("ramdisk: invalid size, range is 1-32767\n");
         return 1;
     }
     if (( fd = open(argv[1], 0) ) == -1) {
@@ -51,6 +51,17 @@ int main(int argc, char **argv)
         errstr(argv[1]);
         errmsg("\n");
         return 0;
+    } else if (strcmp(argv[2],"resize") == 0) {
+        if (ioctl(fd, RDRESIZE, size)) {
+            perror("ramdisk");
+            return 1;
+        }
+        errmsg("ramdisk: ");
+        errstr(argv[1]);
+        errmsg(" resized to ");
+        errstr(itoa(size));
+        errmsg("Kb\n");
+        return 0;
     } else if (strcmp(argv[2],"kill") == 0) {
         if (ioctl(fd, RDDESTROY, 0)) {
             if (errno == ENXIO) /* ramdisk present but not inited */
@@ -102,8 +102,8 @@ BLK *blkget(logical)
 	if (hdr.n[logical])
 	{
 		/* it has been used before - fill it from tmp file */
-		lseek(tmpfd, (long)hdr.n[logical] * (long)BLKSIZE, 0);
-		if (read(tmpfd, this->buf.c, (unsigned)BLKSIZE) != BLKSIZE)
+		if (pread(tmpfd, this->buf.c, (unsigned)BLKSIZE,
+			(long)hdr.n[logical] * (long)BLKSIZE) != BLKSIZE)
 		{
 			msg("Error %d reading back from tmp file!", errno);
 		}
@@ -156,14 +156,13 @@ void blkflush(this)
 	/* find a free place in the file */
 #ifndef NO_RECYCLE
 	seekpos = allocate();
-	lseek(tmpfd, seekpos, 0);
 #else
 	seekpos = lseek(tmpfd, 0L, 2);
 #endif
 	physical = seekpos / BLKSIZE;
 
 	/* put the block there */
-	if (write(tmpfd, this->buf.c, (unsigned)BLKSIZE) != BLKSIZE)
+	if (pwrite(tmpfd, this->buf.c, (unsigned)BLKSIZE, seekpos) != BLKSIZE)
 	{
 		msg("Trouble writing to tmp file");
 	}
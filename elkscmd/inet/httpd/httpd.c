@@ -35,6 +35,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/wait.h>
+#include <sys/uio.h>
 
 #define DEF_PORT		80
 #define DEF_CONTENT	"text/html"
@@ -43,6 +44,7 @@
 
 int listen_sock;
 char buf[1536];
+char hdr[256];
 
 char* get_mime_type(char *name)
 {
@@ -68,11 +70,12 @@ char* get_mime_type(char *name)
     return "text/plain";
 }
 
-void send_header(int fd, char *ct)
+/* format header into hdr, sent along with the first block of the file */
+int make_header(char *ct, off_t size)
 {
-	buf[0] = 0;
-	sprintf(buf, "HTTP/1.0 200 OK\r\nServer: nanoHTTPd/0.1\r\nDate: Thu Apr 26 15:37:46 GMT 2001\r\nContent-Type: %s\r\n",ct);
-	write(fd, buf, strlen(buf));
+	sprintf(hdr, "HTTP/1.0 200 OK\r\nServer: nanoHTTPd/0.1\r\nDate: Thu Apr 26 15:37:46 GMT 2001\r\nContent-Type: %s\r\nContent-Length: %ld\r\n\r\n",
+		ct, size);
+	return strlen(hdr);
 }
 
 void send_error(int fd, int errnum, char *str)
@@ -87,6 +90,7 @@ void process_request(int fd)
 {
 	int fin, ret;
 	off_t size;
+	struct iovec iov[2];
 	char *c, *file, fullpath[PATH_MAX];
 	struct stat st;
 	
@@ -127,15 +131,20 @@ void process_request(int fd)
 	}
 	size = lseek(fin, (off_t)0, SEEK_END);
 	lseek(fin, (off_t)0, SEEK_SET);
-	send_header(fd, get_mime_type(fullpath));
-	sprintf(buf,"Content-Length: %ld\r\n\r\n", size);
-	write(fd, buf, strlen(buf));
-	
-	do {
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = make_header(get_mime_type(fullpath), size);
+	ret = read(fin, buf, sizeof(buf));
+	iov[1].iov_base = buf;
+	iov[1].iov_len = (ret > 0)? ret: 0;
+	if (writev(fd, iov, 2) == iov[0].iov_len + sizeof(buf))
+		ret = sizeof(buf);
+	else ret = 0;
+
+	while (ret == sizeof(buf)) {
 		ret = read(fin, buf, sizeof(buf));
 		if (ret > 0)
 			ret = write(fd, buf, ret);
-	} while (ret == sizeof(buf));
+	}
 	
 	close(fin);
 	
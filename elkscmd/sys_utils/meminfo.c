@@ -100,7 +100,7 @@ void dump_heap(int fd)
 	static char *heaptype[] =
         { "free", "SEG ", "DRVR", "TTY ", "TASK", "BUFH", "PIPE", "INOD", "FILE" };
 	static char *segtype[] =
-        { "free", "CSEG", "DSEG", "DDAT", "FDAT", "BUF ", "RDSK" };
+        { "free", "CSEG", "DSEG", "DDAT", "FDAT", "BUF ", "RDSK", "VID ", "PIPE", "MMAP", "ROM " };
 
 	printf("  HEAP   TYPE  SIZE    SEG   TYPE    SIZE  CNT  NAME\n");
 
@@ -114,6 +114,7 @@ void dump_heap(int fd)
 		segext_t segsize;
 		word_t segflags;
 		byte_t ref_count;
+		word_t swapped;
 		int free, used, tty, buffer, system;
 		struct task_struct *t;
 
@@ -124,8 +125,11 @@ void dump_heap(int fd)
 		used = ((tag == HEAP_TAG_SEG)
             && (segflags == SEG_FLAG_CSEG || segflags == SEG_FLAG_DSEG ||
                 segflags == SEG_FLAG_DDAT || segflags == SEG_FLAG_FDAT));
-		tty = (tag == HEAP_TAG_TTY || tag == HEAP_TAG_DRVR);
-		buffer = (tag == HEAP_TAG_SEG && segflags == SEG_FLAG_EXTBUF)
+		tty = (tag == HEAP_TAG_TTY || tag == HEAP_TAG_DRVR
+            || (tag == HEAP_TAG_SEG && segflags == SEG_FLAG_VIDEO));
+		buffer = (tag == HEAP_TAG_SEG &&
+                (segflags == SEG_FLAG_EXTBUF || segflags == SEG_FLAG_PIPE ||
+                 segflags == SEG_FLAG_MMAP))
             || tag == HEAP_TAG_BUFHEAD || tag == HEAP_TAG_PIPE;
 		system = (tag == HEAP_TAG_TASK || tag == HEAP_TAG_INODE || tag == HEAP_TAG_FILE);
 
@@ -142,15 +146,21 @@ void dump_heap(int fd)
 				segbase = getword(fd, mem + offsetof(segment_s, base), ds);
 				segsize = getword(fd, mem + offsetof(segment_s, size), ds);
 				ref_count = getword(fd, mem + offsetof(segment_s, ref_count), ds);
+				swapped = getword(fd, mem + offsetof(segment_s, flags), ds) & SEG_FLAG_SWAPPED;
 				printf("   %4x   %s %7ld %4d  ",
                     segbase, segtype[segflags], (long)segsize << 4, ref_count);
-                if (segflags == SEG_FLAG_CSEG || segflags == SEG_FLAG_DSEG) {
-                    if ((t = find_process(fd, mem)) != NULL) {
+                if (swapped)
+                    printf("[swapped] ");
+                else if (segflags == SEG_FLAG_CSEG || segflags == SEG_FLAG_DSEG) {
+                    if ((t = find_process(fd, mem)) != NULL &&
+                        !(getword(fd, (word_t)t->mm[SEG_DATA] + offsetof(segment_s, flags), ds)
+                            & SEG_FLAG_SWAPPED)) {
 			            process_name(fd, t->t_begstack, t->t_regs.ss);
                     }
                 }
 
-				total_segsize += (long)segsize << 4;
+				if (!swapped)
+					total_segsize += (long)segsize << 4;
 				break;
 			}
 			printf("\n");
@@ -257,7 +257,11 @@ int main(int argc, char **argv)
 							+ getword(fd, (word_t)dseg+offsetof(struct segment, size), ds);
 			printf("%6ld ", (long)size << 4);
 
-			process_name(fd, task_table.t_begstack, task_table.t_regs.ss);
+			/* arguments are not in main memory while swapped out*/
+			if (getword(fd, (word_t)dseg+offsetof(struct segment, flags), ds) & SEG_FLAG_SWAPPED)
+				printf("[swapped]");
+			else
+				process_name(fd, task_table.t_begstack, task_table.t_regs.ss);
 		}
 		printf("\n");
 	}
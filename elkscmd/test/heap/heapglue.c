@@ -0,0 +1,33 @@
+/*
+ * Kernel side of the heap host test, built with the kernel headers
+ * that cannot be mixed with the host C library headers.
+ */
+
+#include <linuxmt/kernel.h>
+#include <linuxmt/heap.h>
+
+void printk(const char *fmt, ...)
+{
+	/* silence out of memory messages from heap_alloc */
+}
+
+int heap_header_size(void)
+{
+	return sizeof(heap_s);
+}
+
+unsigned int heap_tag(void *data)
+{
+	return ((heap_s *)data - 1)->tag;
+}
+
+/* call back for each block of the heap in address order */
+void heap_walk(void (*cb)(void *block, unsigned int size, unsigned int tag))
+{
+	list_s *n;
+
+	for (n = _heap_all.next; n != &_heap_all; n = n->next) {
+		heap_s *h = structof(n, heap_s, all);
+		cb(h, h->size, h->tag);
+	}
+}
@@ -0,0 +1,291 @@
+/*
+ * Host test and fragmentation benchmark for the kernel near heap
+ *
+ * Usage: heaptest                      run unit tests
+ *        heaptest [-s size] -t file    replay allocation trace
+ *
+ * The trace format is the DEBUG_HEAP output of heap_alloc/heap_free:
+ *      HEAP: a <addr> <size> <tag>
+ *      HEAP: f <addr>
+ * Other lines are ignored, so a raw console capture can be replayed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+/* kernel heap interface, see heapglue.c */
+#define HEAP_TAG_FREE   0x00
+#define HEAP_TAG_USED   0x80
+#define HEAP_TAG_CLEAR  0x40
+#define HEAP_TAG_SEG    0x01
+#define HEAP_TAG_DRVR   0x02
+#define HEAP_TAG_TTY    0x03
+#define HEAP_TAG_INODE  0x07
+#define HEAP_TAG_PIPE   0x06
+
+void *heap_alloc(unsigned short size, unsigned char tag);
+void heap_free(void *data);
+void heap_add(void *data, unsigned short size);
+void heap_init(void);
+int heap_header_size(void);
+unsigned int heap_tag(void *data);
+void heap_walk(void (*cb)(void *block, unsigned int size, unsigned int tag));
+
+#define HEAP_SIZE       0x8000
+#define MAX_LIVE        1024
+
+static unsigned char heap_area[0xFFF0] __attribute__((aligned(16)));
+static int failures;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { \
+		printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; } } while (0)
+
+/* state for heap_check walk */
+static unsigned char *walk_prev;
+static unsigned int walk_prev_tag;
+static unsigned int walk_size, walk_free, walk_big, walk_count;
+
+static void check_block(void *block, unsigned int size, unsigned int tag)
+{
+	if (walk_prev) {
+		CHECK(walk_prev == (unsigned char *)block);
+		CHECK(!(walk_prev_tag == HEAP_TAG_FREE && tag == HEAP_TAG_FREE));
+	}
+	walk_size += heap_header_size() + size;
+	if (tag == HEAP_TAG_FREE) {
+		walk_free += size;
+		walk_count++;
+		if (size > walk_big)
+			walk_big = size;
+	}
+	walk_prev = (unsigned char *)block + heap_header_size() + size;
+	walk_prev_tag = tag;
+}
+
+/* walk all blocks and check heap consistency, returns free space */
+static unsigned int heap_check(unsigned int total, unsigned int *largest,
+	unsigned int *nfree)
+{
+	walk_prev = NULL;
+	walk_size = walk_free = walk_big = walk_count = 0;
+	heap_walk(check_block);
+	CHECK(walk_size == total);
+	if (largest)
+		*largest = walk_big;
+	if (nfree)
+		*nfree = walk_count;
+	return walk_free;
+}
+
+static void heap_setup(unsigned int size)
+{
+	heap_init();
+	heap_add(heap_area, size);
+}
+
+static void test_basic(void)
+{
+	void *p[64];
+	unsigned int largest, nfree;
+	int i;
+
+	heap_setup(HEAP_SIZE);
+	CHECK(heap_check(HEAP_SIZE, NULL, NULL) == HEAP_SIZE - heap_header_size());
+
+	/* sizes covering every class */
+	for (i = 0; i < 64; i++) {
+		p[i] = heap_alloc(8 + (i * 37) % 700, HEAP_TAG_SEG);
+		CHECK(p[i] != NULL);
+	}
+	heap_check(HEAP_SIZE, NULL, NULL);
+
+	/* free every other block then the rest, must coalesce to one block */
+	for (i = 0; i < 64; i += 2)
+		heap_free(p[i]);
+	heap_check(HEAP_SIZE, NULL, &nfree);
+	CHECK(nfree >= 32);
+	for (i = 1; i < 64; i += 2)
+		heap_free(p[i]);
+	heap_check(HEAP_SIZE, &largest, &nfree);
+	CHECK(nfree == 1);
+	CHECK(largest == HEAP_SIZE - heap_header_size());
+}
+
+static void test_reuse(void)
+{
+	void *a, *b, *c;
+
+	/* a freed block is reused by the next allocation of the same size */
+	heap_setup(HEAP_SIZE);
+	a = heap_alloc(16, HEAP_TAG_SEG);
+	b = heap_alloc(80, HEAP_TAG_TTY);
+	c = heap_alloc(16, HEAP_TAG_SEG);
+	heap_free(b);
+	CHECK(heap_alloc(80, HEAP_TAG_PIPE) == b);
+	heap_free(a);
+	CHECK(heap_alloc(16, HEAP_TAG_SEG) == a);
+	heap_free(c);
+	heap_check(HEAP_SIZE, NULL, NULL);
+}
+
+static void test_tags(void)
+{
+	unsigned char *p;
+	int i;
+
+	heap_setup(HEAP_SIZE);
+	p = heap_alloc(100, HEAP_TAG_INODE);
+	memset(p, 0xAA, 100);
+	heap_free(p);
+	p = heap_alloc(100, HEAP_TAG_INODE | HEAP_TAG_CLEAR);
+	CHECK(heap_tag(p) == (HEAP_TAG_USED | HEAP_TAG_INODE | HEAP_TAG_CLEAR));
+	for (i = 0; i < 100; i++)
+		CHECK(p[i] == 0);
+	heap_free(p);
+	CHECK(heap_tag(p) == HEAP_TAG_FREE);
+}
+
+static void test_exhaust(void)
+{
+	void *p, *q;
+
+	heap_setup(1024);
+	CHECK(heap_alloc(2048, 0) == NULL);
+	p = heap_alloc(1024 - heap_header_size(), 0);
+	CHECK(p != NULL);
+	CHECK(heap_alloc(1, 0) == NULL);
+	heap_free(p);
+
+	/* large class request must be satisfied by the only large block */
+	q = heap_alloc(900, 0);
+	CHECK(q != NULL);
+	heap_free(q);
+	heap_check(1024, NULL, NULL);
+}
+
+static void test_random(void)
+{
+	void *p[256];
+	int i, n;
+
+	heap_setup(HEAP_SIZE);
+	memset(p, 0, sizeof(p));
+	srand(1);
+	for (n = 0; n < 100000; n++) {
+		i = rand() % 256;
+		if (p[i]) {
+			heap_free(p[i]);
+			p[i] = NULL;
+		} else {
+			p[i] = heap_alloc(1 + rand() % ((rand() & 7)? 64: 2048), HEAP_TAG_DRVR);
+		}
+		if ((n & 1023) == 0)
+			heap_check(HEAP_SIZE, NULL, NULL);
+	}
+	for (i = 0; i < 256; i++)
+		if (p[i])
+			heap_free(p[i]);
+	CHECK(heap_check(HEAP_SIZE, NULL, NULL) == HEAP_SIZE - heap_header_size());
+}
+
+static int replay(const char *file, unsigned int size)
+{
+	FILE *fp;
+	char line[128];
+	unsigned long addr[MAX_LIVE];
+	void *mem[MAX_LIVE];
+	unsigned long a;
+	unsigned int sz, tag, largest, nfree, free;
+	unsigned int peak = 0, allocs = 0, frees = 0, fails = 0;
+	int i, live = 0;
+	clock_t t;
+
+	if (!(fp = fopen(file, "r"))) {
+		perror(file);
+		return 1;
+	}
+	heap_setup(size);
+	t = clock();
+	while (fgets(line, sizeof(line), fp)) {
+		char *s = strstr(line, "HEAP: ");
+		if (!s)
+			continue;
+		if (sscanf(s, "HEAP: a %lx %u %x", &a, &sz, &tag) == 3) {
+			void *p;
+			allocs++;
+			if (!a)
+				continue;
+			if ((p = heap_alloc(sz, tag)) == NULL) {
+				fails++;
+				continue;
+			}
+			if (live < MAX_LIVE) {
+				addr[live] = a;
+				mem[live++] = p;
+			}
+			free = heap_check(size, NULL, NULL);
+			if (size - free > peak)
+				peak = size - free;
+		} else if (sscanf(s, "HEAP: f %lx", &a) == 1) {
+			frees++;
+			for (i = 0; i < live; i++) {
+				if (addr[i] == a) {
+					heap_free(mem[i]);
+					addr[i] = addr[--live];
+					mem[i] = mem[live];
+					break;
+				}
+			}
+		}
+	}
+	t = clock() - t;
+	fclose(fp);
+
+	free = heap_check(size, &largest, &nfree);
+	printf("heap %u bytes: %u allocs %u frees %u failed, peak used %u\n",
+		size, allocs, frees, fails, peak);
+	printf("end: %u live, %u free in %u blocks, largest %u, fragmentation %u%%\n",
+		live, free, nfree, largest, free? (unsigned)(100 - largest * 100UL / free): 0);
+	printf("replay time %lu usecs\n", (unsigned long)t * 1000000 / CLOCKS_PER_SEC);
+	return fails != 0 || failures != 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int size = HEAP_SIZE;
+	char *trace = NULL;
+	int c;
+
+	while ((c = getopt(argc, argv, "s:t:")) != -1) {
+		switch (c) {
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			if (size > sizeof(heap_area))
+				size = sizeof(heap_area);
+			break;
+		case 't':
+			trace = optarg;
+			break;
+		default:
+			fprintf(stderr, "Usage: heaptest [-s heapsize] [-t tracefile]\n");
+			return 1;
+		}
+	}
+
+	if (trace)
+		return replay(trace, size);
+
+	test_basic();
+	test_reuse();
+	test_tags();
+	test_exhaust();
+	test_random();
+	printf("heaptest: %s\n", failures? "FAILED": "passed");
+	return failures != 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * test_console - console output throughput benchmark
+ *
+ * Usage: test_console [-n lines] [-w width] [-b bufsize]
+ *
+ * Writes lines of printable text ending in newline to stdout with write(2)
+ * in bufsize chunks, then reports elapsed time and characters/second on
+ * stderr. Run on the console to measure glyph and scroll speed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+static char buf[1024];
+
+int main(int argc, char **argv)
+{
+	int i, n, lines = 500, width = 79, bufsize = 512;
+	int c, pos, col = 0;
+	long total, usecs;
+	struct timeval start, end;
+
+	while ((c = getopt(argc, argv, "n:w:b:")) != -1) {
+		switch (c) {
+		case 'n':
+			lines = atoi(optarg);
+			break;
+		case 'w':
+			width = atoi(optarg);
+			break;
+		case 'b':
+			bufsize = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: test_console [-n lines] [-w width] [-b bufsize]\n");
+			return 1;
+		}
+	}
+	if (lines <= 0 || width <= 0 || bufsize <= 0 || bufsize > sizeof(buf)) {
+		fprintf(stderr, "test_console: invalid argument\n");
+		return 1;
+	}
+
+	total = (long)lines * (width + 1);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < lines; ) {
+		/* fill buffer with text lines, split lines across writes */
+		for (pos = 0; pos < bufsize && i < lines; pos++) {
+			if (col == width) {
+				buf[pos] = '\n';
+				col = 0;
+				i++;
+			} else
+				buf[pos] = 'A' + (i + col++) % 26;
+		}
+		for (n = 0; n < pos; ) {
+			c = write(1, buf + n, pos - n);
+			if (c <= 0) {
+				perror("write");
+				return 1;
+			}
+			n += c;
+		}
+	}
+	gettimeofday(&end, NULL);
+
+	usecs = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_usec - start.tv_usec);
+	if (usecs <= 0)
+		usecs = 1;
+	fprintf(stderr, "%ld chars in %ld msecs, %ld chars/sec\n", total,
+		usecs / 1000, (long)(total * 1000 / (usecs / 1000 + 1)));
+	return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * test_direct - compare buffered and O_DIRECT reads of a raw block device
+ *
+ * Usage: test_direct [-k kbytes] device
+ *
+ * Reads the start of the device through the buffer cache and then with
+ * O_DIRECT, checks both passes return the same data, and displays the
+ * time taken for each.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+
+#define BUFSIZE 8192
+
+static char buf[BUFSIZE];
+
+static long read_dev(char *dev, int flags, unsigned int kbytes, unsigned int *sum)
+{
+	int fd, n;
+	unsigned long total = (unsigned long)kbytes * 1024;
+	struct timeval start, end;
+
+	if ((fd = open(dev, O_RDONLY | flags)) < 0) {
+		perror(dev);
+		return -1;
+	}
+	*sum = 0;
+	gettimeofday(&start, NULL);
+	while (total) {
+		n = total > BUFSIZE? BUFSIZE: (int)total;
+		if ((n = read(fd, buf, n)) <= 0)
+			break;
+		total -= n;
+		while (--n >= 0)
+			*sum += (unsigned char)buf[n];
+	}
+	gettimeofday(&end, NULL);
+	close(fd);
+	if (total) {
+		fprintf(stderr, "%s: short read, %lu bytes left\n", dev, total);
+		return -1;
+	}
+	return (end.tv_sec - start.tv_sec) * 1000L + (end.tv_usec - start.tv_usec) / 1000;
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+	unsigned int kbytes = 256;
+	unsigned int sum1, sum2;
+	long ms1, ms2;
+
+	while ((c = getopt(argc, argv, "k:")) != -1) {
+		switch (c) {
+		case 'k':
+			kbytes = atoi(optarg);
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+	if (optind >= argc) {
+		fprintf(stderr, "Usage: test_direct [-k kbytes] device\n");
+		return 1;
+	}
+
+	if ((ms1 = read_dev(argv[optind], 0, kbytes, &sum1)) < 0)
+		return 1;
+	if ((ms2 = read_dev(argv[optind], O_DIRECT, kbytes, &sum2)) < 0)
+		return 1;
+	printf("buffered %uK in %ld ms, O_DIRECT %uK in %ld ms\n", kbytes, ms1, kbytes, ms2);
+	if (sum1 != sum2) {
+		printf("FAIL: data mismatch (%04x != %04x)\n", sum1, sum2);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
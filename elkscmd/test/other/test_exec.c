@@ -0,0 +1,57 @@
+/*
+ * test_exec - exec latency benchmark
+ *
+ * Usage: test_exec [-n count] program [args...]
+ *
+ * Runs program count times with fork/exec/wait and reports the average
+ * time per run. Use a program that exits at once, such as a small model,
+ * medium model or compressed build of 'true', to measure exec overhead.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+int main(int argc, char **argv)
+{
+	int i, count = 20;
+	int status;
+	long usecs;
+	pid_t pid;
+	struct timeval start, end;
+
+	if (argc > 2 && argv[1][0] == '-' && argv[1][1] == 'n') {
+		count = atoi(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
+	if (argc < 2 || count <= 0) {
+		fprintf(stderr, "Usage: test_exec [-n count] program [args...]\n");
+		return 1;
+	}
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < count; i++) {
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			return 1;
+		}
+		if (pid == 0) {
+			execv(argv[1], &argv[1]);
+			perror(argv[1]);
+			_exit(127);
+		}
+		if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+			fprintf(stderr, "test_exec: %s failed\n", argv[1]);
+			return 1;
+		}
+	}
+	gettimeofday(&end, NULL);
+
+	usecs = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_usec - start.tv_usec);
+	printf("%s: %d runs in %ld msecs, %ld msecs/exec\n", argv[1], count,
+		usecs / 1000, usecs / 1000 / count);
+	return 0;
+}
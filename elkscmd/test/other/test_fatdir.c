@@ -0,0 +1,117 @@
+/*
+ * test_fatdir - large directory create and lookup benchmark
+ *
+ * Usage: test_fatdir [-n files] [-k] directory
+ *
+ * Creates a new subdirectory "bench" in directory, then creates the
+ * requested number of files in it, looks each one up by opening it, and
+ * looks up names that don't exist. Displays the time taken for each pass,
+ * then removes the files unless -k is given. Intended for FAT volumes,
+ * where lookups in large directories use the directory index.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+static struct timeval start;
+
+static void begin(void)
+{
+	gettimeofday(&start, NULL);
+}
+
+static void end(char *what, int n)
+{
+	struct timeval now;
+	long ms;
+
+	gettimeofday(&now, NULL);
+	ms = (now.tv_sec - start.tv_sec) * 1000L + (now.tv_usec - start.tv_usec) / 1000;
+	printf("%-8s %5d files in %6ld ms\n", what, n, ms);
+}
+
+int main(int argc, char **argv)
+{
+	int c, i, fd;
+	int nfiles = 500;
+	int keep = 0;
+	int errors = 0;
+	char path[80];
+	char dir[64];
+
+	while ((c = getopt(argc, argv, "n:k")) != -1) {
+		switch (c) {
+		case 'n':
+			nfiles = atoi(optarg);
+			break;
+		case 'k':
+			keep = 1;
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+	if (optind >= argc || strlen(argv[optind]) > sizeof(dir) - 8) {
+		fprintf(stderr, "Usage: test_fatdir [-n files] [-k] directory\n");
+		return 1;
+	}
+	sprintf(dir, "%s/bench", argv[optind]);
+	if (mkdir(dir, 0777) < 0) {
+		perror(dir);
+		return 1;
+	}
+
+	begin();
+	for (i = 0; i < nfiles; i++) {
+		sprintf(path, "%s/f%05d.log", dir, i);
+		if ((fd = open(path, O_CREAT | O_EXCL | O_WRONLY, 0666)) < 0) {
+			perror(path);
+			return 1;
+		}
+		close(fd);
+	}
+	end("create", nfiles);
+
+	begin();
+	for (i = nfiles; --i >= 0; ) {
+		sprintf(path, "%s/f%05d.log", dir, i);
+		if ((fd = open(path, O_RDONLY)) < 0) {
+			perror(path);
+			errors++;
+		} else close(fd);
+	}
+	end("lookup", nfiles);
+
+	begin();
+	for (i = 0; i < nfiles; i++) {
+		sprintf(path, "%s/x%05d.log", dir, i);
+		if (access(path, F_OK) == 0) {
+			fprintf(stderr, "%s: unexpectedly found\n", path);
+			errors++;
+		}
+	}
+	end("missing", nfiles);
+
+	if (!keep) {
+		begin();
+		for (i = 0; i < nfiles; i++) {
+			sprintf(path, "%s/f%05d.log", dir, i);
+			if (unlink(path) < 0) {
+				perror(path);
+				errors++;
+			}
+		}
+		end("unlink", nfiles);
+		if (rmdir(dir) < 0) {
+			perror(dir);
+			errors++;
+		}
+	}
+	printf("%s\n", errors? "FAIL": "PASS");
+	return errors != 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * test_iov - test readv/writev and pread/pwrite
+ *
+ * Usage: test_iov [file]
+ *
+ * Writes a file with writev, reads it back with readv and checks
+ * pread/pwrite leave the file position unchanged. Then checks that
+ * readv on a pipe returns once the available data has been read.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+
+static char a[16], b[32], c[8];
+
+static int fail(char *msg)
+{
+	fprintf(stderr, "test_iov: %s failed\n", msg);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	int fd, p[2];
+	char *file = (argc > 1)? argv[1]: "/tmp/test_iov";
+	struct iovec iov[3];
+
+	memset(a, 'a', sizeof(a));
+	memset(b, 'b', sizeof(b));
+	memset(c, 'c', sizeof(c));
+	iov[0].iov_base = a;
+	iov[0].iov_len = sizeof(a);
+	iov[1].iov_base = b;
+	iov[1].iov_len = sizeof(b);
+	iov[2].iov_base = c;
+	iov[2].iov_len = sizeof(c);
+
+	if ((fd = open(file, O_RDWR|O_CREAT|O_TRUNC, 0644)) < 0) {
+		perror(file);
+		return 1;
+	}
+	if (writev(fd, iov, 3) != sizeof(a) + sizeof(b) + sizeof(c))
+		return fail("writev");
+
+	/* pwrite/pread at offset of b, file position stays at end */
+	if (pwrite(fd, "XY", 2, sizeof(a)) != 2)
+		return fail("pwrite");
+	if (pread(fd, a, 4, sizeof(a) - 2) != 4 || memcmp(a, "aaXY", 4))
+		return fail("pread");
+	if (lseek(fd, 0L, SEEK_CUR) != sizeof(a) + sizeof(b) + sizeof(c))
+		return fail("pread/pwrite position");
+
+	memset(a, 0, sizeof(a));
+	memset(b, 0, sizeof(b));
+	memset(c, 0, sizeof(c));
+	lseek(fd, 0L, SEEK_SET);
+	if (readv(fd, iov, 3) != sizeof(a) + sizeof(b) + sizeof(c))
+		return fail("readv");
+	if (a[sizeof(a)-1] != 'a' || b[0] != 'X' || b[1] != 'Y' || b[2] != 'b'
+	    || c[0] != 'c')
+		return fail("readv data");
+	close(fd);
+	unlink(file);
+
+	/* readv on pipe must not block after reading available data */
+	if (pipe(p) < 0)
+		return fail("pipe");
+	write(p[1], "hello", 5);
+	if (readv(p[0], iov, 3) != 5 || memcmp(a, "hello", 5))
+		return fail("pipe readv");
+	if (pread(p[0], a, 1, 0L) >= 0)
+		return fail("pipe pread");
+	close(p[0]);
+	close(p[1]);
+
+	printf("test_iov: all tests passed\n");
+	return 0;
+}
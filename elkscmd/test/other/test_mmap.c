@@ -0,0 +1,62 @@
+/*
+ * test_mmap - test read-only file mmap
+ *
+ * Usage: test_mmap [file]
+ *
+ * Maps a file, compares the mapping with the file contents read(2)
+ * from a second descriptor, and checks that mapping the same file
+ * twice shares one segment.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+static char buf[512];
+
+int main(int argc, char **argv)
+{
+	int fd, fd2, n, i;
+	long off = 0;
+	char *file = (argc > 1)? argv[1]: "/etc/passwd";
+	char __far *map, __far *map2;
+
+	if ((fd = open(file, O_RDONLY)) < 0 || (fd2 = open(file, O_RDONLY)) < 0) {
+		perror(file);
+		return 1;
+	}
+	map = mmap(NULL, 0, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	while ((n = read(fd2, buf, sizeof(buf))) > 0) {
+		for (i = 0; i < n; i++) {
+			if (map[off + i] != buf[i]) {
+				fprintf(stderr, "test_mmap: mismatch at %ld\n", off + i);
+				return 1;
+			}
+		}
+		off += n;
+	}
+
+	map2 = mmap(NULL, 0, PROT_READ, MAP_SHARED, fd2, 0);
+	if (map2 != map) {
+		fprintf(stderr, "test_mmap: second mapping not shared\n");
+		return 1;
+	}
+	if (mmap(NULL, 0, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0) != MAP_FAILED) {
+		fprintf(stderr, "test_mmap: writable mapping allowed\n");
+		return 1;
+	}
+	if (munmap(map2, 0) < 0 || munmap(map, 0) < 0) {
+		perror("munmap");
+		return 1;
+	}
+	close(fd);
+	close(fd2);
+	printf("test_mmap: %ld bytes mapped, all tests passed\n", off);
+	return 0;
+}
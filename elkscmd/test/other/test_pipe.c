@@ -0,0 +1,102 @@
+/*
+ * test_pipe - pipe throughput benchmark
+ *
+ * Usage: test_pipe [-k kbytes] [-b bufsize] [-p pipesize]
+ *
+ * Forks a child that writes kbytes of data into a pipe in bufsize chunks
+ * while the parent reads and checks it, then reports elapsed time and
+ * bytes/second. The pipe buffer can be resized first with F_SETPIPE_SZ.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+static char buf[4096];
+
+int main(int argc, char **argv)
+{
+	int c, n, pid, fd[2];
+	int kbytes = 256, bufsize = 512, pipesize = 0;
+	long total, count, usecs;
+	unsigned char expect = 0;
+	struct timeval start, end;
+
+	while ((c = getopt(argc, argv, "k:b:p:")) != -1) {
+		switch (c) {
+		case 'k':
+			kbytes = atoi(optarg);
+			break;
+		case 'b':
+			bufsize = atoi(optarg);
+			break;
+		case 'p':
+			pipesize = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: test_pipe [-k kbytes] [-b bufsize] [-p pipesize]\n");
+			return 1;
+		}
+	}
+	if (kbytes <= 0 || bufsize <= 0 || bufsize > sizeof(buf)) {
+		fprintf(stderr, "test_pipe: invalid argument\n");
+		return 1;
+	}
+
+	if (pipe(fd) < 0) {
+		perror("pipe");
+		return 1;
+	}
+	if (pipesize && fcntl(fd[1], F_SETPIPE_SZ, pipesize) < 0)
+		perror("F_SETPIPE_SZ");
+	n = fcntl(fd[1], F_GETPIPE_SZ);
+	fprintf(stderr, "pipe size %d, %d byte transfers\n", n, bufsize);
+
+	total = (long)kbytes * 1024;
+	gettimeofday(&start, NULL);
+	if ((pid = fork()) < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0) {
+		close(fd[0]);
+		for (count = 0; count < total; count += n) {
+			n = (total - count < bufsize)? (int)(total - count): bufsize;
+			for (c = 0; c < n; c++)
+				buf[c] = (char)(count + c);
+			if (write(fd[1], buf, n) != n) {
+				perror("write");
+				_exit(1);
+			}
+		}
+		_exit(0);
+	}
+
+	close(fd[1]);
+	count = 0;
+	while ((n = read(fd[0], buf, bufsize)) > 0) {
+		for (c = 0; c < n; c++) {
+			if ((unsigned char)buf[c] != expect++) {
+				fprintf(stderr, "test_pipe: data mismatch at %ld\n", count + c);
+				return 1;
+			}
+		}
+		count += n;
+	}
+	gettimeofday(&end, NULL);
+	waitpid(pid, NULL, 0);
+
+	if (count != total) {
+		fprintf(stderr, "test_pipe: read %ld of %ld bytes\n", count, total);
+		return 1;
+	}
+	usecs = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_usec - start.tv_usec);
+	if (usecs <= 0)
+		usecs = 1;
+	fprintf(stderr, "%ld bytes in %ld msecs, %ld bytes/sec\n", total,
+		usecs / 1000, (long)(total * 1000 / (usecs / 1000 + 1)));
+	return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * test_ssd - SSD raw read benchmark
+ *
+ * Usage: test_ssd [-s sectors] [-b start] [device]
+ *
+ * Reads the same range of sectors using 1, 2, 4, 8 and 16 sectors
+ * per device command and displays sectors/second for each, to
+ * measure the benefit of multiple block transfers.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linuxmt/ioctl.h>
+
+#define HZ      100
+
+int main(int argc, char **argv)
+{
+	int fd, c;
+	unsigned int sectors = 256;
+	unsigned long start = 0;
+	unsigned int per_cmd;
+	char *dev;
+	struct ssd_bench b;
+
+	while ((c = getopt(argc, argv, "s:b:")) != -1) {
+		switch (c) {
+		case 's':
+			sectors = atoi(optarg);
+			break;
+		case 'b':
+			start = atol(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: test_ssd [-s sectors] [-b start] [device]\n");
+			return 1;
+		}
+	}
+	dev = (optind < argc)? argv[optind]: "/dev/ssd";
+
+	if ((fd = open(dev, O_RDONLY)) < 0) {
+		perror(dev);
+		return 1;
+	}
+	for (per_cmd = 1; per_cmd <= SSD_BENCH_MAX; per_cmd <<= 1) {
+		b.start = start;
+		b.sectors = sectors;
+		b.per_cmd = per_cmd;
+		if (ioctl(fd, IOCTL_SSD_BENCH, &b) < 0) {
+			perror("IOCTL_SSD_BENCH");
+			return 1;
+		}
+		if (!b.ticks)
+			b.ticks = 1;
+		printf("%2u sectors/cmd: %u sectors in %lu ticks, %lu sectors/sec\n",
+			per_cmd, sectors, b.ticks, (unsigned long)sectors * HZ / b.ticks);
+	}
+	close(fd);
+	return 0;
+}
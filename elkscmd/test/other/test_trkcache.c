@@ -0,0 +1,66 @@
+/*
+ * test_trkcache - BIOS disk track cache statistics
+ *
+ * Usage: test_trkcache [-r] [-k kbytes] [device]
+ *
+ * Optionally clears the device's track cache and statistics (-r),
+ * reads kbytes sequentially from the device, then displays the
+ * cache hit rate for tuning the number of entries (trkcache=).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linuxmt/ioctl.h>
+
+static char buf[1024];
+
+int main(int argc, char **argv)
+{
+	int fd, c, reset = 0;
+	long kbytes = 0, n;
+	char *dev;
+	struct blk_cache_stats st;
+
+	while ((c = getopt(argc, argv, "rk:")) != -1) {
+		switch (c) {
+		case 'r':
+			reset = 1;
+			break;
+		case 'k':
+			kbytes = atol(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: test_trkcache [-r] [-k kbytes] [device]\n");
+			return 1;
+		}
+	}
+	dev = (optind < argc)? argv[optind]: "/dev/fd0";
+
+	if ((fd = open(dev, O_RDONLY)) < 0) {
+		perror(dev);
+		return 1;
+	}
+	if (reset && ioctl(fd, IOCTL_BLK_CACHE_RESET, 0) < 0) {
+		perror("IOCTL_BLK_CACHE_RESET");
+		return 1;
+	}
+	for (n = 0; n < kbytes; n++) {
+		if (read(fd, buf, sizeof(buf)) != sizeof(buf))
+			break;
+	}
+	if (ioctl(fd, IOCTL_BLK_CACHE_STATS, &st) < 0) {
+		perror("IOCTL_BLK_CACHE_STATS");
+		return 1;
+	}
+	if (kbytes)
+		printf("read %ldK from %s\n", n, dev);
+	printf("%u entries of %u bytes\n", st.entries, st.entry_size);
+	printf("tries %lu hits %lu (%lu%%) fills %lu invalidates %lu\n",
+		st.tries, st.hits, st.tries? st.hits * 100 / st.tries: 0L,
+		st.fills, st.invalidates);
+	close(fd);
+	return 0;
+}
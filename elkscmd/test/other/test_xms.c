@@ -0,0 +1,63 @@
+/*
+ * test_xms - XMS copy benchmark
+ *
+ * Usage: test_xms [-k kbytes]
+ *
+ * Times copying 1K blocks to and back from extended memory, as done by
+ * the buffer cache, using the kernel's active copy method and main memory
+ * for comparison, and displays the transfer rate.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linuxmt/mem.h>
+
+#define HZ      100
+
+static char *names[] = { "main memory", "unreal mode", "int 15/1F" };
+
+int main(int argc, char **argv)
+{
+	int fd, c, method;
+	unsigned int kbytes = 1024;
+	unsigned long kps;
+	struct xms_bench b;
+
+	while ((c = getopt(argc, argv, "k:")) != -1) {
+		switch (c) {
+		case 'k':
+			kbytes = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: test_xms [-k kbytes]\n");
+			return 1;
+		}
+	}
+
+	if ((fd = open("/dev/kmem", O_RDONLY)) < 0) {
+		perror("/dev/kmem");
+		return 1;
+	}
+	for (method = XMS_COPY_FAR; method <= XMS_COPY_INT15; method++) {
+		b.method = method;
+		b.kbytes = kbytes;
+		if (ioctl(fd, MEM_XMSBENCH, &b) < 0) {
+			if (errno == EINVAL) {
+				printf("%-12s not available\n", names[method]);
+				continue;
+			}
+			perror("MEM_XMSBENCH");
+			return 1;
+		}
+		if (!b.ticks)
+			b.ticks = 1;
+		kps = (unsigned long)kbytes * 2 * HZ / b.ticks;
+		printf("%-12s %uK each way in %lu ticks, %lu.%lu MB/s\n", names[method],
+			kbytes, b.ticks, kps / 1024, (kps % 1024) * 10 / 1024);
+	}
+	close(fd);
+	return 0;
+}
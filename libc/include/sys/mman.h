@@ -0,0 +1,16 @@
+#ifndef __SYS_MMAN_H
+#define __SYS_MMAN_H
+
+#include <features.h>
+#include <sys/types.h>
+#include __SYSINC__(mman.h)
+
+#define MAP_FAILED	((void __far *)-1L)
+
+/* read-only mapping of a whole file, offset must be 0 */
+void __far *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t offset);
+int munmap(void __far *addr, size_t len);
+int _mmap(int fd, int prot, int flags, unsigned short *pseg);   /* syscall */
+int _munmap(unsigned short seg);                                /* syscall */
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef __SYS_UIO_H
+#define __SYS_UIO_H
+
+#include <features.h>
+#include <sys/types.h>
+#include __SYSINC__(uio.h)
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt);
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt);
+
+#endif
@@ -56,6 +56,10 @@ int isatty (int fd);
 char *ttyname(int fd);
 off_t lseek (int fildes, off_t offset, int whence);
 int _lseek (int fd, off_t *posn, int where);    /* syscall */
+ssize_t pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset);
+int _pread(int fd, void *buf, size_t count, off_t *offset);         /* syscall */
+int _pwrite(int fd, const void *buf, size_t count, off_t *offset);  /* syscall */
 int link(const char *path1, const char *path2);
 int symlink(const char *path1, const char *path2);
 int unlink(const char *fname);
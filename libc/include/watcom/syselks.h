@@ -139,6 +139,12 @@ typedef int syscall_res;
 #define SYS_setitimer            71
 #define SYS_sysctl               72
 #define SYS_uname                73
+#define SYS_readv                75
+#define SYS_writev               76
+#define SYS_pread                77
+#define SYS_pwrite               78
+#define SYS_mmap                 79
+#define SYS_munmap               80
 
 #define SYS_socket              198
 
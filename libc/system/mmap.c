@@ -0,0 +1,25 @@
+#include <errno.h>
+#include <sys/mman.h>
+
+#define _MK_FP(seg,off) ((void __far *)((((unsigned long)(seg)) << 16) | (off)))
+#define _FP_SEG(fp)     ((unsigned short)((unsigned long)(fp) >> 16))
+
+void __far *
+mmap(void *addr, size_t len, int prot, int flags, int fd, off_t offset)
+{
+    unsigned short seg;
+
+    if (offset != 0) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    if (_mmap(fd, prot, flags, &seg) < 0)
+        return MAP_FAILED;
+    return _MK_FP(seg, 0);
+}
+
+int
+munmap(void __far *addr, size_t len)
+{
+    return _munmap(_FP_SEG(addr));
+}
@@ -34,7 +34,10 @@ OBJS = \
 	killpg.o \
 	lseek.o \
 	mkfifo.o \
+	mmap.o \
 	opendir.o \
+	pread.o \
+	pwrite.o \
 	readdir.o \
 	rewinddir.o \
 	seekdir.o \
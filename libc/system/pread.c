@@ -0,0 +1,7 @@
+#include <unistd.h>
+
+ssize_t
+pread(int fd, void *buf, size_t count, off_t offset)
+{
+    return _pread(fd, buf, count, &offset);
+}
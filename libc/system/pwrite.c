@@ -0,0 +1,7 @@
+#include <unistd.h>
+
+ssize_t
+pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+    return _pwrite(fd, buf, count, &offset);
+}